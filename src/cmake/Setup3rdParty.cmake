@@ -73,3 +73,9 @@ if(VTKM_DIR)
 else()
     message(FATAL_ERROR "VTK-h requries VTK-m")
 endif()
+
+################################
+# Threads
+################################
+# the async image writer uses std::thread
+find_package(Threads REQUIRED)
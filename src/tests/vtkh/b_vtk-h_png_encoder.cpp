@@ -0,0 +1,57 @@
+//-----------------------------------------------------------------------------
+///
+/// file: b_vtk-h_png_encoder.cpp
+///
+//-----------------------------------------------------------------------------
+
+#include "gtest/gtest.h"
+
+#include <vtkh/utils/PNGEncoder.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+
+std::vector<unsigned char> make_gradient(const int width, const int height)
+{
+  std::vector<unsigned char> rgba(width * height * 4);
+  for(int y = 0; y < height; ++y)
+  {
+    for(int x = 0; x < width; ++x)
+    {
+      const int offset = (y * width + x) * 4;
+      rgba[offset + 0] = static_cast<unsigned char>(x % 256);
+      rgba[offset + 1] = static_cast<unsigned char>(y % 256);
+      rgba[offset + 2] = 0;
+      rgba[offset + 3] = 255;
+    }
+  }
+  return rgba;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+TEST(vtkh_png_encoder, vtkh_png_benchmark)
+{
+  for(int size = 1024; size <= 8192; size *= 2)
+  {
+    std::vector<unsigned char> rgba = make_gradient(size, size);
+    for(int threaded = 0; threaded < 2; ++threaded)
+    {
+      vtkh::PNGEncoder encoder;
+      encoder.SetMultiThreaded(threaded == 1);
+      auto start = std::chrono::steady_clock::now();
+      encoder.Encode(&rgba[0], size, size);
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      EXPECT_TRUE(encoder.PngBufferSize() > 0);
+      std::cout<<size<<"x"<<size<<(threaded ? " strips " : " lodepng ")
+               <<elapsed.count()<<" s "
+               <<double(size) * size / elapsed.count() / 1e6<<" MPixels/s "
+               <<encoder.PngBufferSize()<<" bytes\n";
+    }
+  }
+}
@@ -0,0 +1,215 @@
+//-----------------------------------------------------------------------------
+///
+/// file: t_vtk-h_image_writer.cpp
+///
+//-----------------------------------------------------------------------------
+
+#include "gtest/gtest.h"
+
+#include <vtkh/utils/AsyncImageWriter.hpp>
+#include <vtkh/utils/PNGEncoder.hpp>
+#include <vtkh/utils/QOIEncoder.hpp>
+#include <lodepng.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+std::vector<unsigned char> make_gradient(const int width, const int height, const int shift)
+{
+  std::vector<unsigned char> rgba(width * height * 4);
+  for(int y = 0; y < height; ++y)
+  {
+    for(int x = 0; x < width; ++x)
+    {
+      const int offset = (y * width + x) * 4;
+      rgba[offset + 0] = static_cast<unsigned char>((x + shift) % 256);
+      rgba[offset + 1] = static_cast<unsigned char>((y + shift) % 256);
+      rgba[offset + 2] = static_cast<unsigned char>(shift % 256);
+      rgba[offset + 3] = 255;
+    }
+  }
+  return rgba;
+}
+
+bool file_exists(const std::string &file_name)
+{
+  std::ifstream file(file_name.c_str());
+  return file.good();
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+TEST(vtkh_image_writer, vtkh_async_write)
+{
+  const int width = 256;
+  const int height = 128;
+  const int num_images = 12;
+
+  vtkh::AsyncImageWriter *writer = vtkh::AsyncImageWriter::Instance();
+  writer->SetNumThreads(3);
+  // smaller than the number of images to exercise back pressure
+  writer->SetQueueSize(2);
+
+  std::vector<std::string> comments;
+  comments.push_back("Author");
+  comments.push_back("vtkh");
+  for(int i = 0; i < num_images; ++i)
+  {
+    std::vector<unsigned char> rgba = make_gradient(width, height, i * 16);
+    writer->Write(rgba, width, height, comments, "async_" + std::to_string(i));
+    // the writer owns the pixels now
+    EXPECT_EQ(rgba.size(), 0u);
+  }
+
+  writer->Flush();
+
+  for(int i = 0; i < num_images; ++i)
+  {
+    EXPECT_TRUE(file_exists("async_" + std::to_string(i) + ".png"));
+  }
+
+  writer->SetEnabled(false);
+  std::vector<unsigned char> rgba = make_gradient(width, height, 0);
+  writer->Write(rgba, width, height, comments, "sync_write");
+  EXPECT_TRUE(file_exists("sync_write.png"));
+  writer->SetEnabled(true);
+}
+
+//----------------------------------------------------------------------------
+TEST(vtkh_image_writer, vtkh_png_strips)
+{
+  const int width = 517;
+  const int height = 301;
+  std::vector<unsigned char> rgba = make_gradient(width, height, 7);
+  // translucent pixels keep the alpha channel
+  rgba[3] = 128;
+
+  for(int level = 0; level <= 9; ++level)
+  {
+    vtkh::PNGEncoder encoder;
+    encoder.SetCompressionLevel(level);
+    encoder.Encode(&rgba[0], width, height);
+
+    unsigned char *decoded = NULL;
+    unsigned decoded_width, decoded_height;
+    unsigned error = vtkh::lodepng_decode32(&decoded,
+                                            &decoded_width,
+                                            &decoded_height,
+                                            (unsigned char*)encoder.PngBuffer(),
+                                            encoder.PngBufferSize());
+    ASSERT_EQ(error, 0);
+    ASSERT_EQ(decoded_width, static_cast<unsigned>(width));
+    ASSERT_EQ(decoded_height, static_cast<unsigned>(height));
+    // the encoder flips the image
+    for(int y = 0; y < height; ++y)
+    {
+      EXPECT_EQ(memcmp(decoded + y * width * 4,
+                       &rgba[(height - y - 1) * width * 4],
+                       width * 4), 0);
+    }
+    free(decoded);
+  }
+}
+
+//----------------------------------------------------------------------------
+TEST(vtkh_image_writer, vtkh_png_opaque_strips)
+{
+  const int width = 517;
+  const int height = 301;
+  // every pixel is opaque, so the strips drop the alpha channel
+  std::vector<unsigned char> rgba = make_gradient(width, height, 3);
+
+  for(int threaded = 0; threaded < 2; ++threaded)
+  {
+    vtkh::PNGEncoder encoder;
+    encoder.SetMultiThreaded(threaded == 1);
+    encoder.Encode(&rgba[0], width, height);
+
+    const unsigned char *png = (const unsigned char*)encoder.PngBuffer();
+    ASSERT_TRUE(encoder.PngBufferSize() > 25);
+    if(threaded == 1)
+    {
+      // color type 2 is RGB
+      EXPECT_EQ(png[25], 2);
+    }
+
+    unsigned char *decoded = NULL;
+    unsigned decoded_width, decoded_height;
+    unsigned error = vtkh::lodepng_decode32(&decoded,
+                                            &decoded_width,
+                                            &decoded_height,
+                                            png,
+                                            encoder.PngBufferSize());
+    ASSERT_EQ(error, 0);
+    ASSERT_EQ(decoded_width, static_cast<unsigned>(width));
+    ASSERT_EQ(decoded_height, static_cast<unsigned>(height));
+    for(int y = 0; y < height; ++y)
+    {
+      EXPECT_EQ(memcmp(decoded + y * width * 4,
+                       &rgba[(height - y - 1) * width * 4],
+                       width * 4), 0);
+    }
+    free(decoded);
+  }
+}
+
+//----------------------------------------------------------------------------
+TEST(vtkh_image_writer, vtkh_qoi_round_trip)
+{
+  const int width = 300;
+  const int height = 200;
+  std::vector<unsigned char> rgba = make_gradient(width, height, 3);
+  // runs, alpha changes and large jumps
+  for(int i = 0; i < width * 4 * 10; ++i) rgba[i] = 0;
+  for(int i = 0; i < width; ++i) rgba[(width * 20 + i) * 4 + 3] = i % 256;
+  for(int i = 0; i < width * 4; ++i) rgba[width * 30 * 4 + i] = (i * 97) % 256;
+
+  vtkh::QOIEncoder encoder;
+  encoder.Encode(&rgba[0], width, height);
+  encoder.Save("qoi_round_trip.qoi");
+  EXPECT_TRUE(encoder.BufferSize() < rgba.size());
+
+  std::vector<unsigned char> decoded;
+  int decoded_width, decoded_height;
+  ASSERT_TRUE(vtkh::QOIEncoder::Decode(encoder.Buffer(),
+                                       encoder.BufferSize(),
+                                       decoded,
+                                       decoded_width,
+                                       decoded_height));
+  ASSERT_EQ(decoded_width, static_cast<unsigned>(width));
+  ASSERT_EQ(decoded_height, static_cast<unsigned>(height));
+  // qoi is top row first
+  for(int y = 0; y < height; ++y)
+  {
+    EXPECT_EQ(memcmp(&decoded[y * width * 4],
+                     &rgba[(height - y - 1) * width * 4],
+                     width * 4), 0);
+  }
+}
+
+//----------------------------------------------------------------------------
+TEST(vtkh_image_writer, vtkh_raw_write)
+{
+  const int width = 64;
+  const int height = 32;
+  std::vector<unsigned char> rgba = make_gradient(width, height, 0);
+  std::vector<float> depths(width * height, 0.5f);
+
+  vtkh::AsyncImageWriter *writer = vtkh::AsyncImageWriter::Instance();
+  writer->Write(rgba, depths, width, height, std::vector<std::string>(),
+                "raw_write", vtkh::IMAGE_RAW);
+  writer->Flush();
+
+  std::ifstream file("raw_write.raw", std::ios::binary | std::ios::ate);
+  ASSERT_TRUE(file.good());
+  const size_t expected = 16 + width * height * (4 + sizeof(float));
+  EXPECT_EQ(static_cast<size_t>(file.tellg()), expected);
+}
@@ -0,0 +1,99 @@
+//-----------------------------------------------------------------------------
+///
+/// file: t_vtk-h_isosurface_renderer.cpp
+///
+//-----------------------------------------------------------------------------
+
+#include "gtest/gtest.h"
+
+#include <vtkh/vtkh.hpp>
+#include <vtkh/DataSet.hpp>
+#include <vtkh/rendering/IsosurfaceRenderer.hpp>
+#include <vtkh/rendering/MeshRenderer.hpp>
+#include <vtkh/rendering/Scene.hpp>
+#include "t_test_utils.hpp"
+
+#include <iostream>
+
+
+
+//----------------------------------------------------------------------------
+TEST(vtkh_isosurface_renderer, vtkh_serial_render)
+{
+  vtkh::DataSet data_set;
+
+  const int base_size = 32;
+  const int num_blocks = 2;
+
+  for(int i = 0; i < num_blocks; ++i)
+  {
+    data_set.AddDomain(CreateTestData(i, num_blocks, base_size), i);
+  }
+
+  vtkm::Bounds bounds = data_set.GetGlobalBounds();
+
+  vtkm::rendering::Camera camera;
+  camera.SetPosition(vtkm::Vec<vtkm::Float64,3>(-16, -16, -16));
+  camera.ResetToBounds(bounds);
+  vtkh::Render render = vtkh::MakeRender(512,
+                                         512,
+                                         camera,
+                                         data_set,
+                                         "isosurface_renderer");
+  vtkh::IsosurfaceRenderer tracer;
+
+  tracer.SetInput(&data_set);
+  tracer.SetField("point_data_Float64");
+  tracer.SetIsoValue((float)base_size * (float)num_blocks * 0.5f);
+
+  vtkh::Scene scene;
+  scene.AddRender(render);
+  scene.AddRenderer(&tracer);
+  scene.Render();
+}
+
+//----------------------------------------------------------------------------
+TEST(vtkh_isosurface_renderer, vtkh_multiple_values_with_mesh)
+{
+  vtkh::DataSet data_set;
+
+  const int base_size = 32;
+  const int num_blocks = 2;
+
+  for(int i = 0; i < num_blocks; ++i)
+  {
+    data_set.AddDomain(CreateTestData(i, num_blocks, base_size), i);
+  }
+
+  vtkm::Bounds bounds = data_set.GetGlobalBounds();
+
+  vtkm::rendering::Camera camera;
+  camera.SetPosition(vtkm::Vec<vtkm::Float64,3>(-16, -16, -16));
+  camera.ResetToBounds(bounds);
+  vtkh::Render render = vtkh::MakeRender(512,
+                                         512,
+                                         camera,
+                                         data_set,
+                                         "isosurface_renderer_mesh");
+  vtkh::IsosurfaceRenderer tracer;
+
+  const int num_vals = 3;
+  double iso_vals[num_vals];
+  iso_vals[0] = -1; // ask for something that does not exist
+  iso_vals[1] = (float)base_size * (float)num_blocks * 0.25f;
+  iso_vals[2] = (float)base_size * (float)num_blocks * 0.5f;
+
+  tracer.SetInput(&data_set);
+  tracer.SetField("point_data_Float64");
+  tracer.SetIsoValues(iso_vals, num_vals);
+
+  vtkh::MeshRenderer mesher;
+  mesher.SetInput(&data_set);
+  mesher.SetField("point_data_Float64");
+
+  vtkh::Scene scene;
+  scene.AddRender(render);
+  scene.AddRenderer(&tracer);
+  scene.AddRenderer(&mesher);
+  scene.Render();
+}
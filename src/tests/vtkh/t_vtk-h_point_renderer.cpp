@@ -11,8 +11,11 @@
 #include <vtkh/rendering/PointRenderer.hpp>
 #include <vtkh/filters/MarchingCubes.hpp>
 #include <vtkh/rendering/Scene.hpp>
+#include <vtkm/cont/DataSetBuilderExplicit.h>
+#include <lodepng.h>
 #include "t_test_utils.hpp"
 
+#include <cstdlib>
 #include <iostream>
 
 
@@ -142,3 +145,147 @@ TEST(vtkh_point_renderer, vtkh_point_no_data)
   scene.Render();
 
 }
+
+TEST(vtkh_point_renderer, vtkh_point_lod_render)
+{
+  vtkh::DataSet data_set;
+
+  // more points than pixels so the level of detail kicks in
+  const int num_points = 100000;
+  data_set.AddDomain(CreateTestDataPoints(num_points), 0);
+
+  vtkm::Bounds bounds = data_set.GetGlobalBounds();
+
+  vtkm::rendering::Camera camera;
+  camera.ResetToBounds(bounds);
+  vtkh::Render render = vtkh::MakeRender(256,
+                                         256,
+                                         camera,
+                                         data_set,
+                                         "render_points_lod");
+  vtkh::PointRenderer renderer;
+  renderer.SetInput(&data_set);
+  renderer.SetField("point_data_Float64");
+  renderer.UseLevelOfDetail(true);
+
+  vtkh::Scene scene;
+  scene.AddRenderer(&renderer);
+  scene.AddRender(render);
+  scene.Render();
+
+}
+
+TEST(vtkh_point_renderer, vtkh_point_lod_batches)
+{
+  vtkh::DataSet data_set;
+
+  const int num_points = 100000;
+  data_set.AddDomain(CreateTestDataPoints(num_points), 0);
+
+  vtkm::Bounds bounds = data_set.GetGlobalBounds();
+
+  vtkh::PointRenderer renderer;
+  renderer.SetInput(&data_set);
+  renderer.SetField("point_data_Float64");
+  renderer.UseLevelOfDetail(true);
+
+  // every batch merges the points again, so each one has to
+  // start from the original input
+  vtkh::Scene scene;
+  scene.SetRenderBatchSize(2);
+  scene.AddRenderer(&renderer);
+  for(int i = 0; i < 5; ++i)
+  {
+    vtkm::rendering::Camera camera;
+    camera.ResetToBounds(bounds);
+    camera.Azimuth(i * 20.f);
+    vtkh::Render render = vtkh::MakeRender(256,
+                                           256,
+                                           camera,
+                                           data_set,
+                                           "render_points_lod_batch_" + std::to_string(i));
+    scene.AddRender(render);
+  }
+  scene.Render();
+  scene.Render();
+
+  EXPECT_EQ(renderer.GetInput(), &data_set);
+  EXPECT_EQ(data_set.GetNumberOfCells(), num_points);
+}
+
+vtkm::cont::DataSet CreateSinglePoint(double x, double y, double z)
+{
+  std::vector<double> x_vals(1, x);
+  std::vector<double> y_vals(1, y);
+  std::vector<double> z_vals(1, z);
+  std::vector<vtkm::UInt8> shapes(1, vtkm::CELL_SHAPE_VERTEX);
+  std::vector<vtkm::IdComponent> num_indices(1, 1);
+  std::vector<vtkm::Id> conn(1, 0);
+  vtkm::cont::DataSetBuilderExplicit builder;
+  vtkm::cont::DataSet data_set = builder.Create(x_vals,
+                                                y_vals,
+                                                z_vals,
+                                                shapes,
+                                                num_indices,
+                                                conn);
+  std::vector<double> field(1, 1.);
+  data_set.AddField(vtkm::cont::make_Field("point_data_Float64",
+                                           vtkm::cont::Field::Association::POINTS,
+                                           field,
+                                           vtkm::CopyFlag::On));
+  return data_set;
+}
+
+TEST(vtkh_point_renderer, vtkh_point_edge_culling)
+{
+  // the second point is just outside the right edge of the
+  // image, but its sphere reaches into the image
+  vtkh::DataSet data_set;
+  data_set.AddDomain(CreateSinglePoint(0., 0., 0.), 0);
+  data_set.AddDomain(CreateSinglePoint(2.9, 0., 0.), 1);
+
+  vtkm::rendering::Camera camera;
+  camera.SetPosition(vtkm::Vec<vtkm::Float64,3>(0., 0., 10.));
+  camera.SetLookAt(vtkm::Vec<vtkm::Float64,3>(0., 0., 0.));
+  camera.SetViewUp(vtkm::Vec<vtkm::Float64,3>(0., 1., 0.));
+  camera.SetFieldOfView(30.f);
+  camera.SetClippingRange(1., 100.);
+  vtkh::Render render = vtkh::MakeRender(64,
+                                         64,
+                                         camera,
+                                         data_set,
+                                         "render_point_edge");
+  render.DoRenderAnnotations(false);
+
+  vtkh::PointRenderer renderer;
+  renderer.SetInput(&data_set);
+  renderer.SetField("point_data_Float64");
+  renderer.SetRange(vtkm::Range(0., 1.));
+  renderer.SetBaseRadius(0.5f);
+
+  vtkh::Scene scene;
+  scene.AddRenderer(&renderer);
+  scene.AddRender(render);
+  scene.Render();
+
+  unsigned char *rgba = nullptr;
+  unsigned width, height;
+  ASSERT_EQ(vtkh::lodepng_decode32_file(&rgba, &width, &height, "render_point_edge.png"), 0);
+  ASSERT_EQ(width, 64);
+
+  // the right most columns show part of the sphere
+  int covered = 0;
+  for(unsigned y = 0; y < height; ++y)
+  {
+    for(unsigned x = width - 3; x < width; ++x)
+    {
+      const unsigned char *pixel = rgba + (y * width + x) * 4;
+      if(pixel[0] + pixel[1] + pixel[2] > 0)
+      {
+        covered++;
+      }
+    }
+  }
+  EXPECT_GT(covered, 0);
+  free(rgba);
+}
@@ -20,7 +20,6 @@
 //----------------------------------------------------------------------------
 TEST(vtkh_raytracer, vtkh_parallel_render)
 {
-  MPI_Init(NULL, NULL);
   int comm_size, rank;
   MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
@@ -58,6 +57,100 @@ TEST(vtkh_raytracer, vtkh_parallel_render)
   scene.AddRender(render);
   scene.AddRenderer(&tracer);
   scene.Render();
+}
+
+//----------------------------------------------------------------------------
+TEST(vtkh_raytracer, vtkh_parallel_blend)
+{
+  int comm_size, rank;
+  MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  ASSERT_EQ(comm_size, 2);
+
+  vtkh::SetMPICommHandle(MPI_Comm_c2f(MPI_COMM_WORLD));
+
+  // a unit cube per rank, the cube of rank 1 is closer to the camera
+  vtkm::Id3 point_dims(2, 2, 2);
+  vtkm::Vec<vtkm::Float32,3> origin(0.f, 0.f, 2.f * rank);
+  vtkm::Vec<vtkm::Float32,3> spacing(1.f, 1.f, 1.f);
+  UniformCoords point_handle(point_dims, origin, spacing);
+
+  vtkm::cont::DataSet cube;
+  cube.AddCoordinateSystem(vtkm::cont::CoordinateSystem("coords", point_handle));
+  vtkm::cont::CellSetStructured<3> cell_set;
+  cell_set.SetPointDimensions(point_dims);
+  cube.SetCellSet(cell_set);
+  std::vector<vtkm::Float32> values(8, static_cast<vtkm::Float32>(rank));
+  cube.AddField(vtkm::cont::make_FieldPoint("rank",
+                                            vtkm::cont::make_ArrayHandle(values, vtkm::CopyFlag::On)));
+
+  vtkh::DataSet data_set;
+  data_set.AddDomain(cube, rank);
+
+  vtkm::rendering::Camera camera;
+  camera.SetPosition(vtkm::Vec<vtkm::Float64,3>(0.5, 0.5, 10.));
+  camera.SetLookAt(vtkm::Vec<vtkm::Float64,3>(0.5, 0.5, 0.));
+  camera.SetViewUp(vtkm::Vec<vtkm::Float64,3>(0., 1., 0.));
+  camera.SetClippingRange(1., 20.);
+
+  float bg_color[4] = {0.f, 0.f, 0.f, 1.f};
+  vtkh::Render render = vtkh::MakeRender(64,
+                                         64,
+                                         camera,
+                                         data_set,
+                                         "ray_tracer_blend_par",
+                                         bg_color);
+  render.DoRenderAnnotations(false);
+  render.SetShadingOn(false);
+
+  // rank 0 is red and rank 1 is blue, both half transparent
+  vtkm::cont::ColorTable color_table(vtkm::Range(0., 1.),
+                                     vtkm::Vec<vtkm::Float32,3>(1.f, 0.f, 0.f),
+                                     vtkm::Vec<vtkm::Float32,3>(0.f, 0.f, 1.f));
+  color_table.AddPointAlpha(0.0, 0.5f);
+  color_table.AddPointAlpha(1.0, 0.5f);
+
+  vtkh::RayTracer tracer;
+  tracer.SetInput(&data_set);
+  tracer.SetField("rank");
+  tracer.SetRange(vtkm::Range(0., 1.));
+  tracer.SetColorTable(color_table);
+  tracer.SetBlendComposite(true);
+  EXPECT_TRUE(tracer.GetBlendComposite());
+
+  std::vector<unsigned char> center;
+  vtkh::Scene scene;
+  scene.AddRender(render);
+  scene.AddRenderer(&tracer);
+  scene.SetImageSink([&](const vtkh::RenderedImage &image)
+  {
+    const int pixel = (image.m_height / 2) * image.m_width + image.m_width / 2;
+    center.assign(image.m_rgba_bytes + pixel * 4, image.m_rgba_bytes + pixel * 4 + 4);
+  });
+  scene.Render();
+
+  if(rank != 0)
+  {
+    return;
+  }
+
+  // premultiplied blue over red over the black background:
+  // (0, 0, 0.5) + 0.5 * (0.5, 0, 0) = (0.25, 0, 0.5)
+  ASSERT_EQ(center.size(), 4u);
+  EXPECT_NEAR(center[0], 64, 3);
+  EXPECT_NEAR(center[1], 0, 3);
+  EXPECT_NEAR(center[2], 128, 3);
+  EXPECT_EQ(center[3], 255);
+}
+
+int main(int argc, char* argv[])
+{
+    int result = 0;
+
+    ::testing::InitGoogleTest(&argc, argv);
+    MPI_Init(&argc, &argv);
+    result = RUN_ALL_TESTS();
+    MPI_Finalize();
 
-  MPI_Finalize();
+    return result;
 }
@@ -8,10 +8,19 @@
 
 #include <vtkh/vtkh.hpp>
 #include <vtkh/DataSet.hpp>
+#include <vtkh/rendering/Fingerprint.hpp>
+#include <vtkh/rendering/ImageDatabase.hpp>
 #include <vtkh/rendering/RayTracer.hpp>
 #include <vtkh/rendering/Scene.hpp>
+#include <vtkh/utils/AsyncImageWriter.hpp>
+#include <vtkh/utils/vtkm_array_utils.hpp>
+#include <lodepng.h>
 #include "t_test_utils.hpp"
 
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
 
@@ -160,3 +169,520 @@ TEST(vtkh_render, vtkh_bg_color)
   scene.AddRenderer(&tracer);
   scene.Render();
 }
+
+TEST(vtkh_render, vtkh_image_database)
+{
+  vtkh::DataSet data_set;
+
+  const int base_size = 32;
+  const int num_blocks = 2;
+
+  for(int i = 0; i < num_blocks; ++i)
+  {
+    data_set.AddDomain(CreateTestData(i, num_blocks, base_size), i);
+  }
+
+  vtkm::Bounds bounds = data_set.GetGlobalBounds();
+
+  const int num_images = 4;
+  std::vector<vtkh::Render> renders;
+  for(int i = 0; i < num_images; ++i)
+  {
+    vtkm::rendering::Camera camera;
+    camera.ResetToBounds(bounds);
+    camera.Azimuth(90.f * i);
+    renders.push_back(vtkh::MakeRender(256,
+                                       128,
+                                       camera,
+                                       data_set,
+                                       "database_" + std::to_string(i)));
+  }
+
+  vtkh::RayTracer tracer;
+  tracer.SetInput(&data_set);
+  tracer.SetField("point_data_Float64");
+
+  vtkh::Scene scene;
+  scene.SetRenders(renders);
+  scene.AddRenderer(&tracer);
+  scene.SetRenderBatchSize(3);
+  scene.SetImageDatabase("image_database.vtkhdb", true);
+  scene.Render();
+
+  vtkh::ImageDatabase database;
+  database.Open("image_database.vtkhdb");
+  ASSERT_EQ(database.GetNumberOfImages(), num_images);
+  for(int i = 0; i < num_images; ++i)
+  {
+    const int index = database.FindImage("database_" + std::to_string(i));
+    ASSERT_EQ(index, i);
+    EXPECT_EQ(database.GetWidth(index), 256);
+    EXPECT_EQ(database.GetHeight(index), 128);
+    EXPECT_TRUE(database.HasDepth(index));
+    // the background is opaque
+    EXPECT_EQ(database.GetColor(index)[3], 255);
+  }
+}
+
+TEST(vtkh_render, vtkh_image_sink)
+{
+  vtkh::DataSet data_set;
+
+  const int base_size = 32;
+  const int num_blocks = 2;
+
+  for(int i = 0; i < num_blocks; ++i)
+  {
+    data_set.AddDomain(CreateTestData(i, num_blocks, base_size), i);
+  }
+
+  vtkm::Bounds bounds = data_set.GetGlobalBounds();
+
+  vtkm::rendering::Camera camera;
+  camera.ResetToBounds(bounds);
+  vtkh::Render render = vtkh::MakeRender(256,
+                                         128,
+                                         camera,
+                                         data_set,
+                                         "sink");
+
+  vtkh::RayTracer tracer;
+  tracer.SetInput(&data_set);
+  tracer.SetField("point_data_Float64");
+
+  // the composited color bytes and the canvas depths
+  int num_images = 0;
+  vtkh::Scene scene;
+  scene.AddRender(render);
+  scene.AddRenderer(&tracer);
+  scene.SetImageSink([&](const vtkh::RenderedImage &image)
+  {
+    num_images++;
+    EXPECT_EQ(image.m_name, "sink");
+    EXPECT_EQ(image.m_width, 256);
+    EXPECT_EQ(image.m_height, 128);
+    EXPECT_TRUE(image.m_rgba == nullptr);
+    EXPECT_TRUE(image.m_rgba_bytes != nullptr);
+    EXPECT_TRUE(image.m_depths != nullptr);
+    EXPECT_TRUE(image.m_encoded == nullptr);
+  });
+  scene.Render();
+  EXPECT_EQ(num_images, 1);
+
+  // encoded png bytes
+  std::vector<unsigned char> png;
+  scene.SetImageSink([&](const vtkh::RenderedImage &image)
+  {
+    png.assign(image.m_encoded, image.m_encoded + image.m_encoded_size);
+  }, true);
+  scene.Render();
+  ASSERT_TRUE(png.size() > 8);
+  EXPECT_EQ(png[1], 'P');
+  EXPECT_EQ(png[2], 'N');
+  EXPECT_EQ(png[3], 'G');
+}
+
+TEST(vtkh_render, vtkh_color_bytes)
+{
+  vtkm::Bounds bounds(0., 1., 0., 1., 0., 1.);
+  float bg_color[4] = {0.f, 0.f, 1.f, 1.f};
+  vtkh::Render render = vtkh::MakeRender(4, 2, bounds, "bytes", bg_color);
+  EXPECT_FALSE(render.HasColorBytes());
+
+  // half transparent red
+  std::vector<unsigned char> rgba(4 * 2 * 4, 0);
+  for(int i = 0; i < 8; ++i)
+  {
+    rgba[i * 4 + 0] = 128;
+    rgba[i * 4 + 3] = 128;
+  }
+  render.SetColorBytes(rgba);
+  EXPECT_TRUE(render.HasColorBytes());
+
+  // copies share the bytes
+  vtkh::Render shared = render;
+  EXPECT_TRUE(shared.HasColorBytes());
+  EXPECT_FALSE(render.Copy().HasColorBytes());
+
+  render.RenderBackground();
+  const unsigned char *bytes = render.GetColorBytes();
+  EXPECT_EQ(bytes[0], 128);
+  EXPECT_EQ(bytes[2], 127);
+  EXPECT_EQ(bytes[3], 255);
+
+  render.SyncCanvasColors();
+  EXPECT_FALSE(shared.HasColorBytes());
+  const float *colors = &vtkh::GetVTKMPointer(render.GetCanvas().GetColorBuffer())[0][0];
+  EXPECT_NEAR(colors[0], 128.f / 255.f, 1e-6f);
+  EXPECT_NEAR(colors[2], 127.f / 255.f, 1e-6f);
+  EXPECT_NEAR(colors[3], 1.f, 1e-6f);
+}
+
+TEST(vtkh_render, vtkh_save_waits)
+{
+  vtkm::Bounds bounds(0., 1., 0., 1., 0., 1.);
+  float bg_color[4] = {0.f, 0.f, 1.f, 1.f};
+  vtkh::Render render = vtkh::MakeRender(8, 4, bounds, "save_waits", bg_color);
+  render.RenderBackground();
+  std::remove("save_waits.png");
+
+  // outside of a scene nobody flushes the writer,
+  // so the file has to be there when Save returns
+  vtkh::AsyncImageWriter::Instance()->SetEnabled(true);
+  render.Save();
+
+  unsigned char *rgba = nullptr;
+  unsigned width, height;
+  ASSERT_EQ(vtkh::lodepng_decode32_file(&rgba, &width, &height, "save_waits.png"), 0);
+  EXPECT_EQ(width, 8u);
+  EXPECT_EQ(height, 4u);
+  free(rgba);
+}
+
+TEST(vtkh_render, vtkh_save_twice)
+{
+  vtkh::DataSet data_set;
+  const int base_size = 32;
+  const int num_blocks = 2;
+  for(int i = 0; i < num_blocks; ++i)
+  {
+    data_set.AddDomain(CreateTestData(i, num_blocks, base_size), i);
+  }
+
+  vtkm::rendering::Camera camera;
+  camera.ResetToBounds(data_set.GetGlobalBounds());
+  vtkh::Render render = vtkh::MakeRender(128,
+                                         128,
+                                         camera,
+                                         data_set,
+                                         "save_first");
+
+  vtkh::RayTracer tracer;
+  tracer.SetInput(&data_set);
+  tracer.SetField("point_data_Float64");
+
+  vtkh::Scene scene;
+  scene.AddRender(render);
+  scene.AddRenderer(&tracer);
+  scene.Render();
+
+  // saving must not use up the composited colors
+  EXPECT_TRUE(render.HasColorBytes());
+  render.SetImageName("save_second");
+  render.Save();
+
+  unsigned char *first = nullptr;
+  unsigned char *second = nullptr;
+  unsigned width, height;
+  ASSERT_EQ(vtkh::lodepng_decode32_file(&first, &width, &height, "save_first.png"), 0);
+  ASSERT_EQ(vtkh::lodepng_decode32_file(&second, &width, &height, "save_second.png"), 0);
+  EXPECT_EQ(memcmp(first, second, width * height * 4), 0);
+  free(first);
+  free(second);
+}
+
+TEST(vtkh_render, vtkh_annotation_layers)
+{
+  vtkm::Bounds bounds(0., 1., 0., 1., 0., 1.);
+  std::vector<std::string> field_names(1, "field");
+  std::vector<vtkm::Range> ranges(1, vtkm::Range(0., 1.));
+  std::vector<vtkm::cont::ColorTable> color_tables(1, vtkm::cont::ColorTable("cool to warm"));
+
+  // annotations drawn directly on the canvas
+  vtkh::Render direct = vtkh::MakeRender(128, 128, bounds, "direct");
+  direct.GetCanvas().Clear();
+  direct.RenderWorldAnnotations();
+  direct.RenderScreenAnnotations(field_names, ranges, color_tables);
+  direct.RenderBackground();
+  const float *colors = &vtkh::GetVTKMPointer(direct.GetCanvas().GetColorBuffer())[0][0];
+
+  vtkh::AnnotationLayers layers;
+  vtkh::Render layered = vtkh::MakeRender(128, 128, bounds, "layered");
+  layered.GetCanvas().Clear();
+  layered.RenderAnnotations(field_names, ranges, color_tables, layers);
+  EXPECT_EQ(layers.size(), 2);
+  ASSERT_TRUE(layered.HasColorBytes());
+
+  const unsigned char *bytes = layered.GetColorBytes();
+  int max_diff = 0;
+  for(int i = 0; i < 128 * 128 * 4; ++i)
+  {
+    const int expected = static_cast<int>(colors[i] * 255.f);
+    max_diff = std::max(max_diff, std::abs(expected - static_cast<int>(bytes[i])));
+  }
+  EXPECT_LE(max_diff, 2);
+
+  // the same camera reuses both layers
+  vtkh::Render again = layered.Copy();
+  again.RenderAnnotations(field_names, ranges, color_tables, layers);
+  EXPECT_EQ(layers.size(), 2);
+
+  // a new camera only adds a world layer
+  vtkm::rendering::Camera camera = again.GetCamera();
+  camera.Azimuth(30.f);
+  again.SetCamera(camera);
+  again.RenderAnnotations(field_names, ranges, color_tables, layers);
+  EXPECT_EQ(layers.size(), 3);
+}
+
+TEST(vtkh_render, vtkh_tiled_render)
+{
+  vtkh::DataSet data_set;
+
+  const int base_size = 32;
+  const int num_blocks = 2;
+
+  for(int i = 0; i < num_blocks; ++i)
+  {
+    data_set.AddDomain(CreateTestData(i, num_blocks, base_size), i);
+  }
+
+  vtkm::Bounds bounds = data_set.GetGlobalBounds();
+
+  vtkm::rendering::Camera camera;
+  camera.ResetToBounds(bounds);
+  camera.Azimuth(-30.f);
+  camera.Elevation(-30.f);
+  vtkh::Render render = vtkh::MakeRender(200,
+                                         128,
+                                         camera,
+                                         data_set,
+                                         "untiled");
+  render.DoRenderAnnotations(false);
+
+  vtkh::Render tiled = render.Copy();
+  tiled.SetImageName("tiled");
+  tiled.SetTileHeight(50);
+  EXPECT_TRUE(tiled.IsTiled());
+  EXPECT_EQ(tiled.GetNumberOfTiles(), 3);
+  EXPECT_EQ(tiled.GetTileStart(0), 78);
+  EXPECT_EQ(tiled.GetTileStart(2), 0);
+  EXPECT_EQ(tiled.MakeTile(2).GetHeight(), 28);
+
+  vtkh::RayTracer tracer;
+  tracer.SetInput(&data_set);
+  tracer.SetField("point_data_Float64");
+
+  vtkh::Scene scene;
+  scene.AddRender(render);
+  scene.AddRender(tiled);
+  scene.AddRenderer(&tracer);
+  scene.Render();
+
+  unsigned char *untiled_rgba = nullptr;
+  unsigned char *tiled_rgba = nullptr;
+  unsigned width, height;
+  ASSERT_EQ(vtkh::lodepng_decode32_file(&untiled_rgba, &width, &height, "untiled.png"), 0);
+  ASSERT_EQ(vtkh::lodepng_decode32_file(&tiled_rgba, &width, &height, "tiled.png"), 0);
+  EXPECT_EQ(width, 200);
+  EXPECT_EQ(height, 128);
+
+  // the bands see the scene through slightly different rays
+  int different = 0;
+  for(int i = 0; i < 200 * 128; ++i)
+  {
+    for(int c = 0; c < 4; ++c)
+    {
+      if(std::abs(untiled_rgba[i * 4 + c] - tiled_rgba[i * 4 + c]) > 8)
+      {
+        different++;
+        break;
+      }
+    }
+  }
+  EXPECT_LT(different, 200 * 128 / 100);
+  free(untiled_rgba);
+  free(tiled_rgba);
+}
+
+TEST(vtkh_render, vtkh_tiled_render_validation)
+{
+  vtkh::DataSet data_set;
+
+  const int base_size = 32;
+  const int num_blocks = 2;
+
+  for(int i = 0; i < num_blocks; ++i)
+  {
+    data_set.AddDomain(CreateTestData(i, num_blocks, base_size), i);
+  }
+
+  vtkm::Bounds bounds = data_set.GetGlobalBounds();
+
+  vtkm::rendering::Camera camera;
+  camera.ResetToBounds(bounds);
+  vtkh::Render render = vtkh::MakeRender(128,
+                                         128,
+                                         camera,
+                                         data_set,
+                                         "invalid_untiled");
+
+  // tiles need a 3D camera
+  vtkh::Render tiled = render.Copy();
+  tiled.SetImageName("invalid_tiled");
+  tiled.SetTileHeight(50);
+  camera.SetModeTo2D();
+  tiled.SetCamera(camera);
+
+  std::remove("invalid_untiled.png");
+  std::remove("invalid_tiles.vtkhdb");
+
+  vtkh::RayTracer tracer;
+  tracer.SetInput(&data_set);
+  tracer.SetField("point_data_Float64");
+
+  vtkh::Scene scene;
+  scene.AddRender(render);
+  scene.AddRender(tiled);
+  scene.AddRenderer(&tracer);
+  scene.SetImageDatabase("invalid_tiles.vtkhdb", true);
+  EXPECT_THROW(scene.Render(), vtkh::Error);
+
+  // nothing is written before the images are validated
+  EXPECT_EQ(std::fopen("invalid_tiles.vtkhdb", "rb"), nullptr);
+  EXPECT_EQ(std::fopen("invalid_untiled.png", "rb"), nullptr);
+}
+
+// counts how often the plot is actually rendered
+class CountingRayTracer : public vtkh::RayTracer
+{
+public:
+  int m_updates = 0;
+  void Update() override
+  {
+    m_updates++;
+    vtkh::RayTracer::Update();
+  }
+};
+
+TEST(vtkh_render, vtkh_temporal_reuse)
+{
+  vtkh::DataSet data_set;
+
+  const int base_size = 32;
+  const int num_blocks = 2;
+
+  for(int i = 0; i < num_blocks; ++i)
+  {
+    data_set.AddDomain(CreateTestData(i, num_blocks, base_size), i);
+  }
+
+  vtkm::Bounds bounds = data_set.GetGlobalBounds();
+
+  vtkm::rendering::Camera camera;
+  camera.ResetToBounds(bounds);
+  vtkh::Render render = vtkh::MakeRender(256,
+                                         128,
+                                         camera,
+                                         data_set,
+                                         "reuse");
+
+  CountingRayTracer tracer;
+  tracer.SetInput(&data_set);
+  tracer.SetField("point_data_Float64");
+  tracer.SetRange(vtkm::Range(0., 1.));
+
+  const vtkm::UInt64 fingerprint = tracer.GetFingerprint();
+  EXPECT_EQ(fingerprint, tracer.GetFingerprint());
+
+  std::vector<unsigned char> png;
+  vtkh::Scene scene;
+  scene.AddRender(render);
+  scene.AddRenderer(&tracer);
+  scene.SetTemporalReuse(true);
+  scene.SetImageSink([&](const vtkh::RenderedImage &image)
+  {
+    png.assign(image.m_encoded, image.m_encoded + image.m_encoded_size);
+  }, true);
+
+  scene.Render();
+  const std::vector<unsigned char> first = png;
+  ASSERT_TRUE(first.size() > 8);
+  EXPECT_EQ(tracer.m_updates, 1);
+
+  // nothing changed, the image is reused without rendering
+  png.clear();
+  scene.Render();
+  EXPECT_EQ(png, first);
+  EXPECT_EQ(tracer.m_updates, 1);
+
+  // a new camera is rendered
+  vtkm::rendering::Camera moved = render.GetCamera();
+  moved.Azimuth(30.f);
+  render.SetCamera(moved);
+  scene.SetRenders(std::vector<vtkh::Render>(1, render));
+  png.clear();
+  scene.Render();
+  EXPECT_NE(png, first);
+  EXPECT_EQ(tracer.m_updates, 2);
+
+  // and so is new data seen through the first camera
+  render.SetCamera(camera);
+  scene.SetRenders(std::vector<vtkh::Render>(1, render));
+  vtkm::cont::DataSet &domain = data_set.GetDomain(0);
+  std::vector<vtkm::Float64> values(domain.GetNumberOfPoints(), 0.5);
+  domain.AddField(vtkm::cont::make_FieldPoint("point_data_Float64",
+                                              vtkm::cont::make_ArrayHandle(values, vtkm::CopyFlag::On)));
+  EXPECT_NE(fingerprint, tracer.GetFingerprint());
+  png.clear();
+  scene.Render();
+  EXPECT_NE(png, first);
+  EXPECT_EQ(tracer.m_updates, 3);
+}
+
+TEST(vtkh_render, vtkh_fingerprint_unsupported_field)
+{
+  vtkm::cont::DataSet data_set = CreateTestData(0, 1, 8);
+  std::vector<vtkm::Int32> values(data_set.GetNumberOfPoints(), 1);
+  data_set.AddField(vtkm::cont::make_FieldPoint("ints",
+                                                vtkm::cont::make_ArrayHandle(values, vtkm::CopyFlag::On)));
+
+  // the same data hashes the same
+  vtkh::Fingerprint first;
+  vtkh::Fingerprint second;
+  first.AddDataSet(data_set, "point_data_Float64");
+  second.AddDataSet(data_set, "point_data_Float64");
+  EXPECT_EQ(first.GetValue(), second.GetValue());
+
+  // a field that cannot be hashed always counts as changed
+  vtkh::Fingerprint third;
+  vtkh::Fingerprint fourth;
+  EXPECT_NO_THROW(third.AddDataSet(data_set, "ints"));
+  EXPECT_NO_THROW(fourth.AddDataSet(data_set, "ints"));
+  EXPECT_NE(third.GetValue(), fourth.GetValue());
+}
+
+TEST(vtkh_render, vtkh_data_set_identity)
+{
+  vtkm::cont::DataSet data_set = CreateTestData(0, 1, 8);
+  const std::string field = "point_data_Float64";
+
+  vtkh::DataSetIdentity identity;
+  EXPECT_FALSE(identity.IsSame(data_set, field));
+  identity.Set(data_set, field);
+  EXPECT_TRUE(identity.IsSame(data_set, field));
+
+  // copies of the data set share its arrays
+  vtkm::cont::DataSet copy = data_set;
+  EXPECT_TRUE(identity.IsSame(copy, field));
+  EXPECT_FALSE(identity.IsSame(copy, "cell_data_Float64"));
+
+  // a new array with the same values is not the same array,
+  // but it hashes the same
+  vtkh::Fingerprint before;
+  before.AddDataSet(data_set, field);
+  vtkm::cont::ArrayHandle<vtkm::Float64> array;
+  data_set.GetField(field).GetData().AsArrayHandle(array);
+  auto portal = array.ReadPortal();
+  std::vector<vtkm::Float64> values(portal.GetNumberOfValues());
+  for(size_t i = 0; i < values.size(); ++i)
+  {
+    values[i] = portal.Get(static_cast<vtkm::Id>(i));
+  }
+  copy.AddField(vtkm::cont::make_FieldPoint(field,
+                                            vtkm::cont::make_ArrayHandle(values, vtkm::CopyFlag::On)));
+  EXPECT_FALSE(identity.IsSame(copy, field));
+  vtkh::Fingerprint after;
+  after.AddDataSet(copy, field);
+  EXPECT_EQ(before.GetValue(), after.GetValue());
+}
@@ -60,5 +60,57 @@ TEST(vtkh_scalar_renderer, vtkh_parallel_render)
     writer.WriteDataSet(result);
   }
 
+  delete output;
+
+  // render several cameras in batches
+  const int num_cameras = 5;
+  std::vector<vtkm::rendering::Camera> cameras;
+  for(int i = 0; i < num_cameras; ++i)
+  {
+    vtkm::rendering::Camera orbit;
+    orbit.ResetToBounds(bounds);
+    orbit.Azimuth(72.f * i);
+    orbit.Elevation(-30.f);
+    cameras.push_back(orbit);
+  }
+
+  vtkh::ScalarRenderer batch_tracer;
+  batch_tracer.SetInput(&data_set);
+  batch_tracer.SetCameras(cameras);
+  batch_tracer.SetBatchSize(2);
+  batch_tracer.Update();
+
+  vtkh::DataSet *batch_output = batch_tracer.GetOutput();
+  if(vtkh::GetMPIRank() == 0)
+  {
+    EXPECT_EQ(batch_output->GetNumberOfDomains(), num_cameras);
+    for(int i = 0; i < num_cameras; ++i)
+    {
+      vtkm::cont::DataSet &result = batch_output->GetDomain(i);
+      vtkm::io::VTKDataSetWriter writer("scalar_data_" + std::to_string(i) + ".vtk");
+      writer.WriteDataSet(result);
+    }
+  }
+  delete batch_output;
+
+  // composite a single field at half precision
+  vtkh::ScalarRenderer field_tracer;
+  field_tracer.SetInput(&data_set);
+  field_tracer.SetCamera(camera);
+  field_tracer.AddField("point_data_Float64");
+  field_tracer.SetHalfPrecisionPayload(true);
+  field_tracer.Update();
+
+  vtkh::DataSet *field_output = field_tracer.GetOutput();
+  if(vtkh::GetMPIRank() == 0)
+  {
+    vtkm::cont::DataSet &result = field_output->GetDomain(0);
+    EXPECT_TRUE(result.HasField("point_data_Float64"));
+    EXPECT_FALSE(result.HasField("cell_data_Float64"));
+    vtkm::io::VTKDataSetWriter writer("scalar_data_half.vtk");
+    writer.WriteDataSet(result);
+  }
+  delete field_output;
+
   MPI_Finalize();
 }
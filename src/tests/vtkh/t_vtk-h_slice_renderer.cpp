@@ -0,0 +1,91 @@
+//-----------------------------------------------------------------------------
+///
+/// file: t_vtk-h_slice_renderer.cpp
+///
+//-----------------------------------------------------------------------------
+
+#include "gtest/gtest.h"
+
+#include <vtkh/vtkh.hpp>
+#include <vtkh/DataSet.hpp>
+#include <vtkh/rendering/SliceRenderer.hpp>
+#include <vtkh/rendering/Scene.hpp>
+#include "t_test_utils.hpp"
+
+#include <iostream>
+
+//----------------------------------------------------------------------------
+TEST(vtkh_slice_renderer, vtkh_point_field)
+{
+  vtkh::DataSet data_set;
+
+  const int base_size = 32;
+  const int num_blocks = 2;
+
+  for(int i = 0; i < num_blocks; ++i)
+  {
+    data_set.AddDomain(CreateTestData(i, num_blocks, base_size), i);
+  }
+
+  vtkm::Bounds bounds = data_set.GetGlobalBounds();
+  float bg_color[4] = { 0.f, 0.f, 0.f, 1.f};
+  vtkm::rendering::Camera camera;
+  camera.SetPosition(vtkm::Vec<vtkm::Float64,3>(-16, -16, -16));
+  camera.ResetToBounds(bounds);
+  vtkh::Render render = vtkh::MakeRender(512,
+                                         512,
+                                         camera,
+                                         data_set,
+                                         "slice_renderer",
+                                          bg_color);
+
+  vtkh::SliceRenderer slicer;
+  vtkm::Vec<vtkm::Float32,3> normal(.5f,.5f,.5f);
+  vtkm::Vec<vtkm::Float32,3> point(32.f,32.f,32.f);
+  slicer.AddPlane(point, normal);
+  slicer.AddPlane(point, vtkm::Vec<vtkm::Float32,3>(1.f, 0.f, 0.f));
+  slicer.SetInput(&data_set);
+  slicer.SetField("point_data_Float64");
+
+  vtkh::Scene scene;
+  scene.AddRenderer(&slicer);
+  scene.AddRender(render);
+  scene.Render();
+}
+
+//----------------------------------------------------------------------------
+TEST(vtkh_slice_renderer, vtkh_cell_field)
+{
+  vtkh::DataSet data_set;
+
+  const int base_size = 32;
+  const int num_blocks = 2;
+
+  for(int i = 0; i < num_blocks; ++i)
+  {
+    data_set.AddDomain(CreateTestData(i, num_blocks, base_size), i);
+  }
+
+  vtkm::Bounds bounds = data_set.GetGlobalBounds();
+  float bg_color[4] = { 0.f, 0.f, 0.f, 1.f};
+  vtkm::rendering::Camera camera;
+  camera.ResetToBounds(bounds);
+  vtkh::Render render = vtkh::MakeRender(512,
+                                         512,
+                                         camera,
+                                         data_set,
+                                         "slice_renderer_cell",
+                                          bg_color);
+
+  vtkh::SliceRenderer slicer;
+  vtkm::Vec<vtkm::Float32,3> normal(0.f,0.f,1.f);
+  vtkm::Vec<vtkm::Float32,3> point(32.f,32.f,32.f);
+  slicer.AddPlane(point, normal);
+  slicer.SetInput(&data_set);
+  slicer.SetField("cell_data_Float64");
+
+  vtkh::Scene scene;
+  scene.AddRenderer(&slicer);
+  scene.AddRender(render);
+  scene.Render();
+}
@@ -11,6 +11,7 @@
 #include <vtkh/filters/IsoVolume.hpp>
 #include <vtkh/rendering/Scene.hpp>
 #include <vtkh/rendering/VolumeRenderer.hpp>
+#include <vtkh/compositing/PartialPacking.hpp>
 #include "t_test_utils.hpp"
 
 #include <iostream>
@@ -115,3 +116,140 @@ TEST(vtkh_volume_renderer, vtkh_parallel_render)
   scene.AddRenderer(&tracer);
   scene.Render();
 }
+
+TEST(vtkh_volume_renderer, vtkh_sparse_transfer_function)
+{
+
+  vtkh::DataSet data_set;
+
+  const int base_size = 32;
+  const int num_blocks = 4;
+
+  for(int i = 0; i < num_blocks; ++i)
+  {
+    data_set.AddDomain(CreateTestData(i, num_blocks, base_size), i);
+  }
+
+  vtkm::Bounds bounds = data_set.GetGlobalBounds();
+
+  vtkm::rendering::Camera camera;
+  vtkm::Vec<vtkm::Float32,3> pos = camera.GetPosition();
+  pos[0]+=.1;
+  pos[1]+=.1;
+  camera.SetPosition(pos);
+  camera.ResetToBounds(bounds);
+  vtkh::Render render = vtkh::MakeRender(512,
+                                         512,
+                                         camera,
+                                         data_set,
+                                         "volume_sparse");
+
+  // only the upper part of the range is visible so
+  // transparent domains and bricks should be skipped
+  vtkm::cont::ColorTable color_map("Cool to Warm");
+  color_map.AddPointAlpha(0.0, 0.0);
+  color_map.AddPointAlpha(0.7, 0.0);
+  color_map.AddPointAlpha(1.0, 0.6);
+
+  vtkh::VolumeRenderer tracer;
+  tracer.SetColorTable(color_map);
+  tracer.SetInput(&data_set);
+  tracer.SetField("point_data_Float64");
+
+  vtkh::Scene scene;
+  scene.AddRender(render);
+  scene.AddRenderer(&tracer);
+  scene.Render();
+}
+
+TEST(vtkh_volume_renderer, vtkh_tiled_render_unstructured)
+{
+
+  vtkh::DataSet data_set;
+
+  const int base_size = 32;
+  const int num_blocks = 2;
+
+  for(int i = 0; i < num_blocks; ++i)
+  {
+    data_set.AddDomain(CreateTestData(i, num_blocks, base_size), i);
+  }
+
+  vtkh::IsoVolume iso;
+
+  vtkm::Range iso_range;
+  iso_range.Min = 10.;
+  iso_range.Max = 40.;
+  iso.SetRange(iso_range);
+  iso.SetField("point_data_Float64");
+  iso.SetInput(&data_set);
+  iso.Update();
+
+  vtkh::DataSet *iso_output = iso.GetOutput();
+
+  vtkm::Bounds bounds = iso_output->GetGlobalBounds();
+
+  vtkm::rendering::Camera camera;
+  vtkm::Vec<vtkm::Float32,3> pos = camera.GetPosition();
+  pos[0]+=.1;
+  pos[1]+=.1;
+  camera.SetPosition(pos);
+  camera.ResetToBounds(bounds);
+  vtkh::Render render = vtkh::MakeRender(512,
+                                         512,
+                                         camera,
+                                         *iso_output,
+                                         "volume_unstructured_tiled");
+
+
+  vtkm::cont::ColorTable color_map("Cool to Warm");
+  color_map.AddPointAlpha(0.0, 0.01);
+  color_map.AddPointAlpha(1.0, 0.6);
+
+  vtkh::VolumeRenderer tracer;
+  tracer.SetColorTable(color_map);
+  tracer.SetInput(iso_output);
+  tracer.SetField("point_data_Float64");
+  // small enough to force several tiles
+  tracer.SetTileMemoryLimit(1024 * 1024);
+
+  vtkh::Scene scene;
+  scene.AddRender(render);
+  scene.AddRenderer(&tracer);
+  scene.Render();
+}
+
+//----------------------------------------------------------------------------
+TEST(vtkh_volume_renderer, vtkh_packed_partials_keep_depth)
+{
+  // partials of one pixel from two messages with very different
+  // depth ranges have to keep their order once they are unpacked
+  std::vector<vtkh::VolumePartial<float>> near_partials(2);
+  near_partials[0].m_pixel_id = 7;
+  near_partials[0].m_depth = 1.00001f;
+  near_partials[1].m_pixel_id = 8;
+  near_partials[1].m_depth = 1000.f;
+
+  std::vector<vtkh::VolumePartial<float>> far_partials(2);
+  far_partials[0].m_pixel_id = 7;
+  far_partials[0].m_depth = 1.00002f;
+  far_partials[1].m_pixel_id = 9;
+  far_partials[1].m_depth = 1.f;
+
+  std::vector<vtkh::VolumePartial<float>> unpacked;
+  std::vector<unsigned char> buffer;
+  vtkh::pack_partials(near_partials, vtkh::WIRE_HALF, buffer);
+  vtkh::unpack_partials(buffer, unpacked);
+  vtkh::pack_partials(far_partials, vtkh::WIRE_BYTE, buffer);
+  vtkh::unpack_partials(buffer, unpacked);
+
+  ASSERT_EQ(unpacked.size(), 4u);
+  for(size_t i = 0; i < near_partials.size(); ++i)
+  {
+    EXPECT_EQ(unpacked[i].m_pixel_id, near_partials[i].m_pixel_id);
+    EXPECT_EQ(unpacked[i].m_depth, near_partials[i].m_depth);
+    EXPECT_EQ(unpacked[i + 2].m_pixel_id, far_partials[i].m_pixel_id);
+    EXPECT_EQ(unpacked[i + 2].m_depth, far_partials[i].m_depth);
+  }
+  EXPECT_LT(unpacked[0].m_depth, unpacked[2].m_depth);
+}
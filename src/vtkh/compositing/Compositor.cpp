@@ -1,5 +1,7 @@
 #include "Compositor.hpp"
+#include <vtkh/Error.hpp>
 #include <vtkh/compositing/ImageCompositor.hpp>
+#include <vtkh/compositing/PartialCompositor.hpp>
 
 #include <assert.h>
 #include <algorithm>
@@ -15,6 +17,68 @@
 namespace vtkh
 {
 
+namespace detail
+{
+
+// every covered pixel is a fragment. Surface renderers write
+// straight colors, so they are premultiplied for the blending
+void image_to_partials(const Image &image, std::vector<VolumePartial<float>> &partials)
+{
+  const int size = static_cast<int>(image.m_depths.size());
+  const float one_over_255 = 1.f / 255.f;
+
+  int count = 0;
+#ifdef VTKH_USE_OPENMP
+  #pragma omp parallel for reduction(+:count)
+#endif
+  for(int i = 0; i < size; ++i)
+  {
+    count += image.m_pixels[i * 4 + 3] != 0 ? 1 : 0;
+  }
+
+  partials.resize(count);
+  int index = 0;
+  for(int i = 0; i < size; ++i)
+  {
+    const unsigned char *pixel = &image.m_pixels[i * 4];
+    if(pixel[3] == 0) continue;
+    VolumePartial<float> &partial = partials[index++];
+    partial.m_pixel_id = i;
+    partial.m_depth = image.m_depths[i];
+    const float alpha = pixel[3] * one_over_255;
+    partial.m_pixel[0] = pixel[0] * one_over_255 * alpha;
+    partial.m_pixel[1] = pixel[1] * one_over_255 * alpha;
+    partial.m_pixel[2] = pixel[2] * one_over_255 * alpha;
+    partial.m_alpha = alpha;
+  }
+}
+
+// the blended fragments keep the depth of the closest one and
+// empty pixels get the depth Image uses for the background
+void partials_to_image(const std::vector<VolumePartial<float>> &partials, Image &image)
+{
+  std::fill(image.m_pixels.begin(), image.m_pixels.end(), 0);
+  std::fill(image.m_depths.begin(), image.m_depths.end(), 2.f);
+
+  const int size = static_cast<int>(partials.size());
+#ifdef VTKH_USE_OPENMP
+  #pragma omp parallel for
+#endif
+  for(int i = 0; i < size; ++i)
+  {
+    const VolumePartial<float> &partial = partials[i];
+    unsigned char *pixel = &image.m_pixels[partial.m_pixel_id * 4];
+    for(int c = 0; c < 3; ++c)
+    {
+      pixel[c] = static_cast<unsigned char>(std::min(partial.m_pixel[c], 1.f) * 255.f + 0.5f);
+    }
+    pixel[3] = static_cast<unsigned char>(std::min(partial.m_alpha, 1.f) * 255.f + 0.5f);
+    image.m_depths[partial.m_pixel_id] = partial.m_depth;
+  }
+}
+
+} // namespace detail
+
 Compositor::Compositor()
   : m_composite_mode(Z_BUFFER_SURFACE)
 {
@@ -178,6 +242,10 @@ Compositor::Composite()
   {
     CompositeVisOrder();
   }
+  else if(m_composite_mode == NEAREST_SURFACE_BLEND)
+  {
+    CompositeNearestSurfaceBlend();
+  }
   // Make this a param to avoid the copy?
   return m_images[0];
 }
@@ -215,7 +283,41 @@ Compositor::CompositeZBufferSurface()
 void
 Compositor::CompositeZBufferBlend()
 {
-  assert("this is not implemented yet" == "error");
+  // this needs every translucent surface of a pixel, but the
+  // renderers only keep the nearest one
+  throw Error("Compositor: Z_BUFFER_BLEND is not implemented, "
+              "use NEAREST_SURFACE_BLEND");
+}
+
+void
+Compositor::CompositeNearestSurfaceBlend()
+{
+  // Every pixel of every image is a fragment, and blending the
+  // fragments of a pixel front to back is what the partial
+  // compositor already does for volumes. All fragments of a pixel
+  // end up on one rank, so this takes a single exchange. An image
+  // only holds the nearest surface of its pixels, already blended
+  // with nothing behind it, so only surfaces of different images
+  // are blended with each other.
+  const int num_images = static_cast<int>(m_images.size());
+  std::vector<std::vector<VolumePartial<float>>> partials(num_images);
+  for(int i = 0; i < num_images; ++i)
+  {
+    detail::image_to_partials(m_images[i], partials[i]);
+  }
+
+  PartialCompositor<VolumePartial<float>> compositor;
+  // the colors are bytes to begin with
+  compositor.set_wire_format(WIRE_BYTE);
+#ifdef VTKH_PARALLEL
+  compositor.set_comm_handle(GetMPICommHandle());
+#endif
+  std::vector<VolumePartial<float>> result;
+  compositor.composite(partials, result);
+
+  m_images.resize(1);
+  m_images[0].m_has_transparency = true;
+  detail::partials_to_image(result, m_images[0]);
 }
 
 void
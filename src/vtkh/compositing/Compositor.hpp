@@ -12,9 +12,10 @@ class VTKH_API Compositor
 {
 public:
     enum CompositeMode {
-                         Z_BUFFER_SURFACE, // zbuffer composite no transparency
-                         Z_BUFFER_BLEND,   // zbuffer composite with transparency
-                         VIS_ORDER_BLEND   // blend images in a specific order
+                         Z_BUFFER_SURFACE,     // zbuffer composite no transparency
+                         Z_BUFFER_BLEND,       // zbuffer composite with transparency (not implemented)
+                         VIS_ORDER_BLEND,      // blend images in a specific order
+                         NEAREST_SURFACE_BLEND // blend the nearest surface of every image in depth order
                        };
     Compositor();
 
@@ -70,6 +71,7 @@ public:
 protected:
     virtual void CompositeZBufferSurface();
     virtual void CompositeZBufferBlend();
+    virtual void CompositeNearestSurfaceBlend();
     virtual void CompositeVisOrder();
 
     std::stringstream   m_log_stream;
@@ -225,6 +225,7 @@ void BlendPartials<EmissionPartial, double>(const int &total_segments,
 //--------------------------------------------------------------------------------------------
 template<typename PartialType>
 PartialCompositor<PartialType>::PartialCompositor()
+  : m_wire_format(WIRE_EXACT)
 {
 
 }
@@ -241,7 +242,7 @@ PartialCompositor<PartialType>::~PartialCompositor()
 
 template<typename PartialType>
 void
-PartialCompositor<PartialType>::merge(const std::vector<std::vector<PartialType>> &in_partials,
+PartialCompositor<PartialType>::merge(std::vector<std::vector<PartialType>> &in_partials,
                                std::vector<PartialType> &partials,
                                int &global_min_pixel,
                                int &global_max_pixel)
@@ -259,18 +260,27 @@ PartialCompositor<PartialType>::merge(const std::vector<std::vector<PartialType>
     total_partial_comps += in_partials[i].size();
   }
 
-  partials.resize(total_partial_comps);
+  if(num_partial_images == 1)
+  {
+    // the partials are already contiguous, so take them
+    // instead of copying them
+    partials.swap(in_partials[0]);
+  }
+  else
+  {
+    partials.resize(total_partial_comps);
 
 #ifdef VTKH_USE_OPENMP
-  #pragma omp parallel for
+    #pragma omp parallel for
 #endif
-  for(int i = 0; i < num_partial_images; ++i)
-  {
-    //
-    //  Extract the partial composites into a contiguous array
-    //
-    std::copy(in_partials[i].begin(), in_partials[i].end(), partials.begin() + offsets[i]);
-  }// for each partial image
+    for(int i = 0; i < num_partial_images; ++i)
+    {
+      //
+      //  Extract the partial composites into a contiguous array
+      //
+      std::copy(in_partials[i].begin(), in_partials[i].end(), partials.begin() + offsets[i]);
+    }// for each partial image
+  }
 
   //
   // Calculate the range of pixel ids
@@ -332,7 +342,7 @@ PartialCompositor<PartialType>::composite_partials(std::vector<PartialType> &par
                                             std::vector<PartialType> &output_partials)
 {
   const int total_partial_comps = partials.size();
-  if(total_partial_comps == 0)
+  if(total_partial_comps < 2)
   {
     output_partials = partials;
     return;
@@ -525,7 +535,8 @@ PartialCompositor<PartialType>::composite(std::vector<std::vector<PartialType>>
   redistribute(partials,
                comm_handle,
                global_min_pixel,
-               global_max_pixel);
+               global_max_pixel,
+               m_wire_format);
   MPI_Barrier(comm_handle);
 #endif
 
@@ -542,11 +553,48 @@ PartialCompositor<PartialType>::composite(std::vector<std::vector<PartialType>>
   //
   // Collect all of the distibuted pixels
   //
-  collect(output_partials, comm_handle);
+  collect(output_partials, comm_handle, m_wire_format);
   MPI_Barrier(comm_handle);
 #endif
 }
 
+template<typename PartialType>
+void
+PartialCompositor<PartialType>::composite_local(std::vector<std::vector<PartialType>> &partial_images,
+                                                std::vector<PartialType> &output_partials)
+{
+  const int num_partial_images = static_cast<int>(partial_images.size());
+  if(num_partial_images == 1)
+  {
+    output_partials.swap(partial_images[0]);
+    return;
+  }
+
+  std::vector<int> offsets;
+  offsets.resize(num_partial_images);
+  int total_partial_comps = 0;
+  for(int i = 0; i < num_partial_images; ++i)
+  {
+    offsets[i] = total_partial_comps;
+    total_partial_comps += partial_images[i].size();
+  }
+
+  std::vector<PartialType> partials;
+  partials.resize(total_partial_comps);
+
+#ifdef VTKH_USE_OPENMP
+  #pragma omp parallel for
+#endif
+  for(int i = 0; i < num_partial_images; ++i)
+  {
+    std::copy(partial_images[i].begin(),
+              partial_images[i].end(),
+              partials.begin() + offsets[i]);
+  }
+
+  composite_partials(partials, output_partials);
+}
+
 template<typename PartialType>
 void
 PartialCompositor<PartialType>::set_background(std::vector<vtkm::Float32> &background_values)
@@ -578,6 +626,13 @@ PartialCompositor<PartialType>::set_comm_handle(int mpi_comm_id)
   m_mpi_comm_id  = mpi_comm_id;
 }
 
+template<typename PartialType>
+void
+PartialCompositor<PartialType>::set_wire_format(const PartialWireFormat format)
+{
+  m_wire_format = format;
+}
+
 //Explicit function instantiations
 template class VTKH_API PartialCompositor<VolumePartial<vtkm::Float32>>;
 template class VTKH_API PartialCompositor<VolumePartial<vtkm::Float64>>;
@@ -49,6 +49,7 @@
 #include "AbsorptionPartial.hpp"
 #include "EmissionPartial.hpp"
 #include "VolumePartial.hpp"
+#include "PartialPacking.hpp"
 
 
 namespace vtkh {
@@ -59,14 +60,23 @@ class VTKH_API PartialCompositor
 public:
   PartialCompositor();
   ~PartialCompositor();
+  // the partial images may be moved into the output, so
+  // they should not be used afterwards
   void
   composite(std::vector<std::vector<PartialType>> &partial_images,
             std::vector<PartialType> &output_partials);
+  // composites the partial images of this rank only
+  void
+  composite_local(std::vector<std::vector<PartialType>> &partial_images,
+                  std::vector<PartialType> &output_partials);
   void set_background(std::vector<vtkm::Float32> &background_values);
   void set_background(std::vector<vtkm::Float64> &background_values);
   void set_comm_handle(int mpi_comm_id);
+  // all ranks need to use the same format
+  void set_wire_format(const PartialWireFormat format);
 protected:
-  void merge(const std::vector<std::vector<PartialType>> &in_partials,
+  // a single partial image is moved into the output
+  void merge(std::vector<std::vector<PartialType>> &in_partials,
              std::vector<PartialType> &partials,
              int &global_min_pixel,
              int &global_max_pixel);
@@ -76,6 +86,7 @@ protected:
 
   std::vector<typename PartialType::ValueType> m_background_values;
   int m_mpi_comm_id;
+  PartialWireFormat m_wire_format;
 };
 
 }; // namespace rover
@@ -0,0 +1,202 @@
+#ifndef VTKH_PARTIAL_PACKING_HPP
+#define VTKH_PARTIAL_PACKING_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "VolumePartial.hpp"
+#include <vtkh/utils/HalfFloat.hpp>
+
+namespace vtkh {
+
+//
+// How partial composites are sent between ranks.
+//  WIRE_EXACT : the partials as they are (24 bytes for a volume partial)
+//  WIRE_HALF  : delta coded pixel ids, half float color and alpha,
+//               and the full depth (~14 bytes)
+//  WIRE_BYTE  : same as WIRE_HALF but with 8-bit color and alpha (~10 bytes)
+// Depths are never quantized: partials of a pixel come from several
+// ranks and are ordered by depth after they arrive, so every message
+// has to keep the same depths.
+// Only VolumePartial<float> has a packed format, all other partial
+// types are always sent exactly.
+//
+enum PartialWireFormat
+{
+  WIRE_EXACT,
+  WIRE_HALF,
+  WIRE_BYTE
+};
+
+namespace detail
+{
+
+template<typename T>
+inline void pack_value(std::vector<unsigned char> &buffer, const T &value)
+{
+  const size_t offset = buffer.size();
+  buffer.resize(offset + sizeof(T));
+  std::memcpy(&buffer[offset], &value, sizeof(T));
+}
+
+template<typename T>
+inline T unpack_value(const unsigned char *&ptr)
+{
+  T value;
+  std::memcpy(&value, ptr, sizeof(T));
+  ptr += sizeof(T);
+  return value;
+}
+
+inline void pack_varint(std::vector<unsigned char> &buffer, std::uint32_t value)
+{
+  while(value >= 0x80u)
+  {
+    buffer.push_back(static_cast<unsigned char>(value | 0x80u));
+    value >>= 7;
+  }
+  buffer.push_back(static_cast<unsigned char>(value));
+}
+
+inline std::uint32_t unpack_varint(const unsigned char *&ptr)
+{
+  std::uint32_t value = 0;
+  int shift = 0;
+  while(*ptr & 0x80u)
+  {
+    value |= static_cast<std::uint32_t>(*ptr & 0x7fu) << shift;
+    shift += 7;
+    ++ptr;
+  }
+  value |= static_cast<std::uint32_t>(*ptr) << shift;
+  ++ptr;
+  return value;
+}
+
+inline unsigned char float_to_byte(const float value)
+{
+  const float clamped = std::min(1.f, std::max(0.f, value));
+  return static_cast<unsigned char>(clamped * 255.f + 0.5f);
+}
+
+} // namespace detail
+
+//
+// Packs the partials into the buffer. The packed formats sort the
+// caller's partials in place by pixel and depth so the pixel ids
+// can be delta coded, so the partials come back reordered.
+// WIRE_EXACT leaves them as they are.
+//
+inline void pack_partials(std::vector<VolumePartial<float>> &partials,
+                          const PartialWireFormat format,
+                          std::vector<unsigned char> &buffer)
+{
+  const std::uint32_t size = static_cast<std::uint32_t>(partials.size());
+  buffer.clear();
+  detail::pack_value(buffer, static_cast<unsigned char>(format));
+  detail::pack_value(buffer, size);
+
+  if(format == WIRE_EXACT || size == 0)
+  {
+    const size_t offset = buffer.size();
+    buffer.resize(offset + size * sizeof(VolumePartial<float>));
+    if(size > 0)
+    {
+      std::memcpy(&buffer[offset], &partials[0], size * sizeof(VolumePartial<float>));
+    }
+    return;
+  }
+
+  std::sort(partials.begin(), partials.end());
+
+  const size_t bytes_per_partial = format == WIRE_HALF ? 14 : 10;
+  buffer.reserve(buffer.size() + size * bytes_per_partial);
+
+  int prev_pixel = 0;
+  for(std::uint32_t i = 0; i < size; ++i)
+  {
+    const VolumePartial<float> &partial = partials[i];
+    detail::pack_varint(buffer, static_cast<std::uint32_t>(partial.m_pixel_id - prev_pixel));
+
+    if(format == WIRE_HALF)
+    {
+      detail::pack_value(buffer, FloatToHalf(partial.m_pixel[0]));
+      detail::pack_value(buffer, FloatToHalf(partial.m_pixel[1]));
+      detail::pack_value(buffer, FloatToHalf(partial.m_pixel[2]));
+      detail::pack_value(buffer, FloatToHalf(partial.m_alpha));
+    }
+    else
+    {
+      buffer.push_back(detail::float_to_byte(partial.m_pixel[0]));
+      buffer.push_back(detail::float_to_byte(partial.m_pixel[1]));
+      buffer.push_back(detail::float_to_byte(partial.m_pixel[2]));
+      buffer.push_back(detail::float_to_byte(partial.m_alpha));
+    }
+
+    detail::pack_value(buffer, partial.m_depth);
+
+    prev_pixel = partial.m_pixel_id;
+  }
+}
+
+//
+// Unpacks the partials in the buffer and appends them
+//
+inline void unpack_partials(const std::vector<unsigned char> &buffer,
+                            std::vector<VolumePartial<float>> &partials)
+{
+  if(buffer.size() == 0)
+  {
+    return;
+  }
+
+  const unsigned char *ptr = &buffer[0];
+  const PartialWireFormat format =
+    static_cast<PartialWireFormat>(detail::unpack_value<unsigned char>(ptr));
+  const std::uint32_t size = detail::unpack_value<std::uint32_t>(ptr);
+
+  const size_t offset = partials.size();
+  partials.resize(offset + size);
+
+  if(format == WIRE_EXACT || size == 0)
+  {
+    if(size > 0)
+    {
+      std::memcpy(&partials[offset], ptr, size * sizeof(VolumePartial<float>));
+    }
+    return;
+  }
+
+  int pixel = 0;
+  for(std::uint32_t i = 0; i < size; ++i)
+  {
+    VolumePartial<float> &partial = partials[offset + i];
+    pixel += static_cast<int>(detail::unpack_varint(ptr));
+    partial.m_pixel_id = pixel;
+
+    if(format == WIRE_HALF)
+    {
+      partial.m_pixel[0] = HalfToFloat(detail::unpack_value<std::uint16_t>(ptr));
+      partial.m_pixel[1] = HalfToFloat(detail::unpack_value<std::uint16_t>(ptr));
+      partial.m_pixel[2] = HalfToFloat(detail::unpack_value<std::uint16_t>(ptr));
+      partial.m_alpha = HalfToFloat(detail::unpack_value<std::uint16_t>(ptr));
+    }
+    else
+    {
+      const float inv = 1.f / 255.f;
+      partial.m_pixel[0] = ptr[0] * inv;
+      partial.m_pixel[1] = ptr[1] * inv;
+      partial.m_pixel[2] = ptr[2] * inv;
+      partial.m_alpha = ptr[3] * inv;
+      ptr += 4;
+    }
+
+    partial.m_depth = detail::unpack_value<float>(ptr);
+  }
+}
+
+} // namespace vtkh
+#endif
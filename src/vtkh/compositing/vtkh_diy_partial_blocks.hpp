@@ -43,10 +43,12 @@
 #define rover_blocks_h
 
 #include <diy/master.hpp>
+#include <diy/reduce.hpp>
 
 #include "AbsorptionPartial.hpp"
 #include "EmissionPartial.hpp"
 #include "VolumePartial.hpp"
+#include "PartialPacking.hpp"
 
 namespace vtkh {
 
@@ -121,6 +123,66 @@ struct AddBlock
   }
 };
 
+//--------------------------------------Partial Transport--------------------------------------
+//
+// Partials are sent as they are unless the partial type has a
+// packed wire format. Every rank has to use the same format.
+//
+template<typename PartialType>
+void enqueue_partials(const vtkhdiy::ReduceProxy &proxy,
+                      const vtkhdiy::BlockID &dest,
+                      std::vector<PartialType> &partials,
+                      const PartialWireFormat format)
+{
+  (void) format;
+  proxy.enqueue(dest, partials);
+}
+
+inline void enqueue_partials(const vtkhdiy::ReduceProxy &proxy,
+                             const vtkhdiy::BlockID &dest,
+                             std::vector<VolumePartial<float>> &partials,
+                             const PartialWireFormat format)
+{
+  if(format == WIRE_EXACT)
+  {
+    proxy.enqueue(dest, partials);
+    return;
+  }
+  std::vector<unsigned char> buffer;
+  pack_partials(partials, format, buffer);
+  proxy.enqueue(dest, buffer);
+}
+
+// appends the incoming partials
+template<typename PartialType>
+void dequeue_partials(const vtkhdiy::ReduceProxy &proxy,
+                      const int gid,
+                      std::vector<PartialType> &partials,
+                      const PartialWireFormat format)
+{
+  (void) format;
+  std::vector<PartialType> incoming_partials;
+  proxy.dequeue(gid, incoming_partials);
+  partials.insert(partials.end(), incoming_partials.begin(), incoming_partials.end());
+}
+
+inline void dequeue_partials(const vtkhdiy::ReduceProxy &proxy,
+                             const int gid,
+                             std::vector<VolumePartial<float>> &partials,
+                             const PartialWireFormat format)
+{
+  if(format == WIRE_EXACT)
+  {
+    std::vector<VolumePartial<float>> incoming_partials;
+    proxy.dequeue(gid, incoming_partials);
+    partials.insert(partials.end(), incoming_partials.begin(), incoming_partials.end());
+    return;
+  }
+  std::vector<unsigned char> buffer;
+  proxy.dequeue(gid, buffer);
+  unpack_partials(buffer, partials);
+}
+
 } //namespace vtkh
 
 //-------------------------------Serialization Specializations--------------------------------
@@ -45,6 +45,7 @@
 #include "AbsorptionPartial.hpp"
 #include "EmissionPartial.hpp"
 #include "VolumePartial.hpp"
+#include "vtkh_diy_partial_blocks.hpp"
 #include <diy/assigner.hpp>
 #include <diy/decomposition.hpp>
 #include <diy/master.hpp>
@@ -58,9 +59,12 @@ template<typename BlockType>
 struct Collect
 {
   const vtkhdiy::RegularDecomposer<vtkhdiy::ContinuousBounds> &m_decomposer;
+  const PartialWireFormat m_format;
 
-  Collect(const vtkhdiy::RegularDecomposer<vtkhdiy::ContinuousBounds> &decomposer)
-    : m_decomposer(decomposer)
+  Collect(const vtkhdiy::RegularDecomposer<vtkhdiy::ContinuousBounds> &decomposer,
+          const PartialWireFormat format)
+    : m_decomposer(decomposer),
+      m_format(format)
   {}
 
   void operator()(void *v_block, const vtkhdiy::ReduceProxy &proxy) const
@@ -75,7 +79,7 @@ struct Collect
     {
       int dest_gid = collection_rank;
       vtkhdiy::BlockID dest = proxy.out_link().target(dest_gid);
-      proxy.enqueue(dest, block->m_partials);
+      enqueue_partials(proxy, dest, block->m_partials, m_format);
 
       block->m_partials.clear();
 
@@ -91,14 +95,7 @@ struct Collect
           continue;
         }
         //TODO: leave the paritals that start here, here
-        std::vector<typename BlockType::PartialType> incoming_partials;
-        proxy.dequeue(gid, incoming_partials);
-        const int incoming_size = incoming_partials.size();
-        // TODO: make this a std::copy
-        for(int j = 0; j < incoming_size; ++j)
-        {
-          block->m_partials.push_back(incoming_partials[j]);
-        }
+        dequeue_partials(proxy, gid, block->m_partials, m_format);
       } // for
     } // else
 
@@ -111,7 +108,8 @@ struct Collect
 //
 template<typename AddBlockType>
 void collect_detail(std::vector<typename AddBlockType::PartialType> &partials,
-                    MPI_Comm comm)
+                    MPI_Comm comm,
+                    const PartialWireFormat format)
 {
   typedef typename AddBlockType::Block Block;
 
@@ -135,55 +133,62 @@ void collect_detail(std::vector<typename AddBlockType::PartialType> &partials,
   vtkhdiy::RegularDecomposer<vtkhdiy::ContinuousBounds> decomposer(dims, global_bounds, num_blocks);
   decomposer.decompose(world.rank(), assigner, create);
 
-  vtkhdiy::all_to_all(master, assigner, Collect<Block>(decomposer), magic_k);
+  vtkhdiy::all_to_all(master, assigner, Collect<Block>(decomposer, format), magic_k);
 
 
 }
 
 template<typename T>
 void collect(std::vector<T> &partials,
-             MPI_Comm comm);
+             MPI_Comm comm,
+             const PartialWireFormat format = WIRE_EXACT);
 
 template<>
 void collect<VolumePartial<float>>(std::vector<VolumePartial<float>> &partials,
-                                  MPI_Comm comm)
+                                  MPI_Comm comm,
+                                  const PartialWireFormat format)
 {
-  collect_detail<AddBlock<VolumeBlock<float>>>(partials, comm);
+  collect_detail<AddBlock<VolumeBlock<float>>>(partials, comm, format);
 }
 
 template<>
 void collect<VolumePartial<double>>(std::vector<VolumePartial<double>> &partials,
-                                   MPI_Comm comm)
+                                   MPI_Comm comm,
+                                   const PartialWireFormat format)
 {
-  collect_detail<AddBlock<VolumeBlock<double>>>(partials, comm);
+  collect_detail<AddBlock<VolumeBlock<double>>>(partials, comm, format);
 }
 
 template<>
 void collect<AbsorptionPartial<double>>(std::vector<AbsorptionPartial<double>> &partials,
-                                        MPI_Comm comm)
+                                        MPI_Comm comm,
+                                        const PartialWireFormat format)
 {
-  collect_detail<AddBlock<AbsorptionBlock<double>>>(partials, comm);
+  collect_detail<AddBlock<AbsorptionBlock<double>>>(partials, comm, format);
 }
 
 template<>
 void collect<AbsorptionPartial<float>>(std::vector<AbsorptionPartial<float>> &partials,
-                                       MPI_Comm comm)
+                                       MPI_Comm comm,
+                                       const PartialWireFormat format)
 {
-  collect_detail<AddBlock<AbsorptionBlock<float>>>(partials, comm);
+  collect_detail<AddBlock<AbsorptionBlock<float>>>(partials, comm, format);
 }
 
 template<>
 void collect<EmissionPartial<double>>(std::vector<EmissionPartial<double>> &partials,
-                                      MPI_Comm comm)
+                                      MPI_Comm comm,
+                                      const PartialWireFormat format)
 {
-  collect_detail<AddBlock<EmissionBlock<double>>>(partials, comm);
+  collect_detail<AddBlock<EmissionBlock<double>>>(partials, comm, format);
 }
 
 template<>
 void collect<EmissionPartial<float>>(std::vector<EmissionPartial<float>> &partials,
-                                     MPI_Comm comm)
+                                     MPI_Comm comm,
+                                     const PartialWireFormat format)
 {
-  collect_detail<AddBlock<EmissionBlock<float>>>(partials, comm);
+  collect_detail<AddBlock<EmissionBlock<float>>>(partials, comm, format);
 }
 
 } // namespace rover
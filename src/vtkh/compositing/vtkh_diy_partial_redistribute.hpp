@@ -59,9 +59,12 @@ template<typename BlockType>
 struct Redistribute
 {
   const vtkhdiy::RegularDecomposer<vtkhdiy::DiscreteBounds> &m_decomposer;
+  const PartialWireFormat m_format;
 
-  Redistribute(const vtkhdiy::RegularDecomposer<vtkhdiy::DiscreteBounds> &decomposer)
-    : m_decomposer(decomposer)
+  Redistribute(const vtkhdiy::RegularDecomposer<vtkhdiy::DiscreteBounds> &decomposer,
+               const PartialWireFormat format)
+    : m_decomposer(decomposer),
+      m_format(format)
   {}
 
   void operator()(void *v_block, const vtkhdiy::ReduceProxy &proxy) const
@@ -92,7 +95,7 @@ struct Redistribute
       {
         int dest_gid = proxy.out_link().target(i).gid;
         vtkhdiy::BlockID dest = proxy.out_link().target(dest_gid);
-        proxy.enqueue(dest, outgoing[dest]);
+        enqueue_partials(proxy, dest, outgoing[dest], m_format);
         //outgoing[dest].clear();
       }
 
@@ -102,14 +105,7 @@ struct Redistribute
       for(int i = 0; i < proxy.in_link().size(); ++i)
       {
         int gid = proxy.in_link().target(i).gid;
-        std::vector<typename BlockType::PartialType> incoming_partials;
-        proxy.dequeue(gid, incoming_partials);
-        const int incoming_size = incoming_partials.size();
-        // TODO: make this a std::copy
-        for(int j = 0; j < incoming_size; ++j)
-        {
-          block->m_partials.push_back(incoming_partials[j]);
-        }
+        dequeue_partials(proxy, gid, block->m_partials, m_format);
       } // for
 
     } // else
@@ -122,7 +118,8 @@ template<typename AddBlockType>
 void redistribute_detail(std::vector<typename AddBlockType::PartialType> &partials,
                          MPI_Comm comm,
                          const int &domain_min_pixel,
-                         const int &domain_max_pixel)
+                         const int &domain_max_pixel,
+                         const PartialWireFormat format)
 {
   typedef typename AddBlockType::Block Block;
 
@@ -145,7 +142,7 @@ void redistribute_detail(std::vector<typename AddBlockType::PartialType> &partia
   const int dims = 1;
   vtkhdiy::RegularDecomposer<vtkhdiy::DiscreteBounds> decomposer(dims, global_bounds, num_blocks);
   decomposer.decompose(world.rank(), assigner, create);
-  vtkhdiy::all_to_all(master, assigner, Redistribute<Block>(decomposer), magic_k);
+  vtkhdiy::all_to_all(master, assigner, Redistribute<Block>(decomposer, format), magic_k);
 }
 
 //
@@ -155,30 +152,35 @@ template<typename T>
 void redistribute(std::vector<T> &partials,
                   MPI_Comm comm,
                   const int &domain_min_pixel,
-                  const int &domain_max_pixel);
+                  const int &domain_max_pixel,
+                  const PartialWireFormat format = WIRE_EXACT);
 // ----------------------------- VolumePartial Specialization------------------------------------------
 template<>
 void redistribute<VolumePartial<float>>(std::vector<VolumePartial<float>> &partials,
                                                                            MPI_Comm comm,
                                                                            const int &domain_min_pixel,
-                                                                           const int &domain_max_pixel)
+                                                                           const int &domain_max_pixel,
+                                                                           const PartialWireFormat format)
 {
   redistribute_detail<AddBlock<VolumeBlock<float>>>(partials,
                                                     comm,
                                                     domain_min_pixel,
-                                                    domain_max_pixel);
+                                                    domain_max_pixel,
+                                                    format);
 }
 
 template<>
 void redistribute<VolumePartial<double>>(std::vector<VolumePartial<double>> &partials,
                                                                              MPI_Comm comm,
                                                                              const int &domain_min_pixel,
-                                                                             const int &domain_max_pixel)
+                                                                             const int &domain_max_pixel,
+                                                                             const PartialWireFormat format)
 {
   redistribute_detail<AddBlock<VolumeBlock<double>>>(partials,
                                                      comm,
                                                      domain_min_pixel,
-                                                     domain_max_pixel);
+                                                     domain_max_pixel,
+                                                     format);
 }
 
 // ----------------------------- AbsorpPartial Specialization------------------------------------------
@@ -186,24 +188,28 @@ template<>
 void redistribute<AbsorptionPartial<double>>(std::vector<AbsorptionPartial<double>> &partials,
                                              MPI_Comm comm,
                                              const int &domain_min_pixel,
-                                             const int &domain_max_pixel)
+                                             const int &domain_max_pixel,
+                                             const PartialWireFormat format)
 {
   redistribute_detail<AddBlock<AbsorptionBlock<double>>>(partials,
                                                          comm,
                                                          domain_min_pixel,
-                                                         domain_max_pixel);
+                                                         domain_max_pixel,
+                                                         format);
 }
 
 template<>
 void redistribute<AbsorptionPartial<float>>(std::vector<AbsorptionPartial<float>> &partials,
                                             MPI_Comm comm,
                                             const int &domain_min_pixel,
-                                            const int &domain_max_pixel)
+                                            const int &domain_max_pixel,
+                                            const PartialWireFormat format)
 {
   redistribute_detail<AddBlock<AbsorptionBlock<float>>>(partials,
                                                         comm,
                                                         domain_min_pixel,
-                                                        domain_max_pixel);
+                                                        domain_max_pixel,
+                                                        format);
 }
 
 // ----------------------------- EmissPartial Specialization------------------------------------------
@@ -211,24 +217,28 @@ template<>
 void redistribute<EmissionPartial<double>>(std::vector<EmissionPartial<double>> &partials,
                                           MPI_Comm comm,
                                           const int &domain_min_pixel,
-                                          const int &domain_max_pixel)
+                                          const int &domain_max_pixel,
+                                          const PartialWireFormat format)
 {
   redistribute_detail<AddBlock<EmissionBlock<double>>>(partials,
                                                        comm,
                                                        domain_min_pixel,
-                                                       domain_max_pixel);
+                                                       domain_max_pixel,
+                                                       format);
 }
 
 template<>
 void redistribute<EmissionPartial<float>>(std::vector<EmissionPartial<float>> &partials,
                                             MPI_Comm comm,
                                             const int &domain_min_pixel,
-                                            const int &domain_max_pixel)
+                                            const int &domain_max_pixel,
+                                            const PartialWireFormat format)
 {
   redistribute_detail<AddBlock<EmissionBlock<float>>>(partials,
                                                       comm,
                                                       domain_min_pixel,
-                                                      domain_max_pixel);
+                                                      domain_max_pixel,
+                                                      format);
 }
 
 } //namespace rover
@@ -0,0 +1,340 @@
+#include "Fingerprint.hpp"
+#include <vtkh/utils/vtkm_dataset_info.hpp>
+
+#include <vtkm/TypeList.h>
+#include <vtkm/cont/CellSetExplicit.h>
+#include <vtkm/cont/CellSetSingleType.h>
+#include <vtkm/cont/Error.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <string.h>
+#include <vector>
+
+namespace vtkh
+{
+
+namespace detail
+{
+
+inline vtkm::UInt64 mix(vtkm::UInt64 hash, const vtkm::UInt64 word)
+{
+  hash ^= word + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+  hash *= 0xff51afd7ed558ccdull;
+  return hash ^ (hash >> 33);
+}
+
+inline vtkm::UInt64 hash_bytes(vtkm::UInt64 hash, const void *data, const size_t size)
+{
+  const unsigned char *bytes = static_cast<const unsigned char*>(data);
+  size_t i = 0;
+  for(; i + 8 <= size; i += 8)
+  {
+    vtkm::UInt64 word;
+    memcpy(&word, bytes + i, 8);
+    hash = mix(hash, word);
+  }
+  if(i < size)
+  {
+    vtkm::UInt64 word = 0;
+    memcpy(&word, bytes + i, size - i);
+    hash = mix(hash, word);
+  }
+  return hash;
+}
+
+//
+// Every block of values is hashed on its own so the blocks can be
+// hashed in parallel, then the block hashes are added in order
+//
+template<typename PortalType>
+void add_portal(Fingerprint &fingerprint, const PortalType &portal)
+{
+  typedef typename PortalType::ValueType ValueType;
+  const vtkm::Id size = portal.GetNumberOfValues();
+  const vtkm::Id block_size = 1 << 16;
+  const vtkm::Id num_blocks = (size + block_size - 1) / block_size;
+  std::vector<vtkm::UInt64> blocks(num_blocks);
+
+#ifdef VTKH_USE_OPENMP
+  #pragma omp parallel for
+#endif
+  for(vtkm::Id b = 0; b < num_blocks; ++b)
+  {
+    const vtkm::Id end = std::min(size, (b + 1) * block_size);
+    vtkm::UInt64 hash = static_cast<vtkm::UInt64>(b);
+    for(vtkm::Id i = b * block_size; i < end; ++i)
+    {
+      const ValueType value = portal.Get(i);
+      hash = hash_bytes(hash, &value, sizeof(ValueType));
+    }
+    blocks[b] = hash;
+  }
+
+  fingerprint.AddValue(size);
+  if(num_blocks > 0)
+  {
+    fingerprint.Add(&blocks[0], blocks.size() * sizeof(vtkm::UInt64));
+  }
+}
+
+//
+// An array of a data set, with how to hash its values and how to
+// tell if another array is the same object
+//
+struct ArrayEntry
+{
+  vtkm::cont::UnknownArrayHandle                             m_array;
+  std::function<void(Fingerprint&)>                          m_add;
+  std::function<bool(const vtkm::cont::UnknownArrayHandle&)> m_same;
+};
+
+template<typename T, typename S>
+ArrayEntry make_entry(const vtkm::cont::ArrayHandle<T,S> &array)
+{
+  typedef vtkm::cont::ArrayHandle<T,S> ArrayType;
+  ArrayEntry entry;
+  entry.m_array = array;
+  entry.m_add = [array](Fingerprint &fingerprint)
+  {
+    add_portal(fingerprint, array.ReadPortal());
+  };
+  entry.m_same = [array](const vtkm::cont::UnknownArrayHandle &other)
+  {
+    return other.IsType<ArrayType>() && other.AsArrayHandle<ArrayType>() == array;
+  };
+  return entry;
+}
+
+struct ArrayEntryFunctor
+{
+  std::vector<ArrayEntry> *m_entries;
+
+  template<typename T, typename S>
+  void operator()(const vtkm::cont::ArrayHandle<T,S> &array) const
+  {
+    m_entries->push_back(make_entry(array));
+  }
+};
+
+//
+// Splits what AddDataSet hashes into the large arrays and the
+// rest (sizes, dims, uniform coordinates, the field association),
+// which is added to the layout. Returns false if some part of the
+// data set has a type that cannot be hashed.
+//
+bool get_entries(const vtkm::cont::DataSet &data_set,
+                 const std::string &field_name,
+                 Fingerprint &layout,
+                 std::vector<ArrayEntry> &entries)
+{
+  const vtkm::cont::DynamicCellSet &cell_set = data_set.GetCellSet();
+  layout.AddValue(cell_set.GetNumberOfCells());
+  layout.AddValue(data_set.GetNumberOfPoints());
+
+  ArrayEntryFunctor functor;
+  functor.m_entries = &entries;
+
+  // coordinates
+  const vtkm::cont::CoordinateSystem &coords = data_set.GetCoordinateSystem();
+  if(VTKMDataSetInfo::IsUniform(coords))
+  {
+    auto portal = coords.GetData().Cast<VTKMDataSetInfo::UniformArrayHandle>().ReadPortal();
+    layout.AddValue(portal.GetOrigin());
+    layout.AddValue(portal.GetSpacing());
+    layout.AddValue(portal.GetRange3());
+  }
+  else if(VTKMDataSetInfo::IsRectilinear(coords))
+  {
+    auto cartesian = coords.GetData().Cast<VTKMDataSetInfo::CartesianArrayHandle>();
+    entries.push_back(make_entry(cartesian.GetFirstArray()));
+    entries.push_back(make_entry(cartesian.GetSecondArray()));
+    entries.push_back(make_entry(cartesian.GetThirdArray()));
+  }
+  else
+  {
+    try
+    {
+      coords.GetData().CastAndCall(functor);
+    }
+    catch(const vtkm::cont::Error &)
+    {
+      return false;
+    }
+  }
+
+  // cells
+  vtkm::TopologyElementTagCell cells;
+  vtkm::TopologyElementTagPoint points;
+  int dims[3] = {0, 0, 0};
+  if(VTKMDataSetInfo::GetPointDims(cell_set, dims))
+  {
+    layout.Add(dims, sizeof(dims));
+  }
+  else if(cell_set.IsSameType(vtkm::cont::CellSetSingleType<>()))
+  {
+    vtkm::cont::CellSetSingleType<> single = cell_set.Cast<vtkm::cont::CellSetSingleType<>>();
+    layout.AddValue(single.GetCellShape(0));
+    entries.push_back(make_entry(single.GetConnectivityArray(cells, points)));
+  }
+  else if(cell_set.IsSameType(vtkm::cont::CellSetExplicit<>()))
+  {
+    vtkm::cont::CellSetExplicit<> exp = cell_set.Cast<vtkm::cont::CellSetExplicit<>>();
+    entries.push_back(make_entry(exp.GetShapesArray(cells, points)));
+    entries.push_back(make_entry(exp.GetOffsetsArray(cells, points)));
+    entries.push_back(make_entry(exp.GetConnectivityArray(cells, points)));
+  }
+  else
+  {
+    return false;
+  }
+
+  // field
+  layout.Add(field_name);
+  if(!data_set.HasField(field_name))
+  {
+    return true;
+  }
+  const vtkm::cont::Field &field = data_set.GetField(field_name);
+  layout.AddValue(static_cast<int>(field.GetAssociation()));
+  try
+  {
+    field.GetData().ResetTypes(vtkm::TypeListField(),
+                               VTKM_DEFAULT_STORAGE_LIST{}).CastAndCall(functor);
+  }
+  catch(const vtkm::cont::Error &)
+  {
+    return false;
+  }
+  return true;
+}
+
+} // namespace detail
+
+Fingerprint::Fingerprint()
+  : m_value(0xcbf29ce484222325ull)
+{
+}
+
+void
+Fingerprint::Add(const void *data, const size_t size)
+{
+  m_value = detail::hash_bytes(m_value, data, size);
+  // the size keeps "ab" + "c" apart from "a" + "bc"
+  m_value = detail::mix(m_value, static_cast<vtkm::UInt64>(size));
+}
+
+void
+Fingerprint::Add(const std::string &value)
+{
+  Add(value.data(), value.size());
+}
+
+void
+Fingerprint::AddUnique()
+{
+  static std::atomic<vtkm::UInt64> counter(0);
+  AddValue(counter++);
+}
+
+void
+Fingerprint::AddDataSet(const vtkm::cont::DataSet &data_set, const std::string &field_name)
+{
+  Fingerprint layout;
+  std::vector<detail::ArrayEntry> entries;
+  if(!detail::get_entries(data_set, field_name, layout, entries))
+  {
+    AddUnique();
+    return;
+  }
+
+  AddValue(layout.GetValue());
+  for(size_t i = 0; i < entries.size(); ++i)
+  {
+    entries[i].m_add(*this);
+  }
+}
+
+void
+Fingerprint::AddColorTable(const vtkm::cont::ColorTable &color_table)
+{
+  AddValue(static_cast<int>(color_table.GetColorSpace()));
+  AddValue(color_table.GetClamping());
+  AddValue(color_table.GetNaNColor());
+  AddValue(color_table.GetBelowRangeColor());
+  AddValue(color_table.GetAboveRangeColor());
+
+  const int num_points = color_table.GetNumberOfPoints();
+  AddValue(num_points);
+  for(int i = 0; i < num_points; ++i)
+  {
+    vtkm::Vec<vtkm::Float64,4> point;
+    color_table.GetPoint(i, point);
+    AddValue(point);
+  }
+
+  const int num_alpha = color_table.GetNumberOfPointsAlpha();
+  AddValue(num_alpha);
+  for(int i = 0; i < num_alpha; ++i)
+  {
+    vtkm::Vec<vtkm::Float64,4> point;
+    color_table.GetPointAlpha(i, point);
+    AddValue(point);
+  }
+}
+
+vtkm::UInt64
+Fingerprint::GetValue() const
+{
+  return m_value;
+}
+
+DataSetIdentity::DataSetIdentity()
+  : m_valid(false),
+    m_layout(0)
+{
+}
+
+void
+DataSetIdentity::Set(const vtkm::cont::DataSet &data_set, const std::string &field_name)
+{
+  Fingerprint layout;
+  std::vector<detail::ArrayEntry> entries;
+  m_valid = detail::get_entries(data_set, field_name, layout, entries);
+  m_layout = layout.GetValue();
+  m_arrays.clear();
+  for(size_t i = 0; i < entries.size(); ++i)
+  {
+    m_arrays.push_back(entries[i].m_same);
+  }
+}
+
+bool
+DataSetIdentity::IsSame(const vtkm::cont::DataSet &data_set, const std::string &field_name) const
+{
+  if(!m_valid)
+  {
+    return false;
+  }
+
+  Fingerprint layout;
+  std::vector<detail::ArrayEntry> entries;
+  if(!detail::get_entries(data_set, field_name, layout, entries) ||
+     layout.GetValue() != m_layout ||
+     entries.size() != m_arrays.size())
+  {
+    return false;
+  }
+
+  for(size_t i = 0; i < entries.size(); ++i)
+  {
+    if(!m_arrays[i](entries[i].m_array))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace vtkh
@@ -0,0 +1,78 @@
+#ifndef VTK_H_FINGERPRINT_HPP
+#define VTK_H_FINGERPRINT_HPP
+
+#include <vtkh/vtkh_exports.h>
+
+#include <vtkm/Types.h>
+#include <vtkm/cont/ColorTable.h>
+#include <vtkm/cont/DataSet.h>
+#include <vtkm/cont/UnknownArrayHandle.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace vtkh
+{
+
+//
+// A 64 bit hash of everything that changes the pixels of a plot,
+// used to tell if a plot can reuse the image of an earlier cycle.
+// The data is hashed by value (coordinates, cells and the field),
+// so it does not matter if the arrays are new objects every cycle,
+// see DataSetIdentity to skip hashing arrays that were hashed before.
+// Large arrays are hashed in parallel blocks. Data that cannot be
+// hashed (an unknown cell set or field type) makes the fingerprint
+// unique, so it counts as changed. This is not a cryptographic hash.
+//
+class VTKH_API Fingerprint
+{
+public:
+  Fingerprint();
+
+  void Add(const void *data, const size_t size);
+  void Add(const std::string &value);
+  template<typename T>
+  void AddValue(const T &value)
+  {
+    Add(&value, sizeof(T));
+  }
+
+  // a value no other fingerprint has
+  void AddUnique();
+  // the coordinates, the cells and the field of the data set
+  void AddDataSet(const vtkm::cont::DataSet &data_set, const std::string &field_name);
+  // the color space and the control points
+  void AddColorTable(const vtkm::cont::ColorTable &color_table);
+
+  vtkm::UInt64 GetValue() const;
+protected:
+  vtkm::UInt64 m_value;
+};
+
+//
+// The arrays a data set was hashed from. A later data set that uses
+// the very same arrays (the same objects, not equal values) has the
+// same fingerprint, so it does not have to be hashed again. The
+// arrays are kept alive, so their memory cannot be reused by new
+// arrays in between. Values written in place into a recorded array
+// are not seen.
+//
+class VTKH_API DataSetIdentity
+{
+public:
+  DataSetIdentity();
+
+  // records the arrays of the data set, nothing is recorded if
+  // some of them cannot be compared
+  void Set(const vtkm::cont::DataSet &data_set, const std::string &field_name);
+  bool IsSame(const vtkm::cont::DataSet &data_set, const std::string &field_name) const;
+protected:
+  typedef std::function<bool(const vtkm::cont::UnknownArrayHandle&)> SameArray;
+  bool                   m_valid;
+  vtkm::UInt64           m_layout;
+  std::vector<SameArray> m_arrays;
+};
+
+} // namespace vtkh
+#endif
@@ -0,0 +1,345 @@
+#include "ImageDatabase.hpp"
+
+#include <vtkh/Error.hpp>
+#include <vtkh/utils/vtkm_array_utils.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string.h>
+#include <algorithm>
+
+namespace vtkh
+{
+
+namespace detail
+{
+
+const char image_database_magic[8] = {'v', 't', 'k', 'h', 'i', 'd', 'b', '1'};
+const size_t image_database_page = 4096;
+const size_t image_database_header = 16;
+
+struct ImageDatabaseEntry
+{
+  char m_name[96];
+  vtkm::Int32 m_width;
+  vtkm::Int32 m_height;
+  vtkm::Int32 m_depth;
+  vtkm::Int32 m_pad;
+  vtkm::UInt64 m_offset;
+  vtkm::UInt64 m_size;
+};
+
+static_assert(sizeof(ImageDatabaseEntry) == 128, "index entries must be 128 bytes");
+
+size_t page_align(const size_t offset)
+{
+  return (offset + image_database_page - 1) / image_database_page * image_database_page;
+}
+
+} // namespace detail
+
+ImageDatabase::ImageDatabase()
+  : m_file(-1),
+    m_data(nullptr),
+    m_size(0)
+{
+}
+
+ImageDatabase::~ImageDatabase()
+{
+  Close();
+}
+
+int
+ImageDatabase::AddImage(const std::string &name,
+                        const int width,
+                        const int height,
+                        const bool depth)
+{
+  if(IsOpen())
+  {
+    throw Error("ImageDatabase: images must be added before the database is created");
+  }
+
+  if(name.size() >= sizeof(detail::ImageDatabaseEntry::m_name))
+  {
+    throw Error("ImageDatabase: image name '" + name + "' is too long");
+  }
+
+  Entry entry;
+  entry.m_name = name;
+  entry.m_width = width;
+  entry.m_height = height;
+  entry.m_depth = depth;
+  entry.m_offset = 0;
+  entry.m_size = static_cast<size_t>(width) * height * (depth ? 8 : 4);
+  m_entries.push_back(entry);
+  return static_cast<int>(m_entries.size()) - 1;
+}
+
+void
+ImageDatabase::Create(const std::string &file_name)
+{
+  Close();
+
+  const size_t num_images = m_entries.size();
+  size_t offset = detail::image_database_header + num_images * sizeof(detail::ImageDatabaseEntry);
+  for(size_t i = 0; i < num_images; ++i)
+  {
+    offset = detail::page_align(offset);
+    m_entries[i].m_offset = offset;
+    offset += m_entries[i].m_size;
+  }
+
+  m_file_name = file_name;
+  m_size = std::max(offset, detail::image_database_header);
+  m_file = open(file_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if(m_file == -1)
+  {
+    throw Error("ImageDatabase: could not create '" + file_name + "'");
+  }
+
+  // reserve the blocks now so that writes into the mapping cannot fail
+  int error = posix_fallocate(m_file, 0, m_size);
+  if(error != 0 && ftruncate(m_file, m_size) != 0)
+  {
+    Close();
+    throw Error("ImageDatabase: could not allocate '" + file_name + "'");
+  }
+
+  Map(true);
+
+  memcpy(m_data, detail::image_database_magic, 8);
+  const vtkm::UInt64 count = num_images;
+  memcpy(m_data + 8, &count, sizeof(count));
+  detail::ImageDatabaseEntry *index =
+    reinterpret_cast<detail::ImageDatabaseEntry*>(m_data + detail::image_database_header);
+  for(size_t i = 0; i < num_images; ++i)
+  {
+    memset(&index[i], 0, sizeof(detail::ImageDatabaseEntry));
+    strcpy(index[i].m_name, m_entries[i].m_name.c_str());
+    index[i].m_width = m_entries[i].m_width;
+    index[i].m_height = m_entries[i].m_height;
+    index[i].m_depth = m_entries[i].m_depth ? 1 : 0;
+    index[i].m_offset = m_entries[i].m_offset;
+    index[i].m_size = m_entries[i].m_size;
+  }
+}
+
+void
+ImageDatabase::Open(const std::string &file_name)
+{
+  Close();
+  m_entries.clear();
+
+  m_file_name = file_name;
+  m_file = open(file_name.c_str(), O_RDWR);
+  if(m_file == -1)
+  {
+    throw Error("ImageDatabase: could not open '" + file_name + "'");
+  }
+
+  struct stat info;
+  if(fstat(m_file, &info) != 0 ||
+     static_cast<size_t>(info.st_size) < detail::image_database_header)
+  {
+    Close();
+    throw Error("ImageDatabase: '" + file_name + "' is not an image database");
+  }
+  m_size = info.st_size;
+
+  Map(false);
+
+  vtkm::UInt64 count;
+  memcpy(&count, m_data + 8, sizeof(count));
+  if(memcmp(m_data, detail::image_database_magic, 8) != 0 ||
+     detail::image_database_header + count * sizeof(detail::ImageDatabaseEntry) > m_size)
+  {
+    Close();
+    throw Error("ImageDatabase: '" + file_name + "' is not an image database");
+  }
+
+  const detail::ImageDatabaseEntry *index =
+    reinterpret_cast<const detail::ImageDatabaseEntry*>(m_data + detail::image_database_header);
+  for(size_t i = 0; i < count; ++i)
+  {
+    Entry entry;
+    entry.m_name = std::string(index[i].m_name);
+    entry.m_width = index[i].m_width;
+    entry.m_height = index[i].m_height;
+    entry.m_depth = index[i].m_depth != 0;
+    entry.m_offset = index[i].m_offset;
+    entry.m_size = index[i].m_size;
+    if(entry.m_offset + entry.m_size > m_size)
+    {
+      Close();
+      throw Error("ImageDatabase: '" + file_name + "' is truncated");
+    }
+    m_entries.push_back(entry);
+  }
+}
+
+void
+ImageDatabase::Map(const bool create)
+{
+  void *data = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_file, 0);
+  if(data == MAP_FAILED)
+  {
+    Close();
+    throw Error("ImageDatabase: could not map '" + m_file_name + "'");
+  }
+  m_data = static_cast<unsigned char*>(data);
+  if(create)
+  {
+    // images are written once front to back
+    madvise(m_data, m_size, MADV_SEQUENTIAL);
+  }
+}
+
+void
+ImageDatabase::Close()
+{
+  if(m_data != nullptr)
+  {
+    munmap(m_data, m_size);
+    m_data = nullptr;
+  }
+  if(m_file != -1)
+  {
+    close(m_file);
+    m_file = -1;
+  }
+  m_size = 0;
+}
+
+bool
+ImageDatabase::IsOpen() const
+{
+  return m_data != nullptr;
+}
+
+int
+ImageDatabase::GetNumberOfImages() const
+{
+  return static_cast<int>(m_entries.size());
+}
+
+int
+ImageDatabase::FindImage(const std::string &name) const
+{
+  const int num_images = GetNumberOfImages();
+  for(int i = 0; i < num_images; ++i)
+  {
+    if(m_entries[i].m_name == name)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void
+ImageDatabase::CheckIndex(const int index) const
+{
+  if(index < 0 || index >= GetNumberOfImages())
+  {
+    throw Error("ImageDatabase: image index out of range");
+  }
+}
+
+std::string
+ImageDatabase::GetName(const int index) const
+{
+  CheckIndex(index);
+  return m_entries[index].m_name;
+}
+
+int
+ImageDatabase::GetWidth(const int index) const
+{
+  CheckIndex(index);
+  return m_entries[index].m_width;
+}
+
+int
+ImageDatabase::GetHeight(const int index) const
+{
+  CheckIndex(index);
+  return m_entries[index].m_height;
+}
+
+bool
+ImageDatabase::HasDepth(const int index) const
+{
+  CheckIndex(index);
+  return m_entries[index].m_depth;
+}
+
+unsigned char *
+ImageDatabase::GetColor(const int index)
+{
+  CheckIndex(index);
+  if(!IsOpen())
+  {
+    throw Error("ImageDatabase: the database is not open");
+  }
+  return m_data + m_entries[index].m_offset;
+}
+
+float *
+ImageDatabase::GetDepth(const int index)
+{
+  unsigned char *color = GetColor(index);
+  const Entry &entry = m_entries[index];
+  if(!entry.m_depth)
+  {
+    return nullptr;
+  }
+  return reinterpret_cast<float*>(color + static_cast<size_t>(entry.m_width) * entry.m_height * 4);
+}
+
+void
+ImageDatabase::Write(const int index, vtkm::rendering::Canvas &canvas)
+{
+  unsigned char *color = GetColor(index);
+  const Entry &entry = m_entries[index];
+  if(canvas.GetWidth() != entry.m_width || canvas.GetHeight() != entry.m_height)
+  {
+    throw Error("ImageDatabase: canvas size does not match image '" + entry.m_name + "'");
+  }
+
+  const int size = entry.m_width * entry.m_height;
+  const float *colors = &GetVTKMPointer(canvas.GetColorBuffer())[0][0];
+#ifdef VTKH_USE_OPENMP
+  #pragma omp parallel for
+#endif
+  for(int i = 0; i < size * 4; ++i)
+  {
+    color[i] = static_cast<unsigned char>(colors[i] * 255.f);
+  }
+
+  if(entry.m_depth)
+  {
+    const float *depths = GetVTKMPointer(canvas.GetDepthBuffer());
+    memcpy(GetDepth(index), depths, size * sizeof(float));
+  }
+}
+
+void
+ImageDatabase::Write(const int index, const unsigned char *rgba, const float *depths)
+{
+  unsigned char *color = GetColor(index);
+  const Entry &entry = m_entries[index];
+  const size_t size = static_cast<size_t>(entry.m_width) * entry.m_height;
+  memcpy(color, rgba, size * 4);
+
+  if(entry.m_depth)
+  {
+    memcpy(GetDepth(index), depths, size * sizeof(float));
+  }
+}
+
+} // namespace vtkh
@@ -0,0 +1,84 @@
+#ifndef VTK_H_IMAGE_DATABASE_HPP
+#define VTK_H_IMAGE_DATABASE_HPP
+
+#include <vtkh/vtkh_exports.h>
+
+#include <vtkm/rendering/Canvas.h>
+
+#include <string>
+#include <vector>
+
+namespace vtkh
+{
+
+//
+// A single file that holds every image of a cycle. The layout of
+// all images is added up front, then Create preallocates the file,
+// writes the index table and maps it into memory so that images
+// are written in place at known offsets instead of creating one
+// file per image. Since the images do not overlap, any rank that
+// Opens the database can write the images it owns.
+//
+// File layout: an 8 byte magic ("vtkhidb1") and the number of
+// images as a 64 bit int, followed by one 128 byte index entry per
+// image (the name, width, height, depth flag, and the offset and
+// size of the data). Image data is page aligned and holds the rgba
+// bytes followed by the float depths, both bottom row first.
+//
+class VTKH_API ImageDatabase
+{
+public:
+  ImageDatabase();
+  ~ImageDatabase();
+
+  // returns the index of the image
+  int AddImage(const std::string &name,
+               const int width,
+               const int height,
+               const bool depth);
+
+  void Create(const std::string &file_name);
+  void Open(const std::string &file_name);
+  void Close();
+  bool IsOpen() const;
+
+  int GetNumberOfImages() const;
+  // returns -1 if there is no image with the name
+  int FindImage(const std::string &name) const;
+  std::string GetName(const int index) const;
+  int GetWidth(const int index) const;
+  int GetHeight(const int index) const;
+  bool HasDepth(const int index) const;
+
+  // pointers into the mapped file. GetDepth is NULL
+  // for images without depth
+  unsigned char *GetColor(const int index);
+  float *GetDepth(const int index);
+
+  // converts the canvas into the image
+  void Write(const int index, vtkm::rendering::Canvas &canvas);
+  // copies rgba bytes and, for images with depth, the depths
+  void Write(const int index, const unsigned char *rgba, const float *depths);
+protected:
+  struct Entry
+  {
+    std::string m_name;
+    int m_width;
+    int m_height;
+    bool m_depth;
+    size_t m_offset;
+    size_t m_size;
+  };
+
+  void CheckIndex(const int index) const;
+  void Map(const bool create);
+
+  std::vector<Entry> m_entries;
+  std::string m_file_name;
+  int m_file;
+  unsigned char *m_data;
+  size_t m_size;
+};
+
+} // namespace vtkh
+#endif
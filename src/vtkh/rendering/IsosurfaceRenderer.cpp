@@ -0,0 +1,357 @@
+#include "IsosurfaceRenderer.hpp"
+#include <vtkh/rendering/Fingerprint.hpp>
+
+#include <vtkh/Logger.hpp>
+#include <vtkh/rendering/MacrocellGrid.hpp>
+#include <vtkh/rendering/StructuredSampler.hpp>
+
+#include <vtkm/VectorAnalysis.h>
+#include <vtkm/rendering/CanvasRayTracer.h>
+
+#include <algorithm>
+#include <memory>
+
+// max number of visible intervals we march along a ray
+#define VTKH_ISO_MAX_SEGMENTS 8
+// bisection steps used to refine a crossing
+#define VTKH_ISO_REFINE_STEPS 6
+
+namespace vtkh
+{
+
+namespace detail
+{
+
+class IsoDomain
+{
+public:
+  vtkm::cont::DataSet m_data_set;
+  vtkm::Id m_num_cells;
+  StructuredSampler m_sampler;
+  MacrocellGrid m_macrocells;
+
+  IsoDomain(vtkm::cont::DataSet &data_set)
+    : m_data_set(data_set)
+  {
+    m_num_cells = data_set.GetCellSet().GetNumberOfCells();
+  }
+};
+
+//
+// Finds the first crossing of any of the iso values in
+// [t0, t1] given the field values at both ends. Returns
+// the index of the iso value or -1.
+//
+int find_crossing(const StructuredSampler &sampler,
+                  const vtkm::Vec3f_32 &origin,
+                  const vtkm::Vec3f_32 &dir,
+                  const float *iso_values,
+                  const int num_values,
+                  const float t0,
+                  const float v0,
+                  const float t1,
+                  const float v1,
+                  float &t_hit)
+{
+  int hit = -1;
+  t_hit = t1;
+  for(int i = 0; i < num_values; ++i)
+  {
+    const float f0 = v0 - iso_values[i];
+    const float f1 = v1 - iso_values[i];
+    if((f0 < 0.f) == (f1 < 0.f) && f1 != 0.f)
+    {
+      continue;
+    }
+
+    float a = t0;
+    float b = t1;
+    float fa = f0;
+    float fb = f1;
+    for(int s = 0; s < VTKH_ISO_REFINE_STEPS; ++s)
+    {
+      const float m = 0.5f * (a + b);
+      const float fm = sampler.sample(origin + dir * m) - iso_values[i];
+      if((fa < 0.f) == (fm < 0.f))
+      {
+        a = m;
+        fa = fm;
+      }
+      else
+      {
+        b = m;
+        fb = fm;
+      }
+    }
+
+    const float denom = fa - fb;
+    const float t = denom != 0.f ? a + (b - a) * (fa / denom) : a;
+    if(t < t_hit || hit == -1)
+    {
+      t_hit = t;
+      hit = i;
+    }
+  }
+  return hit;
+}
+
+} // namespace detail
+
+IsosurfaceRenderer::IsosurfaceRenderer()
+  : m_sample_fraction(0.5f)
+{
+}
+
+IsosurfaceRenderer::~IsosurfaceRenderer()
+{
+  ClearDomains();
+}
+
+Renderer::vtkmCanvasPtr
+IsosurfaceRenderer::GetNewCanvas(int width, int height)
+{
+  return std::make_shared<vtkm::rendering::CanvasRayTracer>(width, height);
+}
+
+std::string
+IsosurfaceRenderer::GetName() const
+{
+  return "vtkh::IsosurfaceRenderer";
+}
+
+void
+IsosurfaceRenderer::AddToFingerprint(Fingerprint &fingerprint) const
+{
+  fingerprint.AddValue(m_sample_fraction);
+  fingerprint.AddValue(m_iso_values.size());
+  for(const double value : m_iso_values)
+  {
+    fingerprint.AddValue(value);
+  }
+}
+
+void
+IsosurfaceRenderer::SetIsoValue(const double &iso_value)
+{
+  m_iso_values.clear();
+  m_iso_values.push_back(iso_value);
+}
+
+void
+IsosurfaceRenderer::SetIsoValues(const double *iso_values, const int &num_values)
+{
+  if(num_values < 1)
+  {
+    throw Error("SetIsoValues: num_values must be greater than 0");
+  }
+  m_iso_values.assign(iso_values, iso_values + num_values);
+}
+
+void
+IsosurfaceRenderer::SetSampleFraction(const float fraction)
+{
+  if(fraction <= 0.f)
+  {
+    throw Error("IsosurfaceRenderer: sample fraction must be greater than 0");
+  }
+  m_sample_fraction = fraction;
+}
+
+void
+IsosurfaceRenderer::SetInput(DataSet *input)
+{
+  Filter::SetInput(input);
+  ClearDomains();
+
+  const int num_domains = static_cast<int>(m_input->GetNumberOfDomains());
+  for(int dom = 0; dom < num_domains; ++dom)
+  {
+    vtkm::cont::DataSet data_set;
+    vtkm::Id domain_id;
+    m_input->GetDomain(dom, data_set, domain_id);
+
+    if(data_set.GetCellSet().GetNumberOfCells() == 0)
+    {
+      continue;
+    }
+
+    if(!detail::StructuredSampler::supported(data_set))
+    {
+      throw Error("IsosurfaceRenderer: only 3D uniform and rectilinear data sets are "
+                  "supported. Use MarchingCubes for other data sets");
+    }
+
+    m_domains.push_back(new detail::IsoDomain(data_set));
+  }
+}
+
+void
+IsosurfaceRenderer::ClearDomains()
+{
+  const int num_domains = m_domains.size();
+  for(int i = 0; i < num_domains; ++i)
+  {
+    delete m_domains[i];
+  }
+  m_domains.clear();
+}
+
+void
+IsosurfaceRenderer::DoExecute()
+{
+  if(m_iso_values.size() == 0)
+  {
+    throw Error("IsosurfaceRenderer: no iso values were set");
+  }
+
+  const int num_values = static_cast<int>(m_iso_values.size());
+  std::vector<float> iso_values(m_iso_values.begin(), m_iso_values.end());
+
+  // the color of each surface is the color of its iso value
+  const int num_samples = 1024;
+  std::vector<vtkm::Vec4f_32> samples;
+  detail::sample_color_table(m_color_table, num_samples, samples);
+  std::vector<vtkm::Vec3f_32> iso_colors(num_values);
+  const float inv_range = m_range.Length() > 0. ? 1.f / static_cast<float>(m_range.Length()) : 0.f;
+  for(int i = 0; i < num_values; ++i)
+  {
+    float normalized = (iso_values[i] - static_cast<float>(m_range.Min)) * inv_range;
+    normalized = std::min(1.f, std::max(0.f, normalized));
+    const vtkm::Vec4f_32 &color = samples[static_cast<int>(normalized * (num_samples - 1))];
+    iso_colors[i] = vtkm::Vec3f_32(color[0], color[1], color[2]);
+  }
+
+  long long int culled_domains = 0;
+  long long int culled_cells = 0;
+  long long int empty_domains = 0;
+
+  const int total_renders = static_cast<int>(m_renders.size());
+  const int num_domains = static_cast<int>(m_domains.size());
+  for(int dom = 0; dom < num_domains; ++dom)
+  {
+    detail::IsoDomain &domain = *m_domains[dom];
+    if(!domain.m_data_set.HasField(m_field_name))
+    {
+      continue;
+    }
+
+    domain.m_sampler.update(domain.m_data_set, m_field_name);
+    if(!domain.m_sampler.point_field())
+    {
+      throw Error("IsosurfaceRenderer: field '" + m_field_name + "' must be a point field");
+    }
+
+    // only the macrocells that contain an iso value are marched
+    domain.m_macrocells.update(domain.m_data_set, m_field_name);
+    if(domain.m_macrocells.classify(iso_values) == 0)
+    {
+      empty_domains++;
+      continue;
+    }
+    const detail::StructuredSampler &sampler = domain.m_sampler;
+    const detail::MacrocellGrid &macrocells = domain.m_macrocells;
+    const vtkm::Bounds bounds = macrocells.visible_bounds();
+    const float step = sampler.min_spacing() * m_sample_fraction;
+
+    for(int i = 0; i < total_renders; ++i)
+    {
+      Render::vtkmCanvas &canvas = m_renders[i].GetCanvas();
+      const vtkmCamera &camera = m_renders[i].GetCamera();
+      const int width = canvas.GetWidth();
+      const int height = canvas.GetHeight();
+
+      if(CullDomain(camera, bounds, width, height))
+      {
+        culled_domains++;
+        culled_cells += domain.m_num_cells;
+        continue;
+      }
+
+      detail::CanvasRays rays(camera, canvas, bounds);
+      const int num_rays = rays.size();
+      if(num_rays == 0)
+      {
+        continue;
+      }
+      const bool shading = m_renders[i].GetShadingOn();
+
+      // every ray belongs to a different pixel
+#ifdef VTKH_USE_OPENMP
+      #pragma omp parallel for
+#endif
+      for(int r = 0; r < num_rays; ++r)
+      {
+        const vtkm::Vec3f_32 ray_origin = rays.origin(r);
+        const vtkm::Vec3f_32 ray_dir = rays.dir(r);
+
+        float starts[VTKH_ISO_MAX_SEGMENTS];
+        float ends[VTKH_ISO_MAX_SEGMENTS];
+        const int count = macrocells.segments(ray_origin,
+                                              ray_dir,
+                                              rays.min_distance(r),
+                                              rays.max_distance(r),
+                                              step,
+                                              VTKH_ISO_MAX_SEGMENTS,
+                                              starts,
+                                              ends);
+        int hit = -1;
+        float t_hit = 0.f;
+        for(int s = 0; s < count && hit == -1; ++s)
+        {
+          float t0 = starts[s];
+          float v0 = sampler.sample(ray_origin + ray_dir * t0);
+          while(t0 < ends[s] && hit == -1)
+          {
+            const float t1 = std::min(t0 + step, ends[s]);
+            const float v1 = sampler.sample(ray_origin + ray_dir * t1);
+            hit = detail::find_crossing(sampler,
+                                        ray_origin,
+                                        ray_dir,
+                                        &iso_values[0],
+                                        num_values,
+                                        t0,
+                                        v0,
+                                        t1,
+                                        v1,
+                                        t_hit);
+            t0 = t1;
+            v0 = v1;
+          }
+        }
+
+        if(hit == -1)
+        {
+          continue;
+        }
+
+        const vtkm::Vec3f_32 pos = ray_origin + ray_dir * t_hit;
+        float depth;
+        if(!rays.visible(r, pos, depth))
+        {
+          continue;
+        }
+
+        vtkm::Vec3f_32 color = iso_colors[hit];
+        if(shading)
+        {
+          vtkm::Vec3f_32 normal = sampler.gradient(pos);
+          const float length = vtkm::Magnitude(normal);
+          if(length > 0.f)
+          {
+            // head light
+            const float diffuse = vtkm::Abs(vtkm::Dot(normal, ray_dir)) / length;
+            color = color * (0.3f + 0.7f * diffuse);
+          }
+        }
+
+        rays.write(r, vtkm::Vec4f_32(color[0], color[1], color[2], 1.f), depth);
+      }
+    }
+  }
+
+  VTKH_DATA_ADD("culled_domains", culled_domains);
+  VTKH_DATA_ADD("culled_cells", culled_cells);
+  VTKH_DATA_ADD("empty_domains", empty_domains);
+}
+
+} // namespace vtkh
@@ -0,0 +1,48 @@
+#ifndef VTK_H_RENDERER_ISOSURFACE_HPP
+#define VTK_H_RENDERER_ISOSURFACE_HPP
+
+#include <vtkh/vtkh_exports.h>
+#include <vtkh/rendering/Renderer.hpp>
+
+namespace vtkh {
+
+namespace detail
+{
+  class IsoDomain;
+}
+
+//
+// Renders isosurfaces of a point field by marching camera rays
+// through uniform and rectilinear domains and finding the iso
+// crossings directly, so no geometry is extracted. The result
+// is written into the canvas depth buffer like any surface, so
+// it composites and mixes with the other renderers in a Scene.
+//
+class VTKH_API IsosurfaceRenderer : public Renderer
+{
+public:
+  IsosurfaceRenderer();
+  virtual ~IsosurfaceRenderer();
+  std::string GetName() const override;
+  static Renderer::vtkmCanvasPtr GetNewCanvas(int width = 1024, int height = 1024);
+
+  void SetIsoValue(const double &iso_value);
+  void SetIsoValues(const double *iso_values, const int &num_values);
+  // distance between samples as a fraction of the smallest
+  // point spacing of a domain. Defaults to 0.5
+  void SetSampleFraction(const float fraction);
+
+  virtual void SetInput(DataSet *input) override;
+protected:
+  virtual void DoExecute() override;
+  virtual void AddToFingerprint(Fingerprint &fingerprint) const override;
+
+  void ClearDomains();
+
+  std::vector<double> m_iso_values;
+  float m_sample_fraction;
+  std::vector<detail::IsoDomain*> m_domains;
+};
+
+} // namespace vtkh
+#endif
@@ -1,4 +1,5 @@
 #include "LineRenderer.hpp"
+#include <vtkh/rendering/Fingerprint.hpp>
 
 #include <vtkm/rendering/CanvasRayTracer.h>
 #include <vtkm/rendering/MapperCylinder.h>
@@ -32,6 +33,13 @@ LineRenderer::GetName() const
   return "vtkh::LineRenderer";
 }
 
+void
+LineRenderer::AddToFingerprint(Fingerprint &fingerprint) const
+{
+  fingerprint.AddValue(m_radius_set);
+  fingerprint.AddValue(m_radius);
+}
+
 void
 LineRenderer::SetRadius(vtkm::Float32 radius)
 {
@@ -40,6 +48,21 @@ LineRenderer::SetRadius(vtkm::Float32 radius)
 }
 
 
+vtkm::Float64
+LineRenderer::GetCullingPad() const
+{
+  if(m_radius_set)
+  {
+    return m_radius;
+  }
+  // the default radius of the mapper is a small fraction
+  // of the data size, stay well above it
+  const vtkm::Float64 lx = m_bounds.X.Length();
+  const vtkm::Float64 ly = m_bounds.Y.Length();
+  const vtkm::Float64 lz = m_bounds.Z.Length();
+  return 0.01 * vtkm::Sqrt(lx * lx + ly * ly + lz * lz);
+}
+
 void
 LineRenderer::PreExecute()
 {
@@ -15,6 +15,9 @@ public:
   static Renderer::vtkmCanvasPtr GetNewCanvas(int width = 1024, int height = 1024);
   void PreExecute() override;
   void SetRadius(vtkm::Float32 radius);
+protected:
+  vtkm::Float64 GetCullingPad() const override;
+  void AddToFingerprint(Fingerprint &fingerprint) const override;
 private:
   bool m_radius_set;
   vtkm::Float32 m_radius;
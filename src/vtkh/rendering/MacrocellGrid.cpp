@@ -0,0 +1,410 @@
+#include "MacrocellGrid.hpp"
+#include "StructuredSampler.hpp"
+
+#include <vtkh/Error.hpp>
+#include <vtkh/utils/vtkm_dataset_info.hpp>
+
+#include <vtkm/TypeList.h>
+#include <vtkm/VectorAnalysis.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// number of cells along each side of a macrocell
+#define VTKH_MACROCELL_SIZE 8
+
+namespace vtkh
+{
+
+namespace detail
+{
+
+struct MinMaxFunctor
+{
+  MacrocellGrid *m_grid;
+  bool m_point_field;
+
+  template<typename T, typename S>
+  void operator()(const vtkm::cont::ArrayHandle<T,S> &array) const
+  {
+    m_grid->compute_min_max(array.ReadPortal(), m_point_field);
+  }
+};
+
+OpacityLookup::OpacityLookup()
+  : m_scalar_min(0.f),
+    m_inv_scalar_delta(0.f)
+{
+}
+
+void
+OpacityLookup::build(const vtkm::cont::ArrayHandle<vtkm::Vec4f_32> &color_map,
+                     const vtkm::Range &scalar_range)
+{
+  const int size = static_cast<int>(color_map.GetNumberOfValues());
+  auto portal = color_map.ReadPortal();
+
+  m_opaque_counts.resize(size + 1);
+  m_opaque_counts[0] = 0;
+  for(int i = 0; i < size; ++i)
+  {
+    const int opaque = portal.Get(i)[3] > 0.f ? 1 : 0;
+    m_opaque_counts[i + 1] = m_opaque_counts[i] + opaque;
+  }
+
+  m_scalar_min = static_cast<float>(scalar_range.Min);
+  const double length = scalar_range.Length();
+  m_inv_scalar_delta = length > 0. ? static_cast<float>(1. / length) : 0.f;
+}
+
+int
+OpacityLookup::sample_index(const float &value, bool round_up) const
+{
+  const int max_index = static_cast<int>(m_opaque_counts.size()) - 2;
+  float normalized = (value - m_scalar_min) * m_inv_scalar_delta;
+  normalized = std::min(1.f, std::max(0.f, normalized));
+  const float index = normalized * static_cast<float>(max_index);
+  int res = static_cast<int>(round_up ? std::ceil(index) : std::floor(index));
+  return std::min(max_index, std::max(0, res));
+}
+
+bool
+OpacityLookup::transparent(const float &min, const float &max) const
+{
+  // be conservative when there is nothing to go on
+  if(m_opaque_counts.size() < 2 || !(min <= max))
+  {
+    return false;
+  }
+
+  // the tracers may interpolate between neighboring samples
+  // so we include both sides of the range
+  const int first = sample_index(min, false);
+  const int last = sample_index(max, true);
+  return m_opaque_counts[last + 1] - m_opaque_counts[first] == 0;
+}
+
+bool
+OpacityLookup::transparent(const vtkm::Range &range) const
+{
+  if(!range.IsNonEmpty())
+  {
+    return false;
+  }
+  return transparent(static_cast<float>(range.Min),
+                     static_cast<float>(range.Max));
+}
+
+MacrocellGrid::MacrocellGrid()
+{
+  for(int i = 0; i < 3; ++i)
+  {
+    m_cell_dims[i] = 0;
+    m_dims[i] = 0;
+    m_visible_min[i] = 0;
+    m_visible_max[i] = -1;
+  }
+}
+
+int
+MacrocellGrid::num_macrocells() const
+{
+  return m_dims[0] * m_dims[1] * m_dims[2];
+}
+
+void
+MacrocellGrid::update(const vtkm::cont::DataSet &data_set,
+                      const std::string &field_name)
+{
+  if(field_name == m_field_name)
+  {
+    return;
+  }
+
+  m_field_name = field_name;
+  for(int i = 0; i < 3; ++i)
+  {
+    m_dims[i] = 0;
+  }
+  m_min.clear();
+  m_max.clear();
+  m_visible.clear();
+
+  int topo_dims;
+  if(!VTKMDataSetInfo::IsStructured(data_set, topo_dims) || topo_dims != 3)
+  {
+    // leave the grid empty and let the caller trace everything
+    return;
+  }
+
+  int point_dims[3];
+  VTKMDataSetInfo::GetPointDims(data_set, point_dims);
+
+  const vtkm::cont::CoordinateSystem &coords = data_set.GetCoordinateSystem();
+  if(!VTKMDataSetInfo::IsUniform(coords) && !VTKMDataSetInfo::IsRectilinear(coords))
+  {
+    throw Error("MacrocellGrid: coordinates must be uniform or rectilinear");
+  }
+  axis_coordinates(data_set, m_coords);
+
+  for(int d = 0; d < 3; ++d)
+  {
+    m_cell_dims[d] = point_dims[d] - 1;
+    m_dims[d] = (m_cell_dims[d] + VTKH_MACROCELL_SIZE - 1) / VTKH_MACROCELL_SIZE;
+    m_planes[d].resize(m_dims[d] + 1);
+    for(int i = 0; i <= m_dims[d]; ++i)
+    {
+      const int point = std::min(i * VTKH_MACROCELL_SIZE, m_cell_dims[d]);
+      m_planes[d][i] = m_coords[d][point];
+    }
+  }
+
+  const vtkm::cont::Field &field = data_set.GetField(field_name);
+  const bool point_field =
+    field.GetAssociation() == vtkm::cont::Field::Association::POINTS;
+
+  MinMaxFunctor functor;
+  functor.m_grid = this;
+  functor.m_point_field = point_field;
+  field.GetData().ResetTypes(vtkm::TypeListFieldScalar(),
+                             VTKM_DEFAULT_STORAGE_LIST{}).CastAndCall(functor);
+}
+
+template<typename PortalType>
+void
+MacrocellGrid::compute_min_max(const PortalType &portal, bool point_field)
+{
+  const int size = num_macrocells();
+  m_min.resize(size);
+  m_max.resize(size);
+
+  // point fields include the points on the far side of the
+  // macrocell since they contribute to the interpolation
+  const int extra = point_field ? 1 : 0;
+  const int dx = m_cell_dims[0] + extra;
+  const int dy = m_cell_dims[1] + extra;
+
+#ifdef VTKH_USE_OPENMP
+  #pragma omp parallel for
+#endif
+  for(int m = 0; m < size; ++m)
+  {
+    const int mx = m % m_dims[0];
+    const int my = (m / m_dims[0]) % m_dims[1];
+    const int mz = m / (m_dims[0] * m_dims[1]);
+    const int x0 = mx * VTKH_MACROCELL_SIZE;
+    const int y0 = my * VTKH_MACROCELL_SIZE;
+    const int z0 = mz * VTKH_MACROCELL_SIZE;
+    const int x1 = std::min(x0 + VTKH_MACROCELL_SIZE, m_cell_dims[0]) + extra;
+    const int y1 = std::min(y0 + VTKH_MACROCELL_SIZE, m_cell_dims[1]) + extra;
+    const int z1 = std::min(z0 + VTKH_MACROCELL_SIZE, m_cell_dims[2]) + extra;
+
+    float vmin = std::numeric_limits<float>::max();
+    float vmax = std::numeric_limits<float>::lowest();
+    for(int z = z0; z < z1; ++z)
+    {
+      for(int y = y0; y < y1; ++y)
+      {
+        const vtkm::Id offset = (static_cast<vtkm::Id>(z) * dy + y) * dx;
+        for(int x = x0; x < x1; ++x)
+        {
+          const float value = static_cast<float>(portal.Get(offset + x));
+          vmin = std::min(vmin, value);
+          vmax = std::max(vmax, value);
+        }
+      }
+    }
+    m_min[m] = vmin;
+    m_max[m] = vmax;
+  }
+}
+
+int
+MacrocellGrid::classify(const OpacityLookup &opacity)
+{
+  const int size = num_macrocells();
+  m_visible.resize(size);
+
+  int num_visible = 0;
+#ifdef VTKH_USE_OPENMP
+  #pragma omp parallel for reduction(+:num_visible)
+#endif
+  for(int m = 0; m < size; ++m)
+  {
+    const bool visible = !opacity.transparent(m_min[m], m_max[m]);
+    m_visible[m] = visible ? 1 : 0;
+    num_visible += visible ? 1 : 0;
+  }
+
+  update_visible_range();
+  return num_visible;
+}
+
+int
+MacrocellGrid::classify(const std::vector<float> &values)
+{
+  const int size = num_macrocells();
+  const int num_values = static_cast<int>(values.size());
+  m_visible.resize(size);
+
+  int num_visible = 0;
+#ifdef VTKH_USE_OPENMP
+  #pragma omp parallel for reduction(+:num_visible)
+#endif
+  for(int m = 0; m < size; ++m)
+  {
+    bool visible = false;
+    for(int i = 0; i < num_values && !visible; ++i)
+    {
+      visible = m_min[m] <= values[i] && values[i] <= m_max[m];
+    }
+    m_visible[m] = visible ? 1 : 0;
+    num_visible += visible ? 1 : 0;
+  }
+
+  update_visible_range();
+  return num_visible;
+}
+
+void
+MacrocellGrid::update_visible_range()
+{
+  const int size = num_macrocells();
+  for(int d = 0; d < 3; ++d)
+  {
+    m_visible_min[d] = m_dims[d];
+    m_visible_max[d] = -1;
+  }
+
+  for(int m = 0; m < size; ++m)
+  {
+    if(!m_visible[m]) continue;
+    const int index[3] = {m % m_dims[0],
+                          (m / m_dims[0]) % m_dims[1],
+                          m / (m_dims[0] * m_dims[1])};
+    for(int d = 0; d < 3; ++d)
+    {
+      m_visible_min[d] = std::min(m_visible_min[d], index[d]);
+      m_visible_max[d] = std::max(m_visible_max[d], index[d]);
+    }
+  }
+}
+
+vtkm::Bounds
+MacrocellGrid::visible_bounds() const
+{
+  vtkm::Bounds bounds;
+  if(m_visible_max[0] < m_visible_min[0])
+  {
+    return bounds;
+  }
+
+  vtkm::Range *ranges[3] = {&bounds.X, &bounds.Y, &bounds.Z};
+  for(int d = 0; d < 3; ++d)
+  {
+    const int first = m_visible_min[d] * VTKH_MACROCELL_SIZE;
+    const int last = std::min((m_visible_max[d] + 1) * VTKH_MACROCELL_SIZE,
+                              m_cell_dims[d]);
+    ranges[d]->Min = m_coords[d][first];
+    ranges[d]->Max = m_coords[d][last];
+  }
+  return bounds;
+}
+
+int
+MacrocellGrid::segments(const vtkm::Vec3f_32 &origin,
+                        const vtkm::Vec3f_32 &dir,
+                        float tmin,
+                        float tmax,
+                        const float min_gap,
+                        const int max_segments,
+                        float *starts,
+                        float *ends) const
+{
+  // clip the interval to the grid
+  for(int d = 0; d < 3; ++d)
+  {
+    const float inv_dir = 1.f / dir[d];
+    float t0 = (m_planes[d].front() - origin[d]) * inv_dir;
+    float t1 = (m_planes[d].back() - origin[d]) * inv_dir;
+    if(t0 > t1) std::swap(t0, t1);
+    tmin = std::max(tmin, t0);
+    tmax = std::min(tmax, t1);
+  }
+
+  if(!(tmin < tmax))
+  {
+    return 0;
+  }
+
+  // find the starting macrocell and the distance
+  // to the next boundary along each axis
+  int index[3];
+  int step[3];
+  float t_next[3];
+  for(int d = 0; d < 3; ++d)
+  {
+    const std::vector<float> &planes = m_planes[d];
+    const float pos = origin[d] + dir[d] * tmin;
+    int i = static_cast<int>(std::upper_bound(planes.begin(), planes.end(), pos)
+                             - planes.begin()) - 1;
+    i = std::min(m_dims[d] - 1, std::max(0, i));
+    index[d] = i;
+
+    if(dir[d] > 0.f)
+    {
+      step[d] = 1;
+      t_next[d] = (planes[i + 1] - origin[d]) / dir[d];
+    }
+    else if(dir[d] < 0.f)
+    {
+      step[d] = -1;
+      t_next[d] = (planes[i] - origin[d]) / dir[d];
+    }
+    else
+    {
+      step[d] = 0;
+      t_next[d] = std::numeric_limits<float>::max();
+    }
+  }
+
+  int count = 0;
+  float t = tmin;
+  while(t < tmax)
+  {
+    int axis = 0;
+    if(t_next[1] < t_next[axis]) axis = 1;
+    if(t_next[2] < t_next[axis]) axis = 2;
+    const float t_exit = std::min(t_next[axis], tmax);
+
+    const int m = index[0] + m_dims[0] * (index[1] + m_dims[1] * index[2]);
+    if(m_visible[m])
+    {
+      if(count > 0 && (t - ends[count - 1] <= min_gap || count == max_segments))
+      {
+        ends[count - 1] = t_exit;
+      }
+      else
+      {
+        starts[count] = t;
+        ends[count] = t_exit;
+        count++;
+      }
+    }
+
+    t = t_exit;
+    index[axis] += step[axis];
+    if(index[axis] < 0 || index[axis] >= m_dims[axis])
+    {
+      break;
+    }
+    const int plane = step[axis] > 0 ? index[axis] + 1 : index[axis];
+    t_next[axis] = (m_planes[axis][plane] - origin[axis]) / dir[axis];
+  }
+
+  return count;
+}
+
+} // namespace detail
+} // namespace vtkh
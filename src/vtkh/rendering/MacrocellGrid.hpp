@@ -0,0 +1,108 @@
+#ifndef VTK_H_MACROCELL_GRID_HPP
+#define VTK_H_MACROCELL_GRID_HPP
+
+#include <vtkh/vtkh_exports.h>
+
+#include <vtkm/Bounds.h>
+#include <vtkm/Range.h>
+#include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/DataSet.h>
+
+#include <string>
+#include <vector>
+
+namespace vtkh
+{
+
+namespace detail
+{
+
+//
+// Answers the question: does any scalar value in a range map
+// to a non-zero opacity? We keep a prefix count of the
+// non-transparent color map samples so each query is O(1).
+//
+class VTKH_API OpacityLookup
+{
+public:
+  OpacityLookup();
+
+  void build(const vtkm::cont::ArrayHandle<vtkm::Vec4f_32> &color_map,
+             const vtkm::Range &scalar_range);
+
+  bool transparent(const vtkm::Range &range) const;
+  bool transparent(const float &min, const float &max) const;
+protected:
+  int sample_index(const float &value, bool round_up) const;
+
+  std::vector<int> m_opaque_counts;
+  float m_scalar_min;
+  float m_inv_scalar_delta;
+};
+
+//
+// Coarse grid of min/max field values over bricks of cells of a
+// uniform or rectilinear data set. The grid only depends on the
+// data, so it is built once per field and re-classified against
+// the transfer function at each render.
+//
+class VTKH_API MacrocellGrid
+{
+public:
+  MacrocellGrid();
+
+  // builds the grid if it does not exist for this field
+  void update(const vtkm::cont::DataSet &data_set,
+              const std::string &field_name);
+
+  // flags each macrocell as visible or transparent and returns
+  // the number of visible macrocells
+  int classify(const OpacityLookup &opacity);
+  // flags the macrocells that contain any of the values
+  int classify(const std::vector<float> &values);
+
+  // bounds of all visible macrocells
+  vtkm::Bounds visible_bounds() const;
+
+  int num_macrocells() const;
+
+  //
+  // Walks the macrocells along the ray interval [tmin, tmax] and
+  // returns the number of intervals that cross visible macrocells.
+  // Intervals separated by less than min_gap are merged, and once
+  // max_segments is reached the remaining ones are merged into
+  // the last interval.
+  //
+  int segments(const vtkm::Vec3f_32 &origin,
+               const vtkm::Vec3f_32 &dir,
+               float tmin,
+               float tmax,
+               const float min_gap,
+               const int max_segments,
+               float *starts,
+               float *ends) const;
+protected:
+  template<typename PortalType>
+  void compute_min_max(const PortalType &portal, bool point_field);
+  void update_visible_range();
+
+  std::string m_field_name;
+  int m_cell_dims[3];
+  int m_dims[3];
+  std::vector<float> m_min;
+  std::vector<float> m_max;
+  std::vector<unsigned char> m_visible;
+  // point coordinates along each axis
+  std::vector<float> m_coords[3];
+  // macrocell boundaries along each axis
+  std::vector<float> m_planes[3];
+  // index range of visible macrocells
+  int m_visible_min[3];
+  int m_visible_max[3];
+
+  friend struct MinMaxFunctor;
+};
+
+} // namespace detail
+} // namespace vtkh
+#endif
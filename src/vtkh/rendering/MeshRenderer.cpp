@@ -1,4 +1,5 @@
 #include "MeshRenderer.hpp"
+#include <vtkh/rendering/Fingerprint.hpp>
 
 #include <vtkm/rendering/CanvasRayTracer.h>
 #include <vtkm/rendering/MapperWireframer.h>
@@ -90,4 +91,12 @@ MeshRenderer::GetName() const
   return "vtkh::MeshRenderer";
 }
 
+void
+MeshRenderer::AddToFingerprint(Fingerprint &fingerprint) const
+{
+  fingerprint.AddValue(m_use_foreground_color);
+  fingerprint.AddValue(m_is_overlay);
+  fingerprint.AddValue(m_show_internal);
+}
+
 } // namespace vtkh
@@ -21,6 +21,7 @@ public:
   bool GetShowInternal() const;
 protected:
   void PreExecute() override;
+  void AddToFingerprint(Fingerprint &fingerprint) const override;
   bool m_use_foreground_color;
   bool m_is_overlay;
   bool m_show_internal;
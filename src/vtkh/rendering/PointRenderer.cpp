@@ -1,8 +1,11 @@
 #include "PointRenderer.hpp"
+#include <vtkh/rendering/Fingerprint.hpp>
 
 #include <vtkm/rendering/CanvasRayTracer.h>
 #include <vtkm/rendering/MapperPoint.h>
 #include <vtkh/filters/ParticleMerging.hpp>
+#include <vtkh/Logger.hpp>
+#include <algorithm>
 #include <memory>
 
 namespace vtkh {
@@ -15,7 +18,11 @@ PointRenderer::PointRenderer()
     m_delta_radius(0.5f),
     m_use_point_merging(false),
     m_radius_mult(2.f),
-    m_delete_input(false)
+    m_use_lod(false),
+    m_lod_pixels(1.f),
+    m_delete_input(false),
+    m_user_input(nullptr),
+    m_max_radius(0.f)
 {
   typedef vtkm::rendering::MapperPoint TracerType;
   auto mapper = std::make_shared<TracerType>();
@@ -39,6 +46,20 @@ PointRenderer::GetName() const
   return "vtkh::PointRenderer";
 }
 
+void
+PointRenderer::AddToFingerprint(Fingerprint &fingerprint) const
+{
+  fingerprint.AddValue(m_use_nodes);
+  fingerprint.AddValue(m_radius_set);
+  fingerprint.AddValue(m_use_variable_radius);
+  fingerprint.AddValue(m_base_radius);
+  fingerprint.AddValue(m_delta_radius);
+  fingerprint.AddValue(m_use_point_merging);
+  fingerprint.AddValue(m_radius_mult);
+  fingerprint.AddValue(m_use_lod);
+  fingerprint.AddValue(m_lod_pixels);
+}
+
 void
 PointRenderer::UseCells()
 {
@@ -57,6 +78,65 @@ PointRenderer::PointMergeRadiusMultiplyer(vtkm::Float32 radius_mult)
   m_radius_mult = radius_mult;
 }
 
+void
+PointRenderer::UseLevelOfDetail(bool lod)
+{
+  m_use_lod = lod;
+}
+
+void
+PointRenderer::SetLevelOfDetailPixels(vtkm::Float32 pixels)
+{
+  if(pixels <= 0.f)
+  {
+    throw Error("PointRenderer: level of detail pixels must be greater than zero");
+  }
+  m_lod_pixels = pixels;
+}
+
+vtkm::Float32
+PointRenderer::LevelOfDetailBinSize() const
+{
+  //
+  // Find the world space size of a pixel at the closest point
+  // of the data for every camera and use the smallest one, so
+  // no camera sees more than one bin per pixel.
+  //
+  vtkm::Float64 bin_size = vtkm::Infinity64();
+  const int num_renders = static_cast<int>(m_renders.size());
+  for(int i = 0; i < num_renders; ++i)
+  {
+    const vtkm::rendering::Camera &camera = m_renders[i].GetCamera();
+    const vtkm::Vec<vtkm::Float64,3> pos = camera.GetPosition();
+    const vtkm::Range *ranges[3] = {&m_bounds.X, &m_bounds.Y, &m_bounds.Z};
+    vtkm::Float64 dist2 = 0.;
+    for(int d = 0; d < 3; ++d)
+    {
+      const vtkm::Float64 closest = vtkm::Max(ranges[d]->Min, vtkm::Min(ranges[d]->Max, pos[d]));
+      dist2 += (pos[d] - closest) * (pos[d] - closest);
+    }
+    // the camera could be inside the data
+    const vtkm::Float64 dist = vtkm::Max(vtkm::Sqrt(dist2),
+                                         vtkm::Float64(camera.GetClippingRange().Min));
+
+    const vtkm::Float64 fov = camera.GetFieldOfView() * vtkm::Pi_180();
+    vtkm::Float64 pixel_size = 2. * dist * vtkm::Tan(0.5 * fov) /
+                               static_cast<vtkm::Float64>(m_renders[i].GetHeight());
+    const vtkm::Float64 zoom = camera.GetZoom();
+    if(zoom > 0)
+    {
+      pixel_size /= zoom;
+    }
+    bin_size = vtkm::Min(bin_size, pixel_size * m_lod_pixels);
+  }
+
+  if(num_renders == 0 || !(bin_size > 0.))
+  {
+    return 0.f;
+  }
+  return static_cast<vtkm::Float32>(bin_size);
+}
+
 void
 PointRenderer::UseNodes()
 {
@@ -124,6 +204,7 @@ PointRenderer::PreExecute()
     mesh_mapper->SetRadius(radius);
   }
 
+  vtkm::Float32 merge_radius = 0.f;
   if(!m_use_nodes && this->m_input->IsPointMesh() && m_use_point_merging)
   {
     vtkm::Float32 max_radius = radius;
@@ -131,12 +212,46 @@ PointRenderer::PreExecute()
     {
       max_radius = radius + radius * m_delta_radius;
     }
+    merge_radius = max_radius * m_radius_mult;
+  }
 
+  if(m_use_lod && this->m_input->IsPointMesh())
+  {
+    // not worth it if every point can have its own pixel
+    long long int max_pixels = 0;
+    for(size_t i = 0; i < m_renders.size(); ++i)
+    {
+      max_pixels = std::max(max_pixels,
+                            static_cast<long long int>(m_renders[i].GetWidth()) *
+                            static_cast<long long int>(m_renders[i].GetHeight()));
+    }
+
+    const vtkm::Float32 bin_size = LevelOfDetailBinSize();
+    // all ranks have to agree, otherwise the splats of
+    // some ranks grow while the others keep their size
+    const long long int num_points = this->m_input->GetGlobalNumberOfCells();
+    // the merging bins are twice the merge radius
+    if(bin_size > 0.f && num_points > max_pixels && bin_size * 0.5f > merge_radius)
+    {
+      merge_radius = bin_size * 0.5f;
+      // representative splats need to cover their bin
+      if(radius < merge_radius)
+      {
+        radius = merge_radius;
+        mesh_mapper->SetRadius(radius);
+      }
+      VTKH_DATA_ADD("lod_bin_size", bin_size);
+    }
+  }
+
+  if(merge_radius > 0.f)
+  {
     ParticleMerging  merger;
     merger.SetInput(this->m_input);
     merger.SetField(this->m_field_name);
-    merger.SetRadius(max_radius * m_radius_mult);
+    merger.SetRadius(merge_radius);
     merger.Update();
+    m_user_input = this->m_input;
     this->m_input = merger.GetOutput();
     m_delete_input = true;
   }
@@ -144,6 +259,19 @@ PointRenderer::PreExecute()
   mesh_mapper->UseVariableRadius(m_use_variable_radius);
   mesh_mapper->SetRadiusDelta(m_delta_radius);
 
+  m_max_radius = radius;
+  if(m_use_variable_radius)
+  {
+    m_max_radius = radius + radius * m_delta_radius;
+  }
+
+}
+
+vtkm::Float64
+PointRenderer::GetCullingPad() const
+{
+  // spheres reach past the points by their radius
+  return m_max_radius;
 }
 
 void PointRenderer::PostExecute()
@@ -151,7 +279,11 @@ void PointRenderer::PostExecute()
   Renderer::PostExecute();
   if(m_delete_input)
   {
+    // the next execution has to start from the user's input
     delete this->m_input;
+    this->m_input = m_user_input;
+    m_user_input = nullptr;
+    m_delete_input = false;
   }
 }
 
@@ -24,6 +24,16 @@ public:
   // sets the number or radii to merge points
   // defualts to 2 * radius
   void PointMergeRadiusMultiplyer(vtkm::Float32 radius_mult);
+  // merges point meshes into bins about the size of a pixel
+  // (at the closest point of the data) when there are more
+  // points than pixels, and grows the radius to cover the bin
+  void UseLevelOfDetail(bool lod);
+  // bin size in pixels, defaults to 1
+  void SetLevelOfDetailPixels(vtkm::Float32 pixels);
+protected:
+  vtkm::Float32 LevelOfDetailBinSize() const;
+  vtkm::Float64 GetCullingPad() const override;
+  void AddToFingerprint(Fingerprint &fingerprint) const override;
 private:
   bool m_use_nodes;
   bool m_radius_set;
@@ -32,7 +42,13 @@ private:
   vtkm::Float32 m_delta_radius;
   bool m_use_point_merging;
   vtkm::Float32 m_radius_mult;
+  bool m_use_lod;
+  vtkm::Float32 m_lod_pixels;
   bool m_delete_input;
+  // the input set by the user while m_input is a merged copy
+  DataSet *m_user_input;
+  // largest sphere radius of the current execution
+  vtkm::Float32 m_max_radius;
 
 };
 
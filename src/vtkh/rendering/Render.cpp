@@ -1,21 +1,152 @@
 #include "Render.hpp"
 #include <vtkh/rendering/Annotator.hpp>
+#include <vtkh/rendering/Fingerprint.hpp>
+#include <vtkh/utils/AsyncImageWriter.hpp>
 #include <vtkh/utils/PNGEncoder.hpp>
+#include <vtkh/utils/QOIEncoder.hpp>
 #include <vtkh/utils/vtkm_array_utils.hpp>
 #include <vtkm/rendering/MapperRayTracer.h>
 #include <vtkm/rendering/View2D.h>
 #include <vtkm/rendering/View3D.h>
 
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <string.h>
+
 namespace vtkh
 {
 
+namespace detail
+{
+
+// same blend as the canvas: color + (1 - alpha) * background
+void blend_background(unsigned char *rgba, const int size, const vtkm::rendering::Color &bg)
+{
+  int bg_color[4];
+  for(int c = 0; c < 4; ++c)
+  {
+    bg_color[c] = static_cast<int>(bg.Components[c] * 255.f);
+  }
+
+#ifdef VTKH_USE_OPENMP
+  #pragma omp parallel for
+#endif
+  for(int i = 0; i < size; ++i)
+  {
+    unsigned char *pixel = rgba + i * 4;
+    const int opacity = 255 - static_cast<int>(pixel[3]);
+    for(int c = 0; c < 4; ++c)
+    {
+      const int value = pixel[c] + (opacity * bg_color[c] + 127) / 255;
+      pixel[c] = static_cast<unsigned char>(value > 255 ? 255 : value);
+    }
+  }
+}
+
+// premultiplied 'over': layer + (1 - layer alpha) * image. Layers
+// with depths are only blended where they are in front
+void blend_layer(unsigned char *rgba,
+                 const float *depths,
+                 const AnnotationLayer &layer,
+                 const int size)
+{
+  const unsigned char *over = &layer.m_rgba[0];
+  const float *layer_depths = layer.m_depths.empty() ? nullptr : &layer.m_depths[0];
+#ifdef VTKH_USE_OPENMP
+  #pragma omp parallel for
+#endif
+  for(int i = 0; i < size; ++i)
+  {
+    const unsigned char *src = over + i * 4;
+    if((src[0] | src[1] | src[2] | src[3]) == 0)
+    {
+      continue;
+    }
+    if(layer_depths != nullptr && layer_depths[i] >= depths[i])
+    {
+      continue;
+    }
+    unsigned char *pixel = rgba + i * 4;
+    const int transparency = 255 - static_cast<int>(src[3]);
+    for(int c = 0; c < 4; ++c)
+    {
+      const int value = src[c] + (pixel[c] * transparency + 127) / 255;
+      pixel[c] = static_cast<unsigned char>(value > 255 ? 255 : value);
+    }
+  }
+}
+
+void canvas_to_layer(Render::vtkmCanvas &canvas, bool get_depth, AnnotationLayer &layer)
+{
+  const int size = canvas.GetWidth() * canvas.GetHeight();
+  const float *colors = &GetVTKMPointer(canvas.GetColorBuffer())[0][0];
+  layer.m_rgba.resize(size * 4);
+#ifdef VTKH_USE_OPENMP
+  #pragma omp parallel for
+#endif
+  for(int i = 0; i < size * 4; ++i)
+  {
+    layer.m_rgba[i] = static_cast<unsigned char>(colors[i] * 255.f);
+  }
+
+  layer.m_depths.clear();
+  if(get_depth)
+  {
+    const float *depths = GetVTKMPointer(canvas.GetDepthBuffer());
+    layer.m_depths.assign(depths, depths + size);
+  }
+}
+
+void append_camera_key(std::ostringstream &key, const vtkm::rendering::Camera &camera)
+{
+  vtkm::Float32 viewport[4];
+  camera.GetViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+  vtkm::Float32 view_range[4];
+  camera.GetViewRange2D(view_range[0], view_range[1], view_range[2], view_range[3]);
+  const vtkm::Vec3f_32 position = camera.GetPosition();
+  const vtkm::Vec3f_32 look_at = camera.GetLookAt();
+  const vtkm::Vec3f_32 view_up = camera.GetViewUp();
+  const vtkm::Range clipping = camera.GetClippingRange();
+  const vtkm::Vec2f_32 pan = camera.GetPan();
+
+  key<<static_cast<int>(camera.GetMode());
+  for(int i = 0; i < 3; ++i)
+  {
+    key<<" "<<position[i]<<" "<<look_at[i]<<" "<<view_up[i];
+  }
+  for(int i = 0; i < 4; ++i)
+  {
+    key<<" "<<viewport[i]<<" "<<view_range[i];
+  }
+  key<<" "<<camera.GetFieldOfView()
+     <<" "<<clipping.Min<<" "<<clipping.Max
+     <<" "<<camera.GetZoom()
+     <<" "<<pan[0]<<" "<<pan[1];
+}
+
+void append_color_key(std::ostringstream &key, const vtkm::rendering::Color &color)
+{
+  for(int i = 0; i < 4; ++i)
+  {
+    key<<" "<<color.Components[i];
+  }
+}
+
+} // namespace detail
+
 Render::Render()
   : m_width(1024),
     m_height(1024),
     m_render_annotations(true),
     m_render_background(true),
     m_shading(true),
-    m_canvas(m_width, m_height)
+    m_image_format(IMAGE_PNG),
+    m_encode_sink(false),
+    m_canvas(m_width, m_height),
+    m_color_bytes(std::make_shared<ColorBytes>(std::make_shared<std::vector<unsigned char>>())),
+    m_tile_height(0),
+    m_is_tile(false)
 {
   m_world_annotation_scale[0] = 1.f;
   m_world_annotation_scale[1] = 1.f;
@@ -76,6 +207,7 @@ Render::SetWidth(const vtkm::Int32 width)
   if(width == m_width) return;
   m_width = width;
   m_canvas.ResizeBuffers(m_width, m_height);
+  ClearColorBytes();
 }
 
 void
@@ -90,12 +222,32 @@ Render::GetShadingOn() const
   return m_shading;
 }
 
+void
+Render::SetImageFormat(const ImageFormat format)
+{
+  m_image_format = format;
+}
+
+void
+Render::SetImageSink(ImageSink sink, bool encode)
+{
+  m_image_sink = sink;
+  m_encode_sink = encode;
+}
+
+ImageFormat
+Render::GetImageFormat() const
+{
+  return m_image_format;
+}
+
 void
 Render::SetHeight(const vtkm::Int32 height)
 {
   if(height == m_height) return;
   m_height = height;
   m_canvas.ResizeBuffers(m_width, m_height);
+  ClearColorBytes();
 }
 
 void
@@ -171,6 +323,7 @@ Render::RenderWorldAnnotations()
 #ifdef VTKH_PARALLEL
   if(vtkh::GetMPIRank() != 0) return;
 #endif
+  SyncCanvasColors();
   m_canvas.SetBackgroundColor(m_bg_color);
   m_canvas.SetForegroundColor(m_fg_color);
 
@@ -187,17 +340,31 @@ Render::RenderScreenAnnotations(const std::vector<std::string> &field_names,
 #ifdef VTKH_PARALLEL
   if(vtkh::GetMPIRank() != 0) return;
 #endif
+  if(!m_render_annotations)
+  {
+    RenderBackground();
+    return;
+  }
+
+  SyncCanvasColors();
   m_canvas.SetBackgroundColor(m_bg_color);
   m_canvas.SetForegroundColor(m_fg_color);
   if(m_render_background) m_canvas.BlendBackground();
 
-  if(!m_render_annotations) return;
   Annotator annotator(m_canvas, m_camera, m_scene_bounds);
   annotator.RenderScreenAnnotations(field_names, ranges, colors);
 }
 
 Render
 Render::Copy() const
+{
+  Render copy = CopySettings();
+  copy.m_canvas = CreateCanvas();
+  return copy;
+}
+
+Render
+Render::CopySettings() const
 {
   Render copy;
   copy.m_camera = m_camera;
@@ -210,8 +377,13 @@ Render::Copy() const
   copy.m_render_annotations = m_render_annotations;
   copy.m_render_background = m_render_background;
   copy.m_shading = m_shading;
-  copy.m_canvas = CreateCanvas();
+  copy.m_image_format = m_image_format;
+  copy.m_image_sink = m_image_sink;
+  copy.m_encode_sink = m_encode_sink;
+  copy.m_color_bytes = std::make_shared<ColorBytes>(std::make_shared<std::vector<unsigned char>>());
   copy.m_world_annotation_scale = m_world_annotation_scale;
+  copy.m_tile_height = m_tile_height;
+  copy.m_is_tile = m_is_tile;
   return copy;
 }
 
@@ -246,7 +418,312 @@ Render::Print() const
 void
 Render::RenderBackground()
 {
-  if(m_render_background) m_canvas.BlendBackground();
+  if(!m_render_background) return;
+
+  if(HasColorBytes())
+  {
+    detail::blend_background(&MutableColorBytes(true)[0], m_width * m_height, m_bg_color);
+  }
+  else
+  {
+    m_canvas.SetBackgroundColor(m_bg_color);
+    m_canvas.BlendBackground();
+  }
+}
+
+void
+Render::CanvasColorsToBytes()
+{
+  const int size = m_width * m_height * 4;
+  const float* color_buffer = &GetVTKMPointer(m_canvas.GetColorBuffer())[0][0];
+  std::vector<unsigned char> &rgba = MutableColorBytes(false);
+  rgba.resize(size);
+  unsigned char *bytes = &rgba[0];
+#ifdef VTKH_USE_OPENMP
+  #pragma omp parallel for
+#endif
+  for(int i = 0; i < size; ++i)
+  {
+    bytes[i] = static_cast<unsigned char>(color_buffer[i] * 255.f);
+  }
+}
+
+std::string
+Render::WorldLayerKey() const
+{
+  std::ostringstream key;
+  key<<std::hexfloat<<"world "<<m_width<<" "<<m_height;
+  detail::append_color_key(key, m_fg_color);
+  key<<" "<<m_scene_bounds.X.Min<<" "<<m_scene_bounds.X.Max
+     <<" "<<m_scene_bounds.Y.Min<<" "<<m_scene_bounds.Y.Max
+     <<" "<<m_scene_bounds.Z.Min<<" "<<m_scene_bounds.Z.Max;
+  for(int i = 0; i < 3; ++i)
+  {
+    key<<" "<<m_world_annotation_scale[i];
+  }
+  key<<" ";
+  detail::append_camera_key(key, m_camera);
+  return key.str();
+}
+
+vtkm::UInt64
+Render::GetFingerprint() const
+{
+  std::ostringstream key;
+  key<<std::hexfloat<<m_width<<" "<<m_height<<" "<<m_shading;
+  detail::append_color_key(key, m_bg_color);
+  detail::append_color_key(key, m_fg_color);
+  key<<" "<<m_scene_bounds.X.Min<<" "<<m_scene_bounds.X.Max
+     <<" "<<m_scene_bounds.Y.Min<<" "<<m_scene_bounds.Y.Max
+     <<" "<<m_scene_bounds.Z.Min<<" "<<m_scene_bounds.Z.Max<<" ";
+  detail::append_camera_key(key, m_camera);
+
+  Fingerprint fingerprint;
+  fingerprint.Add(key.str());
+  return fingerprint.GetValue();
+}
+
+std::string
+Render::ScreenLayerKey(const std::vector<std::string> &field_names,
+                       const std::vector<vtkm::Range> &ranges,
+                       const std::vector<vtkm::cont::ColorTable> &colors) const
+{
+  // the color bars, placed by the size of the image
+  Fingerprint bars;
+  for(size_t i = 0; i < field_names.size(); ++i)
+  {
+    bars.Add(field_names[i]);
+  }
+  for(size_t i = 0; i < ranges.size(); ++i)
+  {
+    bars.AddValue(ranges[i]);
+  }
+  for(size_t i = 0; i < colors.size(); ++i)
+  {
+    bars.AddColorTable(colors[i]);
+  }
+
+  std::ostringstream key;
+  key<<std::hexfloat<<"screen "<<m_width<<" "<<m_height;
+  detail::append_color_key(key, m_fg_color);
+  key<<" "<<bars.GetValue();
+  return key.str();
+}
+
+void
+Render::RenderWorldLayer(AnnotationLayer &layer)
+{
+  vtkmCanvas canvas(m_width, m_height);
+  canvas.SetBackgroundColor(vtkm::rendering::Color(0.f, 0.f, 0.f, 0.f));
+  canvas.SetForegroundColor(m_fg_color);
+  canvas.Clear();
+
+  Annotator annotator(canvas, m_camera, m_scene_bounds);
+  annotator.RenderWorldAnnotations(m_world_annotation_scale);
+  detail::canvas_to_layer(canvas, true, layer);
+}
+
+void
+Render::RenderScreenLayer(const std::vector<std::string> &field_names,
+                          const std::vector<vtkm::Range> &ranges,
+                          const std::vector<vtkm::cont::ColorTable> &colors,
+                          AnnotationLayer &layer)
+{
+  vtkmCanvas canvas(m_width, m_height);
+  canvas.SetBackgroundColor(vtkm::rendering::Color(0.f, 0.f, 0.f, 0.f));
+  canvas.SetForegroundColor(m_fg_color);
+  canvas.Clear();
+
+  Annotator annotator(canvas, m_camera, m_scene_bounds);
+  annotator.RenderScreenAnnotations(field_names, ranges, colors);
+  detail::canvas_to_layer(canvas, false, layer);
+}
+
+void
+Render::RenderAnnotations(const std::vector<std::string> &field_names,
+                          const std::vector<vtkm::Range> &ranges,
+                          const std::vector<vtkm::cont::ColorTable> &colors,
+                          AnnotationLayers &layers)
+{
+#ifdef VTKH_PARALLEL
+  if(vtkh::GetMPIRank() != 0) return;
+#endif
+  if(!m_render_annotations)
+  {
+    RenderBackground();
+    return;
+  }
+
+  if(!HasColorBytes())
+  {
+    CanvasColorsToBytes();
+  }
+  const int size = m_width * m_height;
+
+  if(m_camera.GetMode() == vtkm::rendering::Camera::MODE_3D)
+  {
+    const std::string key = WorldLayerKey();
+    auto layer = layers.find(key);
+    if(layer == layers.end())
+    {
+      layer = layers.insert(std::make_pair(key, AnnotationLayer())).first;
+      RenderWorldLayer(layer->second);
+    }
+    layer->second.m_used = true;
+    detail::blend_layer(&MutableColorBytes(true)[0],
+                        GetVTKMPointer(m_canvas.GetDepthBuffer()),
+                        layer->second,
+                        size);
+  }
+
+  RenderBackground();
+
+  // color bars are placed relative to the whole image
+  if(m_is_tile) return;
+
+  const std::string key = ScreenLayerKey(field_names, ranges, colors);
+  auto layer = layers.find(key);
+  if(layer == layers.end())
+  {
+    layer = layers.insert(std::make_pair(key, AnnotationLayer())).first;
+    RenderScreenLayer(field_names, ranges, colors, layer->second);
+  }
+  layer->second.m_used = true;
+  detail::blend_layer(&MutableColorBytes(true)[0], nullptr, layer->second, size);
+}
+
+void
+Render::SetTileHeight(const vtkm::Int32 rows)
+{
+  if(rows < 0)
+  {
+    throw Error("Render: tile height cannot be negative");
+  }
+  m_tile_height = rows;
+}
+
+vtkm::Int32
+Render::GetTileHeight() const
+{
+  return m_tile_height;
+}
+
+bool
+Render::IsTiled() const
+{
+  return m_tile_height > 0 && m_tile_height < m_height;
+}
+
+int
+Render::GetNumberOfTiles() const
+{
+  if(!IsTiled()) return 1;
+  return (m_height + m_tile_height - 1) / m_tile_height;
+}
+
+vtkm::Int32
+Render::GetTileStart(const int tile) const
+{
+  if(!IsTiled()) return 0;
+  return std::max(0, m_height - (tile + 1) * m_tile_height);
+}
+
+Render
+Render::MakeTile(const int tile) const
+{
+  if(tile < 0 || tile >= GetNumberOfTiles())
+  {
+    throw Error("Render: invalid tile " + std::to_string(tile));
+  }
+  if(m_camera.GetMode() != vtkm::rendering::Camera::MODE_3D)
+  {
+    throw Error("Render: tiled rendering needs a 3D camera");
+  }
+
+  const int start = GetTileStart(tile);
+  const int rows = m_height - tile * m_tile_height - start;
+
+  // Zoom and pan are applied to the normalized device coordinates
+  // after the projection, so scaling by the band height and moving
+  // the band center to the origin gives the band of the full
+  // image. The band has a wider aspect ratio, which shrinks x by
+  // the same scale.
+  const vtkm::Float32 scale = static_cast<vtkm::Float32>(m_height) / rows;
+  const vtkm::Float32 center = -1.f + (2.f * start + rows) / m_height;
+  vtkm::rendering::Camera camera = m_camera;
+  const vtkm::Float32 zoom = m_camera.GetZoom();
+  const vtkm::Vec2f_32 pan = m_camera.GetPan();
+  camera.SetZoom(zoom * scale);
+  camera.SetPan(pan[0] / scale, pan[1] - center / zoom);
+
+  // never allocate a canvas of the full image
+  Render res = CopySettings();
+  res.m_height = rows;
+  res.m_camera = camera;
+  res.m_tile_height = 0;
+  res.m_is_tile = true;
+  res.m_canvas = res.CreateCanvas();
+  return res;
+}
+
+void
+Render::SetColorBytes(std::vector<unsigned char> &rgba)
+{
+  if(rgba.size() != static_cast<size_t>(m_width) * m_height * 4)
+  {
+    throw Error("Render: color bytes do not match the image size");
+  }
+  MutableColorBytes(false).swap(rgba);
+}
+
+std::vector<unsigned char>&
+Render::MutableColorBytes(const bool keep)
+{
+  ColorBytes &bytes = *m_color_bytes;
+  if(bytes.use_count() > 1)
+  {
+    // the writer threads still have the bytes of a saved image
+    bytes = keep ? std::make_shared<std::vector<unsigned char>>(*bytes)
+                 : std::make_shared<std::vector<unsigned char>>();
+  }
+  return *bytes;
+}
+
+bool
+Render::HasColorBytes() const
+{
+  return !(*m_color_bytes)->empty();
+}
+
+const unsigned char*
+Render::GetColorBytes() const
+{
+  return HasColorBytes() ? &(**m_color_bytes)[0] : nullptr;
+}
+
+void
+Render::ClearColorBytes()
+{
+  MutableColorBytes(false).clear();
+}
+
+void
+Render::SyncCanvasColors()
+{
+  if(!HasColorBytes()) return;
+
+  const int size = m_width * m_height * 4;
+  const unsigned char *bytes = GetColorBytes();
+  float* color_buffer = &GetVTKMPointer(m_canvas.GetColorBuffer())[0][0];
+  const float one_over_255 = 1.f / 255.f;
+#ifdef VTKH_USE_OPENMP
+  #pragma omp parallel for
+#endif
+  for(int i = 0; i < size; ++i)
+  {
+    color_buffer[i] = static_cast<float>(bytes[i]) * one_over_255;
+  }
+  ClearColorBytes();
 }
 
 Render::vtkmCanvas
@@ -260,19 +737,138 @@ Render::CreateCanvas() const
 }
 
 void
-Render::Save()
+Render::Save(const bool wait)
 {
   // After rendering and compositing
   // Rank 0 contains the complete image.
 #ifdef VTKH_PARALLEL
   if(vtkh::GetMPIRank() != 0) return;
 #endif
-  float* color_buffer = &GetVTKMPointer(m_canvas.GetColorBuffer())[0][0];
-  int height = m_canvas.GetHeight();
-  int width = m_canvas.GetWidth();
-  PNGEncoder encoder;
-  encoder.Encode(color_buffer, width, height, m_comments);
-  encoder.Save(m_image_name + ".png");
+  const float* color_buffer = &GetVTKMPointer(m_canvas.GetColorBuffer())[0][0];
+  const int height = m_canvas.GetHeight();
+  const int width = m_canvas.GetWidth();
+  const int size = width * height * 4;
+
+  if(m_image_sink && !m_encode_sink)
+  {
+    // hand over the bytes or the canvas itself, never convert
+    RenderedImage image;
+    image.m_name = m_image_name;
+    image.m_width = width;
+    image.m_height = height;
+    image.m_rgba = HasColorBytes() ? nullptr : color_buffer;
+    image.m_rgba_bytes = GetColorBytes();
+    image.m_depths = GetVTKMPointer(m_canvas.GetDepthBuffer());
+    image.m_format = m_image_format;
+    image.m_encoded = nullptr;
+    image.m_encoded_size = 0;
+    m_image_sink(image);
+    return;
+  }
+
+  std::vector<float> depths;
+  if(!m_image_sink && m_image_format == IMAGE_RAW)
+  {
+    const float *depth_buffer = GetVTKMPointer(m_canvas.GetDepthBuffer());
+    depths.assign(depth_buffer, depth_buffer + width * height);
+  }
+
+  if(HasColorBytes())
+  {
+    // composited surfaces never went back to floats
+    if(m_image_sink)
+    {
+      SaveToSink(GetColorBytes());
+      return;
+    }
+    // the writer shares the bytes, the render copies
+    // them if it changes them before they are written
+    AsyncImageWriter::Instance()->Write(*m_color_bytes,
+                                        depths,
+                                        width,
+                                        height,
+                                        m_comments,
+                                        m_image_name,
+                                        m_image_format);
+  }
+  else
+  {
+    // only the byte conversion happens here, encoding and
+    // writing the file happen on the writer threads
+    std::vector<unsigned char> rgba(size);
+#ifdef VTKH_USE_OPENMP
+    #pragma omp parallel for
+#endif
+    for(int i = 0; i < size; ++i)
+    {
+      rgba[i] = static_cast<unsigned char>(color_buffer[i] * 255.f);
+    }
+
+    if(m_image_sink)
+    {
+      SaveToSink(&rgba[0]);
+      return;
+    }
+
+    AsyncImageWriter::Instance()->Write(rgba,
+                                        depths,
+                                        width,
+                                        height,
+                                        m_comments,
+                                        m_image_name,
+                                        m_image_format);
+  }
+
+  if(wait)
+  {
+    AsyncImageWriter::Instance()->Flush();
+  }
+}
+
+void
+Render::SaveToSink(const unsigned char *rgba)
+{
+  const int height = m_canvas.GetHeight();
+  const int width = m_canvas.GetWidth();
+
+  RenderedImage image;
+  image.m_name = m_image_name;
+  image.m_width = width;
+  image.m_height = height;
+  image.m_rgba = nullptr;
+  image.m_rgba_bytes = nullptr;
+  image.m_depths = nullptr;
+  image.m_format = m_image_format;
+
+  if(m_image_format == IMAGE_PNG)
+  {
+    PNGEncoder encoder;
+    encoder.Encode(rgba, width, height, m_comments);
+    image.m_encoded = static_cast<const unsigned char*>(encoder.PngBuffer());
+    image.m_encoded_size = encoder.PngBufferSize();
+    m_image_sink(image);
+  }
+  else if(m_image_format == IMAGE_QOI)
+  {
+    QOIEncoder encoder;
+    encoder.Encode(rgba, width, height);
+    image.m_encoded = encoder.Buffer();
+    image.m_encoded_size = encoder.BufferSize();
+    m_image_sink(image);
+  }
+  else
+  {
+    // raw images are the bytes followed by the depths
+    const float *depths = GetVTKMPointer(m_canvas.GetDepthBuffer());
+    const size_t color_bytes = static_cast<size_t>(width) * height * 4;
+    const size_t depth_bytes = static_cast<size_t>(width) * height * sizeof(float);
+    std::vector<unsigned char> raw(color_bytes + depth_bytes);
+    memcpy(&raw[0], rgba, color_bytes);
+    memcpy(&raw[color_bytes], depths, depth_bytes);
+    image.m_encoded = &raw[0];
+    image.m_encoded_size = raw.size();
+    m_image_sink(image);
+  }
 }
 
 vtkh::Render
@@ -1,16 +1,59 @@
 #ifndef VTK_H_RENDER_HPP
 #define VTK_H_RENDER_HPP
 
+#include <functional>
+#include <map>
+#include <memory>
 #include <vector>
 #include <vtkh/vtkh_exports.h>
 #include <vtkh/DataSet.hpp>
 #include <vtkh/Error.hpp>
+#include <vtkh/utils/AsyncImageWriter.hpp>
 
 #include <vtkm/rendering/Camera.h>
 #include <vtkm/rendering/CanvasRayTracer.h>
 #include <vtkm/rendering/Mapper.h>
 
 namespace vtkh {
+
+//
+// An image handed to an image sink instead of being written to a
+// file. Either the image (colors and depths, bottom row first) or
+// the encoded file bytes are set. Colors are the rgba bytes when
+// the render kept them as bytes, otherwise the canvas rgba floats,
+// and only one of the two is set. The pointers reference render,
+// canvas or encoder memory and are only valid during the call.
+//
+struct RenderedImage
+{
+  std::string           m_name;
+  int                   m_width;
+  int                   m_height;
+  const float          *m_rgba;
+  const unsigned char  *m_rgba_bytes;
+  const float          *m_depths;
+  ImageFormat           m_format;
+  const unsigned char  *m_encoded;
+  size_t                m_encoded_size;
+};
+
+typedef std::function<void(const RenderedImage &)> ImageSink;
+
+//
+// An annotation image that is rendered once and blended onto many
+// images. The colors are premultiplied rgba bytes. World layers also
+// keep their depths so that geometry in front of them hides them.
+//
+struct AnnotationLayer
+{
+  std::vector<unsigned char> m_rgba;
+  std::vector<float>         m_depths;
+  bool                       m_used;
+};
+
+// layers keyed by everything that changes their pixels
+typedef std::map<std::string, AnnotationLayer> AnnotationLayers;
+
 //
 // A Render contains the information needed to create a single image.
 // There are 'n' canvases that matches the number of domains in the
@@ -37,6 +80,7 @@ public:
   vtkm::Int32                     GetWidth() const;
   vtkm::rendering::Color          GetBackgroundColor() const;
   bool                            GetShadingOn() const;
+  ImageFormat                     GetImageFormat() const;
   void                            Print() const;
 
   void                            DoRenderAnnotations(bool on);
@@ -51,12 +95,59 @@ public:
   void                            SetBackgroundColor(float bg_color[4]);
   void                            SetForegroundColor(float fg_color[4]);
   void                            SetShadingOn(bool on);
+  // format used by Save. IMAGE_RAW also saves the depth buffer
+  void                            SetImageFormat(const ImageFormat format);
+  // Save delivers the image to the sink instead of writing a file.
+  // With encode, the sink gets the bytes of the image format
+  void                            SetImageSink(ImageSink sink, bool encode = false);
   void                            RenderWorldAnnotations();
   void                            RenderBackground();
   void                            RenderScreenAnnotations(const std::vector<std::string> &field_names,
                                                           const std::vector<vtkm::Range> &ranges,
                                                           const std::vector<vtkm::cont::ColorTable> &colors);
-  void                            Save();
+  // Same image as RenderWorldAnnotations, RenderScreenAnnotations
+  // and RenderBackground, but the annotations come from layers that
+  // are shared by every render with the same camera (world) or the
+  // same size and color bars (screen), and they are blended on the color bytes
+  void                            RenderAnnotations(const std::vector<std::string> &field_names,
+                                                    const std::vector<vtkm::Range> &ranges,
+                                                    const std::vector<vtkm::cont::ColorTable> &colors,
+                                                    AnnotationLayers &layers);
+  // Encodes and writes the image on the AsyncImageWriter threads.
+  // With wait, Save returns once the file is written. Scene passes
+  // false and flushes the writer once every image is queued
+  void                            Save(const bool wait = true);
+  // hash of the settings that change what the renderers draw
+  // (camera, size, colors and shading), annotations are not part
+  // of it. See Scene::SetTemporalReuse
+  vtkm::UInt64                    GetFingerprint() const;
+
+  // Renders the image in full width bands of at most 'rows' rows so
+  // that the canvases and compositing buffers only ever hold one
+  // band. Every band is rendered with its own camera and Scene
+  // streams the bands into the png file. 0 (the default) renders
+  // the whole image at once
+  void                            SetTileHeight(const vtkm::Int32 rows);
+  vtkm::Int32                     GetTileHeight() const;
+  bool                            IsTiled() const;
+  int                             GetNumberOfTiles() const;
+  // the render of one band, band 0 is the top of the image
+  Render                          MakeTile(const int tile) const;
+  // first canvas row (bottom row first) covered by the band
+  vtkm::Int32                     GetTileStart(const int tile) const;
+
+  // The composited colors of surfaces are kept as bytes so that
+  // saving does not convert them to floats and back. While bytes
+  // are set, the colors in the canvas are stale until
+  // SyncCanvasColors copies the bytes into it. Copies of a Render
+  // share the bytes like they share the canvas.
+  void                            SetColorBytes(std::vector<unsigned char> &rgba);
+  bool                            HasColorBytes() const;
+  const unsigned char*            GetColorBytes() const;
+  void                            SyncCanvasColors();
+  void                            ClearColorBytes();
+  // sets the color bytes from the canvas colors
+  void                            CanvasColorsToBytes();
 protected:
   vtkm::rendering::Camera      m_camera;
   std::string                  m_image_name;
@@ -67,11 +158,34 @@ protected:
   vtkm::rendering::Color       m_bg_color;
   vtkm::rendering::Color       m_fg_color;
   vtkmCanvas                   CreateCanvas() const;
+  // Copy without the canvas
+  Render                       CopySettings() const;
+  void                         SaveToSink(const unsigned char *rgba);
+  std::string                  WorldLayerKey() const;
+  std::string                  ScreenLayerKey(const std::vector<std::string> &field_names,
+                                              const std::vector<vtkm::Range> &ranges,
+                                              const std::vector<vtkm::cont::ColorTable> &colors) const;
+  void                         RenderWorldLayer(AnnotationLayer &layer);
+  void                         RenderScreenLayer(const std::vector<std::string> &field_names,
+                                                 const std::vector<vtkm::Range> &ranges,
+                                                 const std::vector<vtkm::cont::ColorTable> &colors,
+                                                 AnnotationLayer &layer);
   bool                         m_render_annotations;
   bool                         m_render_background;
   bool                         m_shading;
+  ImageFormat                  m_image_format;
+  ImageSink                    m_image_sink;
+  bool                         m_encode_sink;
   vtkmCanvas                   m_canvas;
+  // Copies of the render share the bytes. Saving shares them with
+  // the writer threads too, so they are replaced instead of changed
+  // while the writer still has them
+  typedef std::shared_ptr<std::vector<unsigned char>> ColorBytes;
+  std::shared_ptr<ColorBytes>  m_color_bytes;
+  std::vector<unsigned char>&  MutableColorBytes(const bool keep);
   vtkm::Vec<float,3>           m_world_annotation_scale;
+  vtkm::Int32                  m_tile_height;
+  bool                         m_is_tile;
 };
 
 static float vtkh_default_bg_color[4] = {0.f, 0.f, 0.f, 1.f};
@@ -1,10 +1,12 @@
 #include "Renderer.hpp"
 #include <vtkh/compositing/Compositor.hpp>
+#include <vtkh/rendering/Fingerprint.hpp>
 
 #include <vtkh/Logger.hpp>
 #include <vtkh/utils/vtkm_array_utils.hpp>
 #include <vtkh/utils/vtkm_dataset_info.hpp>
 #include <vtkm/rendering/raytracing/Logger.h>
+#include <vtkm/Matrix.h>
 
 namespace vtkh {
 
@@ -12,7 +14,9 @@ Renderer::Renderer()
   : m_do_composite(true),
     m_color_table("Cool to Warm"),
     m_field_index(0),
-    m_has_color_table(true)
+    m_has_color_table(true),
+    m_domain_culling(true),
+    m_blend_composite(false)
 {
   m_compositor  = new Compositor();
 }
@@ -36,6 +40,30 @@ void Renderer::DisableColorBar()
   m_has_color_table = false;
 }
 
+void
+Renderer::SetDomainCulling(bool on)
+{
+  m_domain_culling = on;
+}
+
+void
+Renderer::SetBlendComposite(bool on)
+{
+  m_blend_composite = on;
+}
+
+bool
+Renderer::GetBlendComposite() const
+{
+  return m_blend_composite;
+}
+
+bool
+Renderer::GetDomainCulling() const
+{
+  return m_domain_culling;
+}
+
 void
 Renderer::SetField(const std::string field_name)
 {
@@ -70,6 +98,11 @@ void
 Renderer::SetRenders(const std::vector<vtkh::Render> &renders)
 {
   m_renders = renders;
+  // renderers draw on top of the canvas colors
+  for(auto &render : m_renders)
+  {
+    render.SyncCanvasColors();
+  }
 }
 
 int
@@ -98,7 +131,8 @@ void
 Renderer::Composite(const int &num_images)
 {
   VTKH_DATA_OPEN("Composite");
-  m_compositor->SetCompositeMode(Compositor::Z_BUFFER_SURFACE);
+  m_compositor->SetCompositeMode(m_blend_composite ? Compositor::NEAREST_SURFACE_BLEND
+                                                  : Compositor::Z_BUFFER_SURFACE);
   for(int i = 0; i < num_images; ++i)
   {
     float* color_buffer = &GetVTKMPointer(m_renders[i].GetCanvas().GetColorBuffer())[0][0];
@@ -117,10 +151,10 @@ Renderer::Composite(const int &num_images)
 #ifdef VTKH_PARALLEL
     if(vtkh::GetMPIRank() == 0)
     {
-      ImageToCanvas(result, m_renders[i].GetCanvas(), true);
+      ImageToRender(result, m_renders[i]);
     }
 #else
-    ImageToCanvas(result, m_renders[i].GetCanvas(), true);
+    ImageToRender(result, m_renders[i]);
 #endif
     m_compositor->ClearImages();
   } // for image
@@ -200,6 +234,13 @@ Renderer::DoExecute()
 
   int total_renders = static_cast<int>(m_renders.size());
 
+  // the color table does not change between domains or cameras
+  m_mapper->SetActiveColorTable(m_color_table);
+
+  // culling counts are per domain and camera
+  long long int culled_domains = 0;
+  long long int culled_cells = 0;
+
   int num_domains = static_cast<int>(m_input->GetNumberOfDomains());
   for(int dom = 0; dom < num_domains; ++dom)
   {
@@ -220,8 +261,30 @@ Renderer::DoExecute()
       continue;
     }
 
+    vtkm::Bounds bounds = coords.GetBounds();
+    const vtkm::Float64 pad = GetCullingPad();
+    if(pad > 0. && bounds.IsNonEmpty())
+    {
+      bounds.Include(vtkm::Vec<vtkm::Float64,3>(bounds.X.Min - pad,
+                                                bounds.Y.Min - pad,
+                                                bounds.Z.Min - pad));
+      bounds.Include(vtkm::Vec<vtkm::Float64,3>(bounds.X.Max + pad,
+                                                bounds.Y.Max + pad,
+                                                bounds.Z.Max + pad));
+    }
+
     for(int i = 0; i < total_renders; ++i)
     {
+      Render::vtkmCanvas &canvas = m_renders[i].GetCanvas();
+      const vtkmCamera &camera = m_renders[i].GetCamera();
+
+      if(CullDomain(camera, bounds, canvas.GetWidth(), canvas.GetHeight()))
+      {
+        culled_domains++;
+        culled_cells += cellset.GetNumberOfCells();
+        continue;
+      }
+
       if(m_renders[i].GetShadingOn())
       {
         this->SetShadingOn(true);
@@ -231,10 +294,6 @@ Renderer::DoExecute()
         this->SetShadingOn(false);
       }
 
-      m_mapper->SetActiveColorTable(m_color_table);
-
-      Render::vtkmCanvas &canvas = m_renders[i].GetCanvas();
-      const vtkmCamera &camera = m_renders[i].GetCamera();
       m_mapper->SetCanvas(&canvas);
       m_mapper->RenderCells(cellset,
                             coords,
@@ -245,7 +304,102 @@ Renderer::DoExecute()
     }
   }
 
+  VTKH_DATA_ADD("culled_domains", culled_domains);
+  VTKH_DATA_ADD("culled_cells", culled_cells);
+}
+
+vtkm::Float64
+Renderer::GetCullingPad() const
+{
+  return 0.;
+}
+
+bool
+Renderer::CullDomain(const vtkmCamera &camera,
+                     const vtkm::Bounds &bounds,
+                     const int width,
+                     const int height) const
+{
+  if(!m_domain_culling || !bounds.IsNonEmpty())
+  {
+    return false;
+  }
+
+  vtkm::Matrix<vtkm::Float32, 4, 4> projview =
+    vtkm::MatrixMultiply(camera.CreateProjectionMatrix(width, height),
+                         camera.CreateViewMatrix());
+
+  // count the corners outside of each side of the view frustum
+  // (left, right, bottom, top, behind the camera). We don't test
+  // the near and far planes since rays are not clipped by them.
+  int outside[5] = {0, 0, 0, 0, 0};
+  bool all_in_front = true;
+  vtkm::Float32 screen_min[2] = {vtkm::Infinity32(), vtkm::Infinity32()};
+  vtkm::Float32 screen_max[2] = {vtkm::NegativeInfinity32(), vtkm::NegativeInfinity32()};
+
+  for(int c = 0; c < 8; ++c)
+  {
+    vtkm::Vec4f_32 corner;
+    corner[0] = static_cast<vtkm::Float32>((c & 1) ? bounds.X.Max : bounds.X.Min);
+    corner[1] = static_cast<vtkm::Float32>((c & 2) ? bounds.Y.Max : bounds.Y.Min);
+    corner[2] = static_cast<vtkm::Float32>((c & 4) ? bounds.Z.Max : bounds.Z.Min);
+    corner[3] = 1.f;
+
+    vtkm::Vec4f_32 p = vtkm::MatrixMultiply(projview, corner);
+    const vtkm::Float32 w = p[3];
+    if(p[0] < -w) outside[0]++;
+    if(p[0] >  w) outside[1]++;
+    if(p[1] < -w) outside[2]++;
+    if(p[1] >  w) outside[3]++;
+    if(w <= 0.f)
+    {
+      outside[4]++;
+      all_in_front = false;
+      continue;
+    }
+
+    for(int d = 0; d < 2; ++d)
+    {
+      const vtkm::Float32 ndc = p[d] / w;
+      screen_min[d] = vtkm::Min(screen_min[d], ndc);
+      screen_max[d] = vtkm::Max(screen_max[d], ndc);
+    }
+  }
+
+  for(int i = 0; i < 5; ++i)
+  {
+    if(outside[i] == 8)
+    {
+      return true;
+    }
+  }
 
+  if(!all_in_front)
+  {
+    // we can't reason about the screen coverage when
+    // part of the domain is behind the camera
+    return false;
+  }
+
+  //
+  // Screen coverage: camera rays pass through integer screen
+  // coordinates, so if the projected bounds don't contain one
+  // in either direction, no ray can hit the domain. The small
+  // pad keeps us conservative w.r.t. round off.
+  //
+  const vtkm::Float32 pad = 0.01f;
+  const int dims[2] = {width, height};
+  for(int d = 0; d < 2; ++d)
+  {
+    const vtkm::Float32 min_pixel = (screen_min[d] + 1.f) * 0.5f * dims[d] - pad;
+    const vtkm::Float32 max_pixel = (screen_max[d] + 1.f) * 0.5f * dims[d] + pad;
+    if(vtkm::Ceil(min_pixel) > vtkm::Floor(max_pixel))
+    {
+      return true;
+    }
+  }
+
+  return false;
 }
 
 void
@@ -269,6 +423,65 @@ Renderer::ImageToCanvas(Image &image, vtkm::rendering::Canvas &canvas, bool get_
   if(get_depth) memcpy(depth_buffer, &image.m_depths[0], sizeof(float) * size);
 }
 
+void
+Renderer::ImageToRender(Image &image, Render &render)
+{
+  // the colors stay bytes until something needs the canvas colors
+  vtkm::rendering::Canvas &canvas = render.GetCanvas();
+  const int size = canvas.GetWidth() * canvas.GetHeight();
+  float* depth_buffer = GetVTKMPointer(canvas.GetDepthBuffer());
+  memcpy(depth_buffer, &image.m_depths[0], sizeof(float) * size);
+  render.SetColorBytes(image.m_pixels);
+}
+
+vtkm::UInt64
+Renderer::GetFingerprint()
+{
+  if(m_input == nullptr)
+  {
+    throw Error("Renderer: cannot fingerprint a renderer without input");
+  }
+
+  Fingerprint fingerprint;
+  fingerprint.Add(GetName());
+  fingerprint.Add(m_field_name);
+  fingerprint.AddValue(m_range);
+  fingerprint.AddColorTable(m_color_table);
+  fingerprint.AddValue(m_domain_culling);
+  fingerprint.AddValue(m_blend_composite);
+
+  const int num_domains = static_cast<int>(m_input->GetNumberOfDomains());
+  fingerprint.AddValue(num_domains);
+  m_domain_identities.resize(num_domains);
+  m_domain_fingerprints.resize(num_domains);
+  for(int dom = 0; dom < num_domains; ++dom)
+  {
+    vtkm::cont::DataSet data_set;
+    vtkm::Id domain_id;
+    m_input->GetDomain(dom, data_set, domain_id);
+    fingerprint.AddValue(domain_id);
+
+    // only hash the values of arrays we have not seen
+    if(!m_domain_identities[dom].IsSame(data_set, m_field_name))
+    {
+      Fingerprint domain;
+      domain.AddDataSet(data_set, m_field_name);
+      m_domain_fingerprints[dom] = domain.GetValue();
+      m_domain_identities[dom].Set(data_set, m_field_name);
+    }
+    fingerprint.AddValue(m_domain_fingerprints[dom]);
+  }
+
+  AddToFingerprint(fingerprint);
+  return fingerprint.GetValue();
+}
+
+void
+Renderer::AddToFingerprint(Fingerprint &fingerprint) const
+{
+  // no settings beyond the ones of every renderer
+}
+
 std::vector<Render>
 Renderer::GetRenders() const
 {
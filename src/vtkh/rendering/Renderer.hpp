@@ -5,6 +5,7 @@
 #include <vtkh/vtkh_exports.h>
 #include <vtkh/Error.hpp>
 #include <vtkh/filters/Filter.hpp>
+#include <vtkh/rendering/Fingerprint.hpp>
 #include <vtkh/rendering/Render.hpp>
 #include <vtkh/compositing/Image.hpp>
 
@@ -37,6 +38,14 @@ public:
   void SetRenders(const std::vector<Render> &renders);
   void SetRange(const vtkm::Range &range);
   void DisableColorBar();
+  // skip domains that are outside the view or cover no pixels
+  void SetDomainCulling(bool on);
+  // composite with NEAREST_SURFACE_BLEND so that translucent
+  // surfaces of different ranks are blended in depth order instead
+  // of the closest one winning. Each rank only contributes the
+  // nearest surface of every pixel, the surfaces behind it on the
+  // same rank are not seen
+  void SetBlendComposite(bool on);
 
   vtkm::cont::ColorTable      GetColorTable() const;
   std::string                 GetFieldName() const;
@@ -45,6 +54,12 @@ public:
   vtkh::DataSet              *GetInput();
   vtkm::Range                 GetRange() const;
   bool                        GetHasColorTable() const;
+  bool                        GetDomainCulling() const;
+  bool                        GetBlendComposite() const;
+  // hash of the input data and of every setting that changes
+  // the image of the plot, see Scene::SetTemporalReuse. Domains
+  // that still use the arrays of the last call are not hashed again
+  vtkm::UInt64                GetFingerprint();
 protected:
 
   // image related data with cinema support
@@ -58,13 +73,31 @@ protected:
   vtkm::Range                              m_range;
   vtkm::cont::ColorTable                   m_color_table;
   bool                                     m_has_color_table;
+  bool                                     m_domain_culling;
+  bool                                     m_blend_composite;
+  // the arrays each domain was last hashed from, and its hash
+  std::vector<DataSetIdentity>             m_domain_identities;
+  std::vector<vtkm::UInt64>                m_domain_fingerprints;
   // methods
   virtual void PreExecute() override;
   virtual void PostExecute() override;
   virtual void DoExecute() override;
 
   virtual void Composite(const int &num_images);
+  // adds the settings of the renderer to its fingerprint
+  virtual void AddToFingerprint(Fingerprint &fingerprint) const;
   void ImageToCanvas(Image &image, vtkm::rendering::Canvas &canvas, bool get_depth);
+  // copies the depths and hands the pixels to the render as bytes
+  void ImageToRender(Image &image, Render &render);
+  // distance the geometry can extend past the coordinate bounds
+  // (e.g. the radius of spheres and cylinders), culling pads the
+  // bounds of a domain by it
+  virtual vtkm::Float64 GetCullingPad() const;
+  // returns true if the bounds are not visible to the camera
+  bool CullDomain(const vtkmCamera &camera,
+                  const vtkm::Bounds &bounds,
+                  const int width,
+                  const int height) const;
 };
 
 } // namespace vtkh
@@ -4,6 +4,7 @@
 #include <vtkh/vtkh.hpp>
 
 #include <vtkh/Logger.hpp>
+#include <vtkh/utils/HalfFloat.hpp>
 #include <vtkh/utils/vtkm_array_utils.hpp>
 #include <vtkh/utils/vtkm_dataset_info.hpp>
 #include <vtkm/rendering/raytracing/Logger.h>
@@ -13,14 +14,30 @@
   #include <mpi.h>
 #endif
 #include <assert.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
 
 namespace vtkh
 {
 
 namespace detail
 {
+bool is_scalar_field(const vtkm::cont::Field &field)
+{
+  return field.GetData().GetNumberOfComponentsFlat() == 1 &&
+         (field.GetData().IsValueType<vtkm::Float32>() ||
+          field.GetData().IsValueType<vtkm::Float64>());
+}
+
+//
+// Keeps the scalar fields of the data set. If field names are
+// given, only those fields are kept, in the order given.
+//
 vtkm::cont::DataSet
-filter_scalar_fields(vtkm::cont::DataSet &dataset)
+filter_scalar_fields(vtkm::cont::DataSet &dataset,
+                     const std::vector<std::string> &field_names)
 {
   vtkm::cont::DataSet res;
   const vtkm::Id num_coords = dataset.GetNumberOfCoordinateSystems();
@@ -30,17 +47,32 @@ filter_scalar_fields(vtkm::cont::DataSet &dataset)
   }
   res.SetCellSet(dataset.GetCellSet());
 
+  if(field_names.size() != 0)
+  {
+    for(size_t i = 0; i < field_names.size(); ++i)
+    {
+      if(!dataset.HasField(field_names[i]))
+      {
+        continue;
+      }
+      vtkm::cont::Field field = dataset.GetField(field_names[i]);
+      if(!is_scalar_field(field))
+      {
+        throw Error("ScalarRenderer: field '" + field_names[i] +
+                    "' must be a Float32 or Float64 scalar field");
+      }
+      res.AddField(field);
+    }
+    return res;
+  }
+
   const vtkm::Id num_fields = dataset.GetNumberOfFields();
   for(vtkm::Id i = 0; i < num_fields; ++i)
   {
     vtkm::cont::Field field = dataset.GetField(i);
-    if(field.GetData().GetNumberOfComponentsFlat() == 1)
+    if(is_scalar_field(field))
     {
-      if(field.GetData().IsValueType<vtkm::Float32>() ||
-         field.GetData().IsValueType<vtkm::Float64>())
-      {
-        res.AddField(field);
-      }
+      res.AddField(field);
     }
   }
 
@@ -52,7 +84,9 @@ filter_scalar_fields(vtkm::cont::DataSet &dataset)
 
 ScalarRenderer::ScalarRenderer()
   : m_width(1024),
-    m_height(1024)
+    m_height(1024),
+    m_batch_size(10),
+    m_half_payload(false)
 {
 }
 
@@ -69,12 +103,69 @@ ScalarRenderer::GetName() const
 void
 ScalarRenderer::SetCamera(vtkmCamera &camera)
 {
-  m_camera = camera;
+  m_cameras.clear();
+  m_cameras.push_back(camera);
+}
+
+void
+ScalarRenderer::AddCamera(vtkmCamera &camera)
+{
+  m_cameras.push_back(camera);
+}
+
+void
+ScalarRenderer::SetCameras(const std::vector<vtkmCamera> &cameras)
+{
+  m_cameras = cameras;
+}
+
+void
+ScalarRenderer::ClearCameras()
+{
+  m_cameras.clear();
+}
+
+int
+ScalarRenderer::GetNumberOfCameras() const
+{
+  return static_cast<int>(m_cameras.size());
+}
+
+void
+ScalarRenderer::SetBatchSize(const int batch_size)
+{
+  if(batch_size < 1)
+  {
+    throw Error("ScalarRenderer: batch size must be greater than 0");
+  }
+  m_batch_size = batch_size;
+}
+
+void
+ScalarRenderer::AddField(const std::string &field_name)
+{
+  m_field_names.push_back(field_name);
+}
+
+void
+ScalarRenderer::ClearFields()
+{
+  m_field_names.clear();
+}
+
+void
+ScalarRenderer::SetHalfPrecisionPayload(bool on)
+{
+  m_half_payload = on;
 }
 
 void
 ScalarRenderer::PreExecute()
 {
+  for(size_t i = 0; i < m_field_names.size(); ++i)
+  {
+    Filter::CheckForRequiredField(m_field_names[i]);
+  }
 }
 
 void
@@ -100,6 +191,11 @@ ScalarRenderer::PostExecute()
 void
 ScalarRenderer::DoExecute()
 {
+  const int num_cameras = static_cast<int>(m_cameras.size());
+  if(num_cameras == 0)
+  {
+    throw Error("ScalarRenderer: no cameras were set");
+  }
 
   int num_domains = static_cast<int>(m_input->GetNumberOfDomains());
   this->m_output = new DataSet();
@@ -111,64 +207,25 @@ ScalarRenderer::DoExecute()
   // We could be processing AMR patches, numbering
   // in the 1000s, and with 100 images * 1000s amr
   // patches we could blow memory. We will set the input
-  // once and composite after every image (todo: batch images
-  // in groups of X).
+  // once and composite after every batch of images.
   //
   std::vector<vtkm::rendering::ScalarRenderer> renderers;
   std::vector<vtkm::Id> cell_counts;
   renderers.resize(num_domains);
   cell_counts.resize(num_domains);
+  long long int num_cells = 0;
   for(int dom = 0; dom < num_domains; ++dom)
   {
     vtkm::cont::DataSet data_set;
     vtkm::Id domain_id;
     m_input->GetDomain(dom, data_set, domain_id);
-    vtkm::cont::DataSet filtered = detail::filter_scalar_fields(data_set);
+    vtkm::cont::DataSet filtered = detail::filter_scalar_fields(data_set, m_field_names);
     renderers[dom].SetInput(filtered);
     renderers[dom].SetWidth(m_width);
     renderers[dom].SetHeight(m_height);
 
-    // all the data sets better be the same
-    cell_counts.push_back(data_set.GetCellSet().GetNumberOfCells());
-  }
-
-  // basic sanity checking
-  int min_p = std::numeric_limits<int>::max();
-  int max_p = std::numeric_limits<int>::min();
-  bool do_once = true;
-
-  std::vector<std::string> field_names;
-  PayloadCompositor compositor;
-
-  int num_cells = 0;
-
-  //Bounds needed for parallel execution
-  float bounds[6] = {0.f, 0.f, 0.f, 0.f, 0.f, 0.f};;
-  for(int dom = 0; dom < num_domains; ++dom)
-  {
-    vtkm::cont::DataSet data_set;
-    vtkm::Id domain_id;
-    m_input->GetDomain(dom, data_set, domain_id);
-    num_cells = data_set.GetCellSet().GetNumberOfCells();
-
-    if(data_set.GetCellSet().GetNumberOfCells())
-    {
-
-      Result res = renderers[dom].Render(m_camera);
-
-      field_names = res.ScalarNames;
-      PayloadImage *pimage = Convert(res);
-      min_p = std::min(min_p, pimage->m_payload_bytes);
-      max_p = std::max(max_p, pimage->m_payload_bytes);
-      compositor.AddImage(*pimage);
-      bounds[0] = pimage->m_bounds.X.Min;
-      bounds[1] = pimage->m_bounds.X.Max;
-      bounds[2] = pimage->m_bounds.Y.Min;
-      bounds[3] = pimage->m_bounds.Y.Max;
-      bounds[4] = pimage->m_bounds.Z.Min;
-      bounds[5] = pimage->m_bounds.Z.Max;
-      delete pimage;
-    }
+    cell_counts[dom] = data_set.GetCellSet().GetNumberOfCells();
+    num_cells += cell_counts[dom];
   }
 
   // make no assumptions
@@ -182,6 +239,8 @@ ScalarRenderer::DoExecute()
   int vote = num_cells > 0 ? 1 : 0;
   votes.resize(comm_size);
 
+  // the ranks with data don't change between cameras,
+  // so we only need to vote once
   MPI_Allgather(&vote, 1, MPI_INT, &votes[0], 1, MPI_INT, mpi_comm);
   int winner = -1;
   for(int i = 0; i < comm_size; ++i)
@@ -192,44 +251,95 @@ ScalarRenderer::DoExecute()
       break;
     }
   }
+  no_data = winner == -1;
+#endif
 
-  if(winner != -1)
+  if(no_data)
   {
-    MPI_Bcast(bounds, 6, MPI_FLOAT, winner, mpi_comm);
-    MPI_Bcast(&max_p, 1, MPI_INT, winner, mpi_comm);
-    MPI_Bcast(&min_p, 1, MPI_INT, winner, mpi_comm);
-    no_data = false;
+    return;
   }
-#endif
 
-  if(!no_data)
+  VTKH_DATA_ADD("cameras", num_cameras);
+  //
+  // Render the cameras in batches. Each domain renders every
+  // camera of the batch before we move on to the next domain,
+  // and a batch keeps one locally composited image per camera.
+  //
+  for(int batch_begin = 0; batch_begin < num_cameras; batch_begin += m_batch_size)
   {
-    if(num_cells == 0)
+    const int batch_end = std::min(batch_begin + m_batch_size, num_cameras);
+    const int batch_size = batch_end - batch_begin;
+
+    // basic sanity checking
+    int min_p = std::numeric_limits<int>::max();
+    int max_p = std::numeric_limits<int>::min();
+
+    std::vector<std::string> field_names;
+    std::vector<PayloadCompositor> compositors(batch_size);
+
+    //Bounds needed for parallel execution
+    float bounds[6] = {0.f, 0.f, 0.f, 0.f, 0.f, 0.f};
+    for(int dom = 0; dom < num_domains; ++dom)
     {
-      vtkm::Bounds b(bounds);
-      PayloadImage p(b, max_p);
-      int size = p.m_depths.size();
-      float depths[size];
-      for(int i = 0; i < size; i++)
-        depths[i] = std::numeric_limits<int>::max();
-      std::copy(depths, depths + size, &p.m_depths[0]);
-      compositor.AddImage(p);
+      if(cell_counts[dom] == 0)
+      {
+        continue;
+      }
+
+      for(int c = batch_begin; c < batch_end; ++c)
+      {
+        Result res = renderers[dom].Render(m_cameras[c]);
+
+        field_names = res.ScalarNames;
+        PayloadImage *pimage = Convert(res);
+        min_p = std::min(min_p, pimage->m_payload_bytes);
+        max_p = std::max(max_p, pimage->m_payload_bytes);
+        compositors[c - batch_begin].AddImage(*pimage);
+        bounds[0] = pimage->m_bounds.X.Min;
+        bounds[1] = pimage->m_bounds.X.Max;
+        bounds[2] = pimage->m_bounds.Y.Min;
+        bounds[3] = pimage->m_bounds.Y.Max;
+        bounds[4] = pimage->m_bounds.Z.Min;
+        bounds[5] = pimage->m_bounds.Z.Max;
+        delete pimage;
+      }
     }
 
+#ifdef VTKH_PARALLEL
+    MPI_Bcast(bounds, 6, MPI_FLOAT, winner, mpi_comm);
+    MPI_Bcast(&max_p, 1, MPI_INT, winner, mpi_comm);
+    MPI_Bcast(&min_p, 1, MPI_INT, winner, mpi_comm);
+#endif
+
     if(min_p != max_p)
     {
       throw Error("Scalar Renderer: mismatch in payload bytes");
     }
 
-    PayloadImage final_image = compositor.Composite();
-    if(vtkh::GetMPIRank() == 0)
+    for(int c = batch_begin; c < batch_end; ++c)
     {
-      Result final_result = Convert(final_image, field_names);
-      if(final_result.Scalars.size() != 0)
+      PayloadCompositor &compositor = compositors[c - batch_begin];
+      if(num_cells == 0)
+      {
+        vtkm::Bounds b(bounds);
+        PayloadImage p(b, max_p);
+        std::fill(p.m_depths.begin(),
+                  p.m_depths.end(),
+                  static_cast<float>(std::numeric_limits<int>::max()));
+        compositor.AddImage(p);
+      }
+
+      PayloadImage final_image = compositor.Composite();
+      if(vtkh::GetMPIRank() == 0)
       {
-        vtkm::cont::DataSet dset = final_result.ToDataSet();
-        const int domain_id = 0;
-        this->m_output->AddDomain(dset, domain_id);
+        Result final_result = Convert(final_image, field_names);
+        if(final_result.Scalars.size() != 0)
+        {
+          vtkm::cont::DataSet dset = final_result.ToDataSet();
+          // one domain per camera
+          const int domain_id = c;
+          this->m_output->AddDomain(dset, domain_id);
+        }
       }
     }
   }
@@ -262,13 +372,26 @@ ScalarRenderer::Convert(PayloadImage &image, std::vector<std::string> &names)
 
   const unsigned char *loads = &image.m_payloads[0];
   const size_t payload_size = image.m_payload_bytes;
+  const size_t value_size = m_half_payload ? sizeof(std::uint16_t) : sizeof(float);
 
-  for(size_t x = 0; x < size; ++x)
+#ifdef VTKH_USE_OPENMP
+    #pragma omp parallel for
+#endif
+  for(int x = 0; x < size; ++x)
   {
+    const unsigned char *load = loads + x * payload_size;
     for(int i = 0; i < num_fields; ++i)
     {
-      const size_t offset = x * payload_size + i * sizeof(float);
-      memcpy(&buffers[i][x], loads + offset, sizeof(float));
+      if(m_half_payload)
+      {
+        std::uint16_t half;
+        memcpy(&half, load + i * value_size, value_size);
+        buffers[i][x] = HalfToFloat(half);
+      }
+      else
+      {
+        memcpy(&buffers[i][x], load + i * value_size, value_size);
+      }
     }
   }
 
@@ -283,7 +406,8 @@ ScalarRenderer::Convert(PayloadImage &image, std::vector<std::string> &names)
 PayloadImage * ScalarRenderer::Convert(Result &result)
 {
   const int num_fields = result.Scalars.size();
-  const int payload_size = num_fields * sizeof(float);
+  const size_t value_size = m_half_payload ? sizeof(std::uint16_t) : sizeof(float);
+  const int payload_size = num_fields * value_size;
   vtkm::Bounds bounds;
   bounds.X.Min = 1;
   bounds.Y.Min = 1;
@@ -310,10 +434,18 @@ PayloadImage * ScalarRenderer::Convert(Result &result)
 #endif
   for(size_t x = 0; x < size; ++x)
   {
+    unsigned char *load = loads + x * payload_size;
     for(int i = 0; i < num_fields; ++i)
     {
-      const size_t offset = x * payload_size + i * sizeof(float);
-      memcpy(loads + offset, &buffers[i][x], sizeof(float));
+      if(m_half_payload)
+      {
+        const std::uint16_t half = FloatToHalf(buffers[i][x]);
+        memcpy(load + i * value_size, &half, value_size);
+      }
+      else
+      {
+        memcpy(load + i * value_size, &buffers[i][x], value_size);
+      }
     }
   }
   return image;
@@ -24,7 +24,22 @@ public:
   virtual void Update();
   virtual std::string GetName() const override;
 
+  // replaces all cameras with this one
   void SetCamera(vtkmCamera &camera);
+  void AddCamera(vtkmCamera &camera);
+  void SetCameras(const std::vector<vtkmCamera> &cameras);
+  void ClearCameras();
+  // number of cameras that are rendered and composited
+  // together. Each camera of a batch holds an image in
+  // memory. Defaults to 10
+  void SetBatchSize(const int batch_size);
+  // only render and composite these fields. By default,
+  // all Float32 and Float64 scalar fields are used
+  void AddField(const std::string &field_name);
+  void ClearFields();
+  // composite the fields as half precision floats, which
+  // halves the payload of every pixel
+  void SetHalfPrecisionPayload(bool on);
 
   int GetNumberOfCameras() const;
   vtkh::DataSet *GetInput();
@@ -34,8 +49,12 @@ protected:
 
   int m_width;
   int m_height;
-  // image related data with cinema support
-  vtkmCamera  m_camera;
+  int m_batch_size;
+  bool m_half_payload;
+  std::vector<std::string> m_field_names;
+  // image related data with cinema support. The output
+  // has one domain per camera, in camera order
+  std::vector<vtkmCamera> m_cameras;
   // methods
   virtual void PreExecute() override;
   virtual void PostExecute() override;
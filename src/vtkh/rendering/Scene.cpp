@@ -1,8 +1,15 @@
 #include <vtkh/rendering/Scene.hpp>
+#include <vtkh/Logger.hpp>
+#include <vtkh/rendering/Fingerprint.hpp>
+#include <vtkh/rendering/ImageDatabase.hpp>
 #include <vtkh/rendering/MeshRenderer.hpp>
 #include <vtkh/rendering/VolumeRenderer.hpp>
+#include <vtkh/utils/AsyncImageWriter.hpp>
+#include <vtkh/utils/PNGEncoder.hpp>
 #include <vtkh/utils/vtkm_array_utils.hpp>
 
+#include <string.h>
+
 #ifdef VTKH_PARALLEL
 #include <mpi.h>
 #endif
@@ -12,7 +19,12 @@ namespace vtkh
 
 Scene::Scene()
   : m_has_volume(false),
-    m_batch_size(10)
+    m_batch_size(10),
+    m_database_depth(false),
+    m_encode_sink(false),
+    m_temporal_reuse(false),
+    m_opaque_fingerprint(0),
+    m_volume_fingerprint(0)
 {
 
 }
@@ -38,6 +50,36 @@ Scene::GetRenderBatchSize() const
   return m_batch_size;
 }
 
+void
+Scene::SetImageDatabase(const std::string &file_name, bool save_depth)
+{
+  m_database_name = file_name;
+  m_database_depth = save_depth;
+}
+
+void
+Scene::SetImageSink(ImageSink sink, bool encode)
+{
+  m_image_sink = sink;
+  m_encode_sink = encode;
+}
+
+void
+Scene::SetTemporalReuse(bool on)
+{
+  m_temporal_reuse = on;
+  if(!on)
+  {
+    m_cached_images.clear();
+  }
+}
+
+bool
+Scene::GetTemporalReuse() const
+{
+  return m_temporal_reuse;
+}
+
 void
 Scene::AddRender(vtkh::Render &render)
 {
@@ -138,107 +180,490 @@ Scene::Render()
   // are limited.
   //
   const int render_size = m_renders.size();
-  int batch_start = 0;
-  while(batch_start < render_size)
-  {
-    int batch_end = std::min(m_batch_size + batch_start, render_size);
-    auto begin = m_renders.begin() + batch_start;
-    auto end = m_renders.begin() + batch_end;
 
-    std::vector<vtkh::Render> current_batch(begin, end);
+  // complete images only exist on rank 0
+  bool is_root = true;
+#ifdef VTKH_PARALLEL
+  is_root = vtkh::GetMPIRank() == 0;
+#endif
+
+  // tiled images are rendered one band at a time after the others
+  std::vector<int> images;
+  std::vector<int> tiled_images;
+  for(int i = 0; i < render_size; ++i)
+  {
+    if(m_renders[i].IsTiled())
+    {
+      if(m_database_name.empty() &&
+         (m_image_sink || m_renders[i].GetImageFormat() != IMAGE_PNG))
+      {
+        throw Error("Scene: tiled images can only be saved as png files "
+                    "or into an image database");
+      }
+      if(m_renders[i].GetCamera().GetMode() !=
+         vtkm::rendering::Camera::MODE_3D)
+      {
+        throw Error("Scene: tiled images need a 3D camera");
+      }
+      tiled_images.push_back(i);
+    }
+    else
+    {
+      images.push_back(i);
+    }
+  }
 
-    for(auto  render : current_batch)
+  // the database is only created once every image is known to be valid
+  bool write_database = !m_database_name.empty() && is_root;
+  ImageDatabase database;
+  if(write_database)
+  {
+    for(int i = 0; i < render_size; ++i)
     {
-      render.GetCanvas().Clear();
+      database.AddImage(m_renders[i].GetImageName(),
+                        m_renders[i].GetWidth(),
+                        m_renders[i].GetHeight(),
+                        m_database_depth);
     }
+    database.Create(m_database_name);
+  }
 
-    const int plot_size = m_renderers.size();
-    auto renderer = m_renderers.begin();
+  BeginAnnotationLayers();
+  if(m_temporal_reuse)
+  {
+    BeginCachedImages();
+  }
+
+  const int num_images = static_cast<int>(images.size());
+  int batch_start = 0;
+  while(batch_start < num_images)
+  {
+    int batch_end = std::min(m_batch_size + batch_start, num_images);
 
-    // render order is enforced inside add
-    // Order is:
-    // 1) surfaces
-    // 2) meshes
-    // 3) volume
+    std::vector<vtkh::Render> current_batch;
+    for(int i = batch_start; i < batch_end; ++i)
+    {
+      current_batch.push_back(m_renders[images[i]]);
+    }
 
-    // if we have both surfaces/mesh and volumes
-    // we need to synchronize depths so that volume
-    // only render to the max depth
-    bool synch_depths = false;
+    RenderBatch(current_batch, m_temporal_reuse);
 
-    int opaque_plots = plot_size;
-    if(m_has_volume)
+    if(do_once)
     {
-      opaque_plots -= 1;
+      GatherColorBars(field_names, ranges, color_tables);
+      do_once = false;
     }
 
-    //
-    // pass 1: opaque geometry
-    //
-    for(int i = 0; i < opaque_plots; ++i)
+    // render annotations last and save
+    for(int i = 0; i < current_batch.size(); ++i)
     {
-      if(i == opaque_plots - 1)
+      current_batch[i].RenderAnnotations(field_names,
+                                         ranges,
+                                         color_tables,
+                                         m_annotation_layers);
+      if(write_database)
       {
-        (*renderer)->SetDoComposite(true);
+        const int index = images[batch_start + i];
+        if(current_batch[i].HasColorBytes())
+        {
+          database.Write(index,
+                         current_batch[i].GetColorBytes(),
+                         GetVTKMPointer(current_batch[i].GetCanvas().GetDepthBuffer()));
+        }
+        else
+        {
+          database.Write(index, current_batch[i].GetCanvas());
+        }
       }
-      else
+      else if(m_database_name.empty())
       {
-        (*renderer)->SetDoComposite(false);
+        if(m_image_sink)
+        {
+          current_batch[i].SetImageSink(m_image_sink, m_encode_sink);
+        }
+        // written before Render returns, see the flush below
+        current_batch[i].Save(false);
       }
+    }
 
-      (*renderer)->SetRenders(current_batch);
-      (*renderer)->Update();
-
-      (*renderer)->ClearRenders();
+    batch_start = batch_end;
+  } // while
 
-      synch_depths = true;
-      renderer++;
+  for(int image : tiled_images)
+  {
+    vtkh::Render &render = m_renders[image];
+    const int width = render.GetWidth();
+    PNGEncoder encoder;
+    if(is_root && m_database_name.empty())
+    {
+      encoder.BeginStream(render.GetImageName() + ".png",
+                          width,
+                          render.GetHeight(),
+                          render.GetComments());
     }
 
-    //
-    // pass 2: volume
-    //
-    if(m_has_volume)
+    const int num_tiles = render.GetNumberOfTiles();
+    for(int t = 0; t < num_tiles; ++t)
     {
-      if(synch_depths)
+      std::vector<vtkh::Render> tile(1, render.MakeTile(t));
+      RenderBatch(tile, false);
+
+      if(do_once)
       {
-        SynchDepths(current_batch);
+        GatherColorBars(field_names, ranges, color_tables);
+        do_once = false;
       }
-      (*renderer)->SetDoComposite(true);
-      (*renderer)->SetRenders(current_batch);
-      (*renderer)->Update();
 
-      current_batch  = (*renderer)->GetRenders();
-      (*renderer)->ClearRenders();
+      if(!is_root) continue;
+
+      // the world layers of a band are not worth keeping
+      AnnotationLayers layers;
+      tile[0].RenderAnnotations(field_names, ranges, color_tables, layers);
+      if(!tile[0].HasColorBytes())
+      {
+        tile[0].CanvasColorsToBytes();
+      }
+
+      const int rows = tile[0].GetHeight();
+      if(write_database)
+      {
+        const size_t offset = static_cast<size_t>(render.GetTileStart(t)) * width;
+        const size_t size = static_cast<size_t>(rows) * width;
+        memcpy(database.GetColor(image) + offset * 4, tile[0].GetColorBytes(), size * 4);
+        if(database.HasDepth(image))
+        {
+          memcpy(database.GetDepth(image) + offset,
+                 GetVTKMPointer(tile[0].GetCanvas().GetDepthBuffer()),
+                 size * sizeof(float));
+        }
+      }
+      else if(m_database_name.empty())
+      {
+        encoder.StreamRows(tile[0].GetColorBytes(), rows);
+      }
+    }
+
+    if(is_root && m_database_name.empty())
+    {
+      encoder.EndStream();
     }
+  }
 
-    if(do_once)
+  EndAnnotationLayers();
+  if(m_temporal_reuse)
+  {
+    EndCachedImages();
+  }
+
+  // images of this cycle are on disk when Render returns
+  AsyncImageWriter::Instance()->Flush();
+}
+
+void
+Scene::RenderBatch(std::vector<vtkh::Render> &batch, bool reuse)
+{
+  for(auto  render : batch)
+  {
+    render.GetCanvas().Clear();
+    render.ClearColorBytes();
+  }
+
+  if(!reuse)
+  {
+    const bool synch_depths = RenderOpaque(batch);
+    if(m_has_volume)
+    {
+      RenderVolume(batch, synch_depths);
+    }
+    return;
+  }
+
+  VTKH_DATA_OPEN("temporal_reuse");
+  const int opaque_plots = static_cast<int>(m_renderers.size()) - (m_has_volume ? 1 : 0);
+  const bool keep_opaque = m_has_volume && opaque_plots > 0;
+
+  // 2: reuse the image, 1: reuse the surfaces and meshes and
+  // render the volume, 0: render everything
+  const int size = static_cast<int>(batch.size());
+  std::vector<vtkm::UInt64> opaque_keys(size);
+  std::vector<vtkm::UInt64> image_keys(size);
+  std::vector<int> reuse_levels(size, 0);
+  for(int i = 0; i < size; ++i)
+  {
+    Fingerprint key;
+    key.AddValue(batch[i].GetFingerprint());
+    key.AddValue(m_opaque_fingerprint);
+    opaque_keys[i] = key.GetValue();
+    key.AddValue(m_volume_fingerprint);
+    image_keys[i] = key.GetValue();
+
+    if(m_cached_images.find(image_keys[i]) != m_cached_images.end())
+    {
+      reuse_levels[i] = 2;
+    }
+    else if(keep_opaque && m_cached_images.find(opaque_keys[i]) != m_cached_images.end())
     {
-      // gather color tables and other information for
-      // annotations
-      for(auto plot : m_renderers)
+      reuse_levels[i] = 1;
+    }
+  }
+
+#ifdef VTKH_PARALLEL
+  // the plots of every rank have to be unchanged
+  MPI_Comm comm = MPI_Comm_f2c(vtkh::GetMPICommHandle());
+  MPI_Allreduce(MPI_IN_PLACE, &reuse_levels[0], size, MPI_INT, MPI_MIN, comm);
+#endif
+
+  std::vector<int> render_ids;
+  std::vector<vtkh::Render> opaque_batch;
+  std::vector<vtkh::Render> volume_batch;
+  long long int reused_images = 0;
+  for(int i = 0; i < size; ++i)
+  {
+    if(reuse_levels[i] == 2)
+    {
+      RestoreImage(batch[i], image_keys[i]);
+      reused_images++;
+      continue;
+    }
+
+    if(reuse_levels[i] == 1)
+    {
+      RestoreImage(batch[i], opaque_keys[i]);
+    }
+    else
+    {
+      opaque_batch.push_back(batch[i]);
+    }
+    volume_batch.push_back(batch[i]);
+    render_ids.push_back(i);
+  }
+
+  if(!opaque_batch.empty())
+  {
+    RenderOpaque(opaque_batch);
+    if(keep_opaque)
+    {
+      for(int i = 0; i < size; ++i)
       {
-        if((*plot).GetHasColorTable())
+        if(reuse_levels[i] == 0)
         {
-          ranges.push_back((*plot).GetRange());
-          field_names.push_back((*plot).GetFieldName());
-          color_tables.push_back((*plot).GetColorTable());
+          CacheImage(batch[i], opaque_keys[i]);
         }
       }
-      do_once = false;
     }
+  }
 
-    // render screen annotations last and save
-    for(int i = 0; i < current_batch.size(); ++i)
+  if(m_has_volume && !volume_batch.empty())
+  {
+    RenderVolume(volume_batch, opaque_plots > 0);
+  }
+
+  for(int id : render_ids)
+  {
+    CacheImage(batch[id], image_keys[id]);
+  }
+
+  VTKH_DATA_ADD("reused_images", reused_images);
+  VTKH_DATA_ADD("reused_opaque_images",
+                static_cast<long long int>(volume_batch.size() - opaque_batch.size()));
+  VTKH_DATA_CLOSE();
+}
+
+bool
+Scene::RenderOpaque(std::vector<vtkh::Render> &batch)
+{
+  auto renderer = m_renderers.begin();
+
+  // render order is enforced inside add
+  // Order is:
+  // 1) surfaces
+  // 2) meshes
+  // 3) volume
+
+  // if we have both surfaces/mesh and volumes
+  // we need to synchronize depths so that volume
+  // only render to the max depth
+  bool synch_depths = false;
+
+  int opaque_plots = m_renderers.size();
+  if(m_has_volume)
+  {
+    opaque_plots -= 1;
+  }
+
+  for(int i = 0; i < opaque_plots; ++i)
+  {
+    if(i == opaque_plots - 1)
+    {
+      (*renderer)->SetDoComposite(true);
+    }
+    else
     {
-      current_batch[i].RenderWorldAnnotations();
-      current_batch[i].RenderScreenAnnotations(field_names, ranges, color_tables);
-      current_batch[i].RenderBackground();
-      current_batch[i].Save();
+      (*renderer)->SetDoComposite(false);
     }
 
-    batch_start = batch_end;
-  } // while
+    (*renderer)->SetRenders(batch);
+    (*renderer)->Update();
+
+    (*renderer)->ClearRenders();
+
+    synch_depths = true;
+    renderer++;
+  }
+  return synch_depths;
+}
+
+void
+Scene::RenderVolume(std::vector<vtkh::Render> &batch, bool synch_depths)
+{
+  // the volume is always the last plot
+  vtkh::Renderer *renderer = m_renderers.back();
+  if(synch_depths)
+  {
+    SynchDepths(batch);
+  }
+  renderer->SetDoComposite(true);
+  renderer->SetRenders(batch);
+  renderer->Update();
+
+  batch  = renderer->GetRenders();
+  renderer->ClearRenders();
+}
+
+void
+Scene::CacheImage(vtkh::Render &render, const vtkm::UInt64 key)
+{
+  CachedImage &image = m_cached_images[key];
+  image.m_used = true;
+  image.m_rgba.clear();
+  image.m_depths.clear();
+
+  // complete images only exist on rank 0
+#ifdef VTKH_PARALLEL
+  if(vtkh::GetMPIRank() != 0)
+  {
+    return;
+  }
+#endif
+
+  if(!render.HasColorBytes())
+  {
+    render.CanvasColorsToBytes();
+  }
+  const size_t size = static_cast<size_t>(render.GetWidth()) * render.GetHeight();
+  const unsigned char *rgba = render.GetColorBytes();
+  image.m_rgba.assign(rgba, rgba + size * 4);
+  const float *depths = GetVTKMPointer(render.GetCanvas().GetDepthBuffer());
+  image.m_depths.assign(depths, depths + size);
+}
+
+void
+Scene::RestoreImage(vtkh::Render &render, const vtkm::UInt64 key)
+{
+  CachedImage &image = m_cached_images[key];
+  image.m_used = true;
+  if(image.m_rgba.empty())
+  {
+    return;
+  }
+
+  std::vector<unsigned char> rgba(image.m_rgba);
+  render.SetColorBytes(rgba);
+  memcpy(GetVTKMPointer(render.GetCanvas().GetDepthBuffer()),
+         &image.m_depths[0],
+         image.m_depths.size() * sizeof(float));
+}
+
+void
+Scene::BeginCachedImages()
+{
+  // surfaces and meshes are composited into one image, so their
+  // fingerprints are combined in render order
+  VTKH_DATA_OPEN("fingerprint");
+  Fingerprint opaque;
+  Fingerprint volume;
+  for(auto plot : m_renderers)
+  {
+    if(IsVolume(plot))
+    {
+      volume.AddValue(plot->GetFingerprint());
+    }
+    else
+    {
+      opaque.AddValue(plot->GetFingerprint());
+    }
+  }
+  m_opaque_fingerprint = opaque.GetValue();
+  m_volume_fingerprint = volume.GetValue();
+  VTKH_DATA_CLOSE();
+
+  for(auto &image : m_cached_images)
+  {
+    image.second.m_used = false;
+  }
+}
+
+void
+Scene::EndCachedImages()
+{
+  auto image = m_cached_images.begin();
+  while(image != m_cached_images.end())
+  {
+    if(!image->second.m_used)
+    {
+      image = m_cached_images.erase(image);
+    }
+    else
+    {
+      ++image;
+    }
+  }
+}
+
+void
+Scene::GatherColorBars(std::vector<std::string> &field_names,
+                       std::vector<vtkm::Range> &ranges,
+                       std::vector<vtkm::cont::ColorTable> &color_tables)
+{
+  // gather color tables and other information for
+  // annotations
+  for(auto plot : m_renderers)
+  {
+    if((*plot).GetHasColorTable())
+    {
+      ranges.push_back((*plot).GetRange());
+      field_names.push_back((*plot).GetFieldName());
+      color_tables.push_back((*plot).GetColorTable());
+    }
+  }
+}
+
+void
+Scene::BeginAnnotationLayers()
+{
+  // the keys hold everything a layer depends on, so layers are
+  // kept until a call no longer uses them
+  for(auto &layer : m_annotation_layers)
+  {
+    layer.second.m_used = false;
+  }
+}
+
+void
+Scene::EndAnnotationLayers()
+{
+  auto layer = m_annotation_layers.begin();
+  while(layer != m_annotation_layers.end())
+  {
+    if(!layer->second.m_used)
+    {
+      layer = m_annotation_layers.erase(layer);
+    }
+    else
+    {
+      ++layer;
+    }
+  }
 }
 
 void Scene::SynchDepths(std::vector<vtkh::Render> &renders)
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <list>
+#include <map>
 #include <vtkh/vtkh_exports.h>
 #include <vtkh/rendering/Render.hpp>
 #include <vtkh/rendering/Renderer.hpp>
@@ -10,6 +11,18 @@
 namespace vtkh
 {
 
+//
+// The composited color and depth of a render, kept for the next
+// call when temporal reuse is on. Only rank 0 keeps the pixels, the
+// other ranks only need to know that the image exists.
+//
+struct CachedImage
+{
+  std::vector<unsigned char> m_rgba;
+  std::vector<float>         m_depths;
+  bool                       m_used;
+};
+
 class VTKH_API Scene
 {
 private:
@@ -17,6 +30,17 @@ private:
   std::vector<vtkh::Render>    m_renders;
   bool                         m_has_volume;
   int                          m_batch_size;
+  std::string                  m_database_name;
+  bool                         m_database_depth;
+  ImageSink                    m_image_sink;
+  bool                         m_encode_sink;
+  // world annotation layers are kept while their camera is in use
+  AnnotationLayers             m_annotation_layers;
+  bool                         m_temporal_reuse;
+  // fingerprints of the plots for the current call
+  vtkm::UInt64                 m_opaque_fingerprint;
+  vtkm::UInt64                 m_volume_fingerprint;
+  std::map<vtkm::UInt64, CachedImage> m_cached_images;
 public:
  Scene();
  ~Scene();
@@ -28,10 +52,41 @@ public:
   void Save();
   void SetRenderBatchSize(int batch_size);
   int  GetRenderBatchSize() const;
+  // write all images of a Render call into a single ImageDatabase
+  // file instead of one file per image. An empty name turns it off
+  void SetImageDatabase(const std::string &file_name, bool save_depth = false);
+  // deliver the images of every render to the sink instead of
+  // writing files, see Render::SetImageSink
+  void SetImageSink(ImageSink sink, bool encode = false);
+  // Keep the composited images of every call. A render whose
+  // camera and settings did not change reuses its image when the
+  // data and settings of all plots did not change either, and only
+  // the volume is rendered again when only the volume plot changed.
+  // The data of a plot is only hashed again when its arrays are new
+  // objects, values written in place into the same arrays are not
+  // seen.
+  // Tiled renders are always rendered. Off by default
+  void SetTemporalReuse(bool on);
+  bool GetTemporalReuse() const;
 protected:
   bool IsMesh(vtkh::Renderer *renderer);
   bool IsVolume(vtkh::Renderer *renderer);
   void SynchDepths(std::vector<vtkh::Render> &renders);
+  // renders, composites and blends the volume into the batch
+  void RenderBatch(std::vector<vtkh::Render> &batch, bool reuse);
+  // pass 1: surfaces and meshes, returns false if there are none
+  bool RenderOpaque(std::vector<vtkh::Render> &batch);
+  // pass 2: the volume
+  void RenderVolume(std::vector<vtkh::Render> &batch, bool synch_depths);
+  void CacheImage(vtkh::Render &render, const vtkm::UInt64 key);
+  void RestoreImage(vtkh::Render &render, const vtkm::UInt64 key);
+  void BeginCachedImages();
+  void EndCachedImages();
+  void GatherColorBars(std::vector<std::string> &field_names,
+                       std::vector<vtkm::Range> &ranges,
+                       std::vector<vtkm::cont::ColorTable> &color_tables);
+  void BeginAnnotationLayers();
+  void EndAnnotationLayers();
 }; // class scene
 
 } //namespace  vtkh
@@ -0,0 +1,290 @@
+#include "SliceRenderer.hpp"
+#include <vtkh/rendering/Fingerprint.hpp>
+
+#include <vtkh/Logger.hpp>
+#include <vtkh/rendering/StructuredSampler.hpp>
+
+#include <vtkm/VectorAnalysis.h>
+#include <vtkm/rendering/CanvasRayTracer.h>
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+
+namespace vtkh
+{
+
+namespace detail
+{
+
+class SliceDomain
+{
+public:
+  vtkm::cont::DataSet m_data_set;
+  vtkm::Bounds m_bounds;
+  vtkm::Id m_num_cells;
+  StructuredSampler m_sampler;
+
+  SliceDomain(vtkm::cont::DataSet &data_set)
+    : m_data_set(data_set)
+  {
+    m_bounds = data_set.GetCoordinateSystem().GetBounds();
+    m_num_cells = data_set.GetCellSet().GetNumberOfCells();
+  }
+};
+
+// true if the plane passes through the bounds
+bool plane_intersects(const vtkm::Vec3f_32 &point,
+                      const vtkm::Vec3f_32 &normal,
+                      const vtkm::Bounds &bounds)
+{
+  bool above = false;
+  bool below = false;
+  for(int c = 0; c < 8; ++c)
+  {
+    vtkm::Vec3f_32 corner;
+    corner[0] = static_cast<vtkm::Float32>((c & 1) ? bounds.X.Max : bounds.X.Min);
+    corner[1] = static_cast<vtkm::Float32>((c & 2) ? bounds.Y.Max : bounds.Y.Min);
+    corner[2] = static_cast<vtkm::Float32>((c & 4) ? bounds.Z.Max : bounds.Z.Min);
+    const float dist = vtkm::Dot(corner - point, normal);
+    above = above || dist >= 0.f;
+    below = below || dist <= 0.f;
+  }
+  return above && below;
+}
+
+} // namespace detail
+
+SliceRenderer::SliceRenderer()
+{
+}
+
+SliceRenderer::~SliceRenderer()
+{
+  ClearDomains();
+}
+
+Renderer::vtkmCanvasPtr
+SliceRenderer::GetNewCanvas(int width, int height)
+{
+  return std::make_shared<vtkm::rendering::CanvasRayTracer>(width, height);
+}
+
+std::string
+SliceRenderer::GetName() const
+{
+  return "vtkh::SliceRenderer";
+}
+
+void
+SliceRenderer::AddToFingerprint(Fingerprint &fingerprint) const
+{
+  fingerprint.AddValue(m_points.size());
+  for(size_t i = 0; i < m_points.size(); ++i)
+  {
+    fingerprint.AddValue(m_points[i]);
+    fingerprint.AddValue(m_normals[i]);
+  }
+}
+
+void
+SliceRenderer::AddPlane(vtkm::Vec<vtkm::Float32,3> point, vtkm::Vec<vtkm::Float32,3> normal)
+{
+  if(vtkm::Magnitude(normal) == 0.f)
+  {
+    throw Error("SliceRenderer: plane normal cannot be zero");
+  }
+  vtkm::Normalize(normal);
+  m_points.push_back(point);
+  m_normals.push_back(normal);
+}
+
+void
+SliceRenderer::ClearPlanes()
+{
+  m_points.clear();
+  m_normals.clear();
+}
+
+void
+SliceRenderer::SetInput(DataSet *input)
+{
+  Filter::SetInput(input);
+  ClearDomains();
+
+  const int num_domains = static_cast<int>(m_input->GetNumberOfDomains());
+  for(int dom = 0; dom < num_domains; ++dom)
+  {
+    vtkm::cont::DataSet data_set;
+    vtkm::Id domain_id;
+    m_input->GetDomain(dom, data_set, domain_id);
+
+    if(data_set.GetCellSet().GetNumberOfCells() == 0)
+    {
+      continue;
+    }
+
+    if(!detail::StructuredSampler::supported(data_set))
+    {
+      throw Error("SliceRenderer: only 3D uniform and rectilinear data sets are "
+                  "supported. Use Slice for other data sets");
+    }
+
+    m_domains.push_back(new detail::SliceDomain(data_set));
+  }
+}
+
+void
+SliceRenderer::ClearDomains()
+{
+  const int num_domains = m_domains.size();
+  for(int i = 0; i < num_domains; ++i)
+  {
+    delete m_domains[i];
+  }
+  m_domains.clear();
+}
+
+void
+SliceRenderer::DoExecute()
+{
+  if(m_points.size() == 0)
+  {
+    throw Error("SliceRenderer: no planes were added");
+  }
+
+  const int num_planes = static_cast<int>(m_points.size());
+  const int num_samples = 1024;
+  std::vector<vtkm::Vec4f_32> color_map;
+  detail::sample_color_table(m_color_table, num_samples, color_map);
+  const float range_min = static_cast<float>(m_range.Min);
+  const float inv_range = m_range.Length() > 0. ? 1.f / static_cast<float>(m_range.Length()) : 0.f;
+
+  long long int culled_domains = 0;
+  long long int culled_cells = 0;
+
+  const int total_renders = static_cast<int>(m_renders.size());
+  const int num_domains = static_cast<int>(m_domains.size());
+  for(int dom = 0; dom < num_domains; ++dom)
+  {
+    detail::SliceDomain &domain = *m_domains[dom];
+    if(!domain.m_data_set.HasField(m_field_name))
+    {
+      continue;
+    }
+
+    // only the planes that cut this domain
+    std::vector<vtkm::Vec3f_32> points;
+    std::vector<vtkm::Vec3f_32> normals;
+    for(int p = 0; p < num_planes; ++p)
+    {
+      if(detail::plane_intersects(m_points[p], m_normals[p], domain.m_bounds))
+      {
+        points.push_back(m_points[p]);
+        normals.push_back(m_normals[p]);
+      }
+    }
+
+    const int domain_planes = static_cast<int>(points.size());
+    if(domain_planes == 0)
+    {
+      culled_domains += total_renders;
+      culled_cells += domain.m_num_cells * total_renders;
+      continue;
+    }
+
+    domain.m_sampler.update(domain.m_data_set, m_field_name);
+    const detail::StructuredSampler &sampler = domain.m_sampler;
+
+    for(int i = 0; i < total_renders; ++i)
+    {
+      Render::vtkmCanvas &canvas = m_renders[i].GetCanvas();
+      const vtkmCamera &camera = m_renders[i].GetCamera();
+      const int width = canvas.GetWidth();
+      const int height = canvas.GetHeight();
+
+      if(CullDomain(camera, domain.m_bounds, width, height))
+      {
+        culled_domains++;
+        culled_cells += domain.m_num_cells;
+        continue;
+      }
+
+      detail::CanvasRays rays(camera, canvas, domain.m_bounds);
+      const int num_rays = rays.size();
+      if(num_rays == 0)
+      {
+        continue;
+      }
+      const bool shading = m_renders[i].GetShadingOn();
+
+      // every ray belongs to a different pixel
+#ifdef VTKH_USE_OPENMP
+      #pragma omp parallel for
+#endif
+      for(int r = 0; r < num_rays; ++r)
+      {
+        const vtkm::Vec3f_32 ray_origin = rays.origin(r);
+        const vtkm::Vec3f_32 ray_dir = rays.dir(r);
+
+        float tmin = rays.min_distance(r);
+        float tmax = rays.max_distance(r);
+        if(!sampler.clip(ray_origin, ray_dir, tmin, tmax))
+        {
+          continue;
+        }
+
+        // closest plane hit inside the domain
+        int hit = -1;
+        float t_hit = tmax;
+        for(int p = 0; p < domain_planes; ++p)
+        {
+          const float denom = vtkm::Dot(ray_dir, normals[p]);
+          if(denom == 0.f)
+          {
+            continue;
+          }
+          const float t = vtkm::Dot(points[p] - ray_origin, normals[p]) / denom;
+          if(t >= tmin && t <= t_hit)
+          {
+            t_hit = t;
+            hit = p;
+          }
+        }
+
+        if(hit == -1)
+        {
+          continue;
+        }
+
+        const vtkm::Vec3f_32 pos = ray_origin + ray_dir * t_hit;
+        float depth;
+        if(!rays.visible(r, pos, depth))
+        {
+          continue;
+        }
+
+        float normalized = (sampler.sample(pos) - range_min) * inv_range;
+        normalized = std::min(1.f, std::max(0.f, normalized));
+        vtkm::Vec4f_32 color = color_map[static_cast<int>(normalized * (num_samples - 1))];
+        if(shading)
+        {
+          // head light
+          const float diffuse = vtkm::Abs(vtkm::Dot(normals[hit], ray_dir));
+          const float intensity = 0.3f + 0.7f * diffuse;
+          color[0] *= intensity;
+          color[1] *= intensity;
+          color[2] *= intensity;
+        }
+        color[3] = 1.f;
+
+        rays.write(r, color, depth);
+      }
+    }
+  }
+
+  VTKH_DATA_ADD("culled_domains", culled_domains);
+  VTKH_DATA_ADD("culled_cells", culled_cells);
+}
+
+} // namespace vtkh
@@ -0,0 +1,44 @@
+#ifndef VTK_H_RENDERER_SLICE_HPP
+#define VTK_H_RENDERER_SLICE_HPP
+
+#include <vtkh/vtkh_exports.h>
+#include <vtkh/rendering/Renderer.hpp>
+
+namespace vtkh {
+
+namespace detail
+{
+  class SliceDomain;
+}
+
+//
+// Renders slice planes through uniform and rectilinear domains by
+// intersecting the camera rays with the planes and sampling the
+// field at the hit points, so no slice geometry is extracted. The
+// result is written into the canvas depth buffer like any surface.
+//
+class VTKH_API SliceRenderer : public Renderer
+{
+public:
+  SliceRenderer();
+  virtual ~SliceRenderer();
+  std::string GetName() const override;
+  static Renderer::vtkmCanvasPtr GetNewCanvas(int width = 1024, int height = 1024);
+
+  void AddPlane(vtkm::Vec<vtkm::Float32,3> point, vtkm::Vec<vtkm::Float32,3> normal);
+  void ClearPlanes();
+
+  virtual void SetInput(DataSet *input) override;
+protected:
+  virtual void DoExecute() override;
+  virtual void AddToFingerprint(Fingerprint &fingerprint) const override;
+
+  void ClearDomains();
+
+  std::vector<vtkm::Vec<vtkm::Float32,3>> m_points;
+  std::vector<vtkm::Vec<vtkm::Float32,3>> m_normals;
+  std::vector<detail::SliceDomain*> m_domains;
+};
+
+} // namespace vtkh
+#endif
@@ -0,0 +1,343 @@
+#include "StructuredSampler.hpp"
+
+#include <vtkh/Error.hpp>
+#include <vtkh/utils/vtkm_array_utils.hpp>
+#include <vtkh/utils/vtkm_dataset_info.hpp>
+
+#include <vtkm/TypeList.h>
+#include <vtkm/cont/RuntimeDeviceTracker.h>
+#include <vtkm/rendering/raytracing/Camera.h>
+#include <vtkm/rendering/raytracing/RayOperations.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace vtkh
+{
+
+namespace detail
+{
+
+template<typename PortalType>
+void copy_axis(const PortalType &portal, std::vector<float> &axis)
+{
+  const int size = static_cast<int>(portal.GetNumberOfValues());
+  axis.resize(size);
+  for(int i = 0; i < size; ++i)
+  {
+    axis[i] = static_cast<float>(portal.Get(i));
+  }
+}
+
+void axis_coordinates(const vtkm::cont::DataSet &data_set,
+                      std::vector<float> coords[3])
+{
+  int point_dims[3];
+  VTKMDataSetInfo::GetPointDims(data_set, point_dims);
+
+  const vtkm::cont::CoordinateSystem &coordinates = data_set.GetCoordinateSystem();
+  if(VTKMDataSetInfo::IsUniform(coordinates))
+  {
+    auto portal = coordinates.GetData()
+      .Cast<VTKMDataSetInfo::UniformArrayHandle>().ReadPortal();
+    const vtkm::Vec3f origin = portal.GetOrigin();
+    const vtkm::Vec3f spacing = portal.GetSpacing();
+    for(int d = 0; d < 3; ++d)
+    {
+      coords[d].resize(point_dims[d]);
+      for(int i = 0; i < point_dims[d]; ++i)
+      {
+        coords[d][i] = static_cast<float>(origin[d] + spacing[d] * i);
+      }
+    }
+  }
+  else if(VTKMDataSetInfo::IsRectilinear(coordinates))
+  {
+    auto cartesian = coordinates.GetData()
+      .Cast<VTKMDataSetInfo::CartesianArrayHandle>();
+    copy_axis(cartesian.GetFirstArray().ReadPortal(), coords[0]);
+    copy_axis(cartesian.GetSecondArray().ReadPortal(), coords[1]);
+    copy_axis(cartesian.GetThirdArray().ReadPortal(), coords[2]);
+  }
+  else
+  {
+    throw Error("Coordinates must be uniform or rectilinear");
+  }
+}
+
+void sample_color_table(const vtkm::cont::ColorTable &color_table,
+                        const int num_samples,
+                        std::vector<vtkm::Vec4f_32> &colors)
+{
+  vtkm::cont::ArrayHandle<vtkm::Vec4ui_8> samples;
+  {
+    vtkm::cont::ScopedRuntimeDeviceTracker tracker(vtkm::cont::DeviceAdapterTagSerial{});
+    color_table.Sample(num_samples, samples);
+  }
+
+  constexpr vtkm::Float32 conversion = 1.0f / 255.0f;
+  const vtkm::UInt8 *in = &GetVTKMPointer(samples)[0][0];
+  colors.resize(num_samples);
+  vtkm::Float32 *out = &colors[0][0];
+  for(int i = 0; i < num_samples * 4; ++i)
+  {
+    out[i] = in[i] * conversion;
+  }
+}
+
+struct CopyValuesFunctor
+{
+  StructuredSampler *m_sampler;
+
+  template<typename T, typename S>
+  void operator()(const vtkm::cont::ArrayHandle<T,S> &array) const
+  {
+    m_sampler->copy_values(array.ReadPortal());
+  }
+};
+
+StructuredSampler::StructuredSampler()
+  : m_point_field(true),
+    m_uniform(false)
+{
+  for(int d = 0; d < 3; ++d)
+  {
+    m_dims[d] = 0;
+    m_origin[d] = 0.f;
+    m_inv_spacing[d] = 0.f;
+  }
+}
+
+bool
+StructuredSampler::supported(const vtkm::cont::DataSet &data_set)
+{
+  int topo_dims;
+  const vtkm::cont::CoordinateSystem &coords = data_set.GetCoordinateSystem();
+  return VTKMDataSetInfo::IsStructured(data_set, topo_dims) &&
+         topo_dims == 3 &&
+         (VTKMDataSetInfo::IsUniform(coords) || VTKMDataSetInfo::IsRectilinear(coords));
+}
+
+bool
+StructuredSampler::point_field() const
+{
+  return m_point_field;
+}
+
+void
+StructuredSampler::update(const vtkm::cont::DataSet &data_set,
+                          const std::string &field_name)
+{
+  if(field_name == m_field_name)
+  {
+    return;
+  }
+
+  if(!supported(data_set))
+  {
+    throw Error("StructuredSampler: data set must be a 3D uniform or rectilinear grid");
+  }
+
+  const vtkm::cont::Field &field = data_set.GetField(field_name);
+  m_point_field = field.GetAssociation() == vtkm::cont::Field::Association::POINTS;
+
+  axis_coordinates(data_set, m_coords);
+  m_uniform = VTKMDataSetInfo::IsUniform(data_set.GetCoordinateSystem());
+  for(int d = 0; d < 3; ++d)
+  {
+    m_dims[d] = static_cast<int>(m_coords[d].size());
+    m_origin[d] = m_coords[d][0];
+    const float spacing = m_dims[d] > 1 ? m_coords[d][1] - m_coords[d][0] : 0.f;
+    m_inv_spacing[d] = spacing != 0.f ? 1.f / spacing : 0.f;
+  }
+
+  CopyValuesFunctor functor;
+  functor.m_sampler = this;
+  field.GetData().ResetTypes(vtkm::TypeListFieldScalar(),
+                             VTKM_DEFAULT_STORAGE_LIST{}).CastAndCall(functor);
+
+  m_field_name = field_name;
+}
+
+template<typename PortalType>
+void
+StructuredSampler::copy_values(const PortalType &portal)
+{
+  const vtkm::Id size = portal.GetNumberOfValues();
+  m_values.resize(size);
+#ifdef VTKH_USE_OPENMP
+  #pragma omp parallel for
+#endif
+  for(vtkm::Id i = 0; i < size; ++i)
+  {
+    m_values[i] = static_cast<float>(portal.Get(i));
+  }
+}
+
+void
+StructuredSampler::locate(const vtkm::Vec3f_32 &pos, int *cell, float *frac) const
+{
+  for(int d = 0; d < 3; ++d)
+  {
+    const std::vector<float> &coords = m_coords[d];
+    const int max_cell = m_dims[d] - 2;
+    int i;
+    float f;
+    if(m_uniform)
+    {
+      f = (pos[d] - m_origin[d]) * m_inv_spacing[d];
+      i = static_cast<int>(std::floor(f));
+      i = std::min(max_cell, std::max(0, i));
+      f = f - static_cast<float>(i);
+    }
+    else
+    {
+      i = static_cast<int>(std::upper_bound(coords.begin(), coords.end(), pos[d])
+                           - coords.begin()) - 1;
+      i = std::min(max_cell, std::max(0, i));
+      f = (pos[d] - coords[i]) / (coords[i + 1] - coords[i]);
+    }
+    cell[d] = i;
+    frac[d] = std::min(1.f, std::max(0.f, f));
+  }
+}
+
+float
+StructuredSampler::sample(const vtkm::Vec3f_32 &pos) const
+{
+  int cell[3];
+  float f[3];
+  locate(pos, cell, f);
+
+  if(!m_point_field)
+  {
+    const vtkm::Id cx = m_dims[0] - 1;
+    const vtkm::Id cxy = cx * (m_dims[1] - 1);
+    return m_values[cell[0] + cell[1] * cx + cell[2] * cxy];
+  }
+
+  const vtkm::Id dx = m_dims[0];
+  const vtkm::Id dxy = dx * m_dims[1];
+  const float *v = &m_values[cell[0] + cell[1] * dx + cell[2] * dxy];
+
+  const float x00 = v[0] + (v[1] - v[0]) * f[0];
+  const float x10 = v[dx] + (v[dx + 1] - v[dx]) * f[0];
+  const float x01 = v[dxy] + (v[dxy + 1] - v[dxy]) * f[0];
+  const float x11 = v[dxy + dx] + (v[dxy + dx + 1] - v[dxy + dx]) * f[0];
+  const float y0 = x00 + (x10 - x00) * f[1];
+  const float y1 = x01 + (x11 - x01) * f[1];
+  return y0 + (y1 - y0) * f[2];
+}
+
+vtkm::Vec3f_32
+StructuredSampler::gradient(const vtkm::Vec3f_32 &pos) const
+{
+  if(!m_point_field)
+  {
+    return vtkm::Vec3f_32(0.f, 0.f, 0.f);
+  }
+
+  int cell[3];
+  float f[3];
+  locate(pos, cell, f);
+
+  const vtkm::Id dx = m_dims[0];
+  const vtkm::Id dxy = dx * m_dims[1];
+  const float *v = &m_values[cell[0] + cell[1] * dx + cell[2] * dxy];
+  // corner values indexed by (x, y, z) bits
+  const float c[8] = {v[0], v[1], v[dx], v[dx + 1],
+                      v[dxy], v[dxy + 1], v[dxy + dx], v[dxy + dx + 1]};
+
+  const float gx = ((c[1] - c[0]) * (1.f - f[1]) + (c[3] - c[2]) * f[1]) * (1.f - f[2]) +
+                   ((c[5] - c[4]) * (1.f - f[1]) + (c[7] - c[6]) * f[1]) * f[2];
+  const float gy = ((c[2] - c[0]) * (1.f - f[0]) + (c[3] - c[1]) * f[0]) * (1.f - f[2]) +
+                   ((c[6] - c[4]) * (1.f - f[0]) + (c[7] - c[5]) * f[0]) * f[2];
+  const float gz = ((c[4] - c[0]) * (1.f - f[0]) + (c[5] - c[1]) * f[0]) * (1.f - f[1]) +
+                   ((c[6] - c[2]) * (1.f - f[0]) + (c[7] - c[3]) * f[0]) * f[1];
+
+  vtkm::Vec3f_32 res;
+  res[0] = gx / (m_coords[0][cell[0] + 1] - m_coords[0][cell[0]]);
+  res[1] = gy / (m_coords[1][cell[1] + 1] - m_coords[1][cell[1]]);
+  res[2] = gz / (m_coords[2][cell[2] + 1] - m_coords[2][cell[2]]);
+  return res;
+}
+
+bool
+StructuredSampler::clip(const vtkm::Vec3f_32 &origin,
+                        const vtkm::Vec3f_32 &dir,
+                        float &tmin,
+                        float &tmax) const
+{
+  for(int d = 0; d < 3; ++d)
+  {
+    const float inv_dir = 1.f / dir[d];
+    float t0 = (m_coords[d].front() - origin[d]) * inv_dir;
+    float t1 = (m_coords[d].back() - origin[d]) * inv_dir;
+    if(t0 > t1) std::swap(t0, t1);
+    tmin = std::max(tmin, t0);
+    tmax = std::min(tmax, t1);
+  }
+  return tmin <= tmax;
+}
+
+float
+StructuredSampler::min_spacing() const
+{
+  float res = std::numeric_limits<float>::max();
+  for(int d = 0; d < 3; ++d)
+  {
+    for(int i = 1; i < m_dims[d]; ++i)
+    {
+      res = std::min(res, m_coords[d][i] - m_coords[d][i - 1]);
+    }
+  }
+  return res;
+}
+
+CanvasDepth::CanvasDepth(const vtkm::rendering::Camera &camera,
+                         const int width,
+                         const int height)
+{
+  m_projview = vtkm::MatrixMultiply(camera.CreateProjectionMatrix(width, height),
+                                    camera.CreateViewMatrix());
+}
+
+float
+CanvasDepth::depth(const vtkm::Vec3f_32 &pos) const
+{
+  vtkm::Vec4f_32 point(pos[0], pos[1], pos[2], 1.f);
+  vtkm::Vec4f_32 p = vtkm::MatrixMultiply(m_projview, point);
+  return 0.5f * (p[2] / p[3]) + 0.5f;
+}
+
+CanvasRays::CanvasRays(const vtkm::rendering::Camera &camera,
+                       vtkm::rendering::CanvasRayTracer &canvas,
+                       const vtkm::Bounds &bounds)
+  : m_canvas_depth(camera,
+                   static_cast<int>(canvas.GetWidth()),
+                   static_cast<int>(canvas.GetHeight()))
+{
+  vtkm::rendering::raytracing::Camera ray_camera;
+  ray_camera.SetParameters(camera,
+                           static_cast<vtkm::Int32>(canvas.GetWidth()),
+                           static_cast<vtkm::Int32>(canvas.GetHeight()));
+  ray_camera.CreateRays(m_rays, bounds);
+  vtkm::rendering::raytracing::RayOperations::MapCanvasToRays(m_rays, camera, canvas);
+
+  m_size = static_cast<int>(m_rays.NumRays);
+  m_origin[0] = GetVTKMPointer(m_rays.OriginX);
+  m_origin[1] = GetVTKMPointer(m_rays.OriginY);
+  m_origin[2] = GetVTKMPointer(m_rays.OriginZ);
+  m_dir[0] = GetVTKMPointer(m_rays.DirX);
+  m_dir[1] = GetVTKMPointer(m_rays.DirY);
+  m_dir[2] = GetVTKMPointer(m_rays.DirZ);
+  m_min_dist = GetVTKMPointer(m_rays.MinDistance);
+  m_max_dist = GetVTKMPointer(m_rays.MaxDistance);
+  m_pixel_ids = GetVTKMPointer(m_rays.PixelIdx);
+  m_colors = GetVTKMPointer(canvas.GetColorBuffer());
+  m_depths = GetVTKMPointer(canvas.GetDepthBuffer());
+}
+
+} // namespace detail
+} // namespace vtkh
@@ -0,0 +1,172 @@
+#ifndef VTK_H_STRUCTURED_SAMPLER_HPP
+#define VTK_H_STRUCTURED_SAMPLER_HPP
+
+#include <vtkh/vtkh_exports.h>
+
+#include <vtkm/Bounds.h>
+#include <vtkm/Matrix.h>
+#include <vtkm/cont/ColorTable.h>
+#include <vtkm/cont/DataSet.h>
+#include <vtkm/rendering/Camera.h>
+#include <vtkm/rendering/CanvasRayTracer.h>
+#include <vtkm/rendering/raytracing/Ray.h>
+
+#include <string>
+#include <vector>
+
+namespace vtkh
+{
+
+namespace detail
+{
+
+//
+// Copies the point coordinates along each axis of a uniform
+// or rectilinear data set. Throws for any other coordinates.
+//
+VTKH_API void axis_coordinates(const vtkm::cont::DataSet &data_set,
+                               std::vector<float> coords[3]);
+
+//
+// Samples the color table into normalized colors
+//
+VTKH_API void sample_color_table(const vtkm::cont::ColorTable &color_table,
+                                 const int num_samples,
+                                 std::vector<vtkm::Vec4f_32> &colors);
+
+//
+// Host side sampling of a scalar field on a 3D uniform or
+// rectilinear grid. Point fields are interpolated trilinearly
+// and cell fields are constant over each cell. The field is
+// copied once per field name so that renderers can sample it
+// directly from many threads.
+//
+class VTKH_API StructuredSampler
+{
+public:
+  StructuredSampler();
+
+  // true if the data set is a grid the sampler can handle
+  static bool supported(const vtkm::cont::DataSet &data_set);
+
+  // copies the field if it is not the current one
+  void update(const vtkm::cont::DataSet &data_set,
+              const std::string &field_name);
+
+  bool point_field() const;
+
+  float sample(const vtkm::Vec3f_32 &pos) const;
+  // gradient of the trilinear interpolant of a point field
+  vtkm::Vec3f_32 gradient(const vtkm::Vec3f_32 &pos) const;
+
+  // clips the ray interval to the grid and returns
+  // false if nothing is left
+  bool clip(const vtkm::Vec3f_32 &origin,
+            const vtkm::Vec3f_32 &dir,
+            float &tmin,
+            float &tmax) const;
+
+  // smallest distance between points along any axis
+  float min_spacing() const;
+protected:
+  void locate(const vtkm::Vec3f_32 &pos, int *cell, float *frac) const;
+
+  template<typename PortalType>
+  void copy_values(const PortalType &portal);
+
+  std::string m_field_name;
+  bool m_point_field;
+  int m_dims[3];
+  bool m_uniform;
+  float m_origin[3];
+  float m_inv_spacing[3];
+  std::vector<float> m_coords[3];
+  std::vector<float> m_values;
+
+  friend struct CopyValuesFunctor;
+};
+
+//
+// Projects world space positions into canvas depths
+//
+class VTKH_API CanvasDepth
+{
+public:
+  CanvasDepth(const vtkm::rendering::Camera &camera,
+              const int width,
+              const int height);
+
+  float depth(const vtkm::Vec3f_32 &pos) const;
+protected:
+  vtkm::Matrix<vtkm::Float32, 4, 4> m_projview;
+};
+
+//
+// The camera rays that could hit the bounds, limited to the depths
+// that are already in the canvas. Every ray belongs to a different
+// pixel, so renderers can trace them on the host from many threads
+// and write the hits straight into the canvas.
+//
+class VTKH_API CanvasRays
+{
+public:
+  CanvasRays(const vtkm::rendering::Camera &camera,
+             vtkm::rendering::CanvasRayTracer &canvas,
+             const vtkm::Bounds &bounds);
+
+  int size() const
+  {
+    return m_size;
+  }
+
+  vtkm::Vec3f_32 origin(const int r) const
+  {
+    return vtkm::Vec3f_32(m_origin[0][r], m_origin[1][r], m_origin[2][r]);
+  }
+
+  vtkm::Vec3f_32 dir(const int r) const
+  {
+    return vtkm::Vec3f_32(m_dir[0][r], m_dir[1][r], m_dir[2][r]);
+  }
+
+  // the ray interval, never behind the camera
+  float min_distance(const int r) const
+  {
+    return m_min_dist[r] > 0.f ? m_min_dist[r] : 0.f;
+  }
+
+  float max_distance(const int r) const
+  {
+    return m_max_dist[r];
+  }
+
+  // the canvas depth of the hit, or false if the
+  // canvas already has something in front of it
+  bool visible(const int r, const vtkm::Vec3f_32 &pos, float &depth) const
+  {
+    depth = m_canvas_depth.depth(pos);
+    return depth < m_depths[m_pixel_ids[r]];
+  }
+
+  void write(const int r, const vtkm::Vec4f_32 &color, const float depth)
+  {
+    const vtkm::Id pixel = m_pixel_ids[r];
+    m_colors[pixel] = color;
+    m_depths[pixel] = depth;
+  }
+protected:
+  vtkm::rendering::raytracing::Ray<vtkm::Float32> m_rays;
+  CanvasDepth m_canvas_depth;
+  int m_size;
+  const vtkm::Float32 *m_origin[3];
+  const vtkm::Float32 *m_dir[3];
+  const vtkm::Float32 *m_min_dist;
+  const vtkm::Float32 *m_max_dist;
+  const vtkm::Id *m_pixel_ids;
+  vtkm::Vec4f_32 *m_colors;
+  vtkm::Float32 *m_depths;
+};
+
+} // namespace detail
+} // namespace vtkh
+#endif
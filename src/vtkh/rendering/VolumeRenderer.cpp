@@ -1,4 +1,5 @@
 #include "VolumeRenderer.hpp"
+#include <vtkh/rendering/Fingerprint.hpp>
 
 #include <vtkh/utils/vtkm_array_utils.hpp>
 #include <vtkh/compositing/Compositor.hpp>
@@ -6,6 +7,7 @@
 
 #include <vtkm/rendering/CanvasRayTracer.h>
 
+#include <algorithm>
 #include <memory>
 
 #ifdef VTKH_PARALLEL
@@ -13,6 +15,7 @@
 #endif
 
 
+#include <vtkm/cont/Algorithm.h>
 #include <vtkm/cont/ColorTable.h>
 #include <vtkm/rendering/ConnectivityProxy.h>
 #include <vtkh/compositing/PartialCompositor.hpp>
@@ -21,8 +24,20 @@
 #include <vtkm/rendering/raytracing/Camera.h>
 
 #include <vtkh/compositing/VolumePartial.hpp>
+#include <vtkh/rendering/MacrocellGrid.hpp>
 
 #define VTKH_OPACITY_CORRECTION 10.f
+// upper bound on the number of pixels whose rays are traced
+// together in a single camera batch
+#define VTKH_MAX_BATCH_PIXELS (1 << 22)
+// maximum number of visible intervals traced per ray
+// when leaping over empty space
+#define VTKH_MAX_RAY_SEGMENTS 4
+// rough number of copies of each partial that exist
+// at the same time during compositing
+#define VTKH_PARTIAL_COPIES 3
+// rough size of a ray with all of its buffers in bytes
+#define VTKH_RAY_BYTES 112
 
 namespace vtkh {
 
@@ -33,31 +48,30 @@ struct VisOrdering
 {
   int m_rank;
   int m_domain_index;
-  int m_order;
   float m_minz;
+  // transparent or culled domains go after all others
+  int m_skip;
 };
 
 struct DepthOrder
 {
   inline bool operator()(const VisOrdering &lhs, const VisOrdering &rhs)
   {
-    return lhs.m_minz < rhs.m_minz;
-  }
-};
-
-struct RankOrder
-{
-  inline bool operator()(const VisOrdering &lhs, const VisOrdering &rhs)
-  {
-    if(lhs.m_rank < rhs.m_rank)
+    if(lhs.m_skip != rhs.m_skip)
+    {
+      return lhs.m_skip < rhs.m_skip;
+    }
+    // break ties by rank and domain so every rank
+    // that sorts the same list agrees on the order
+    if(lhs.m_minz != rhs.m_minz)
     {
-      return true;
+      return lhs.m_minz < rhs.m_minz;
     }
-    else if(lhs.m_rank == rhs.m_rank)
+    if(lhs.m_rank != rhs.m_rank)
     {
-      return lhs.m_domain_index < rhs.m_domain_index;
+      return lhs.m_rank < rhs.m_rank;
     }
-    return false;
+    return lhs.m_domain_index < rhs.m_domain_index;
   }
 };
 
@@ -76,34 +90,284 @@ convert_table(const vtkm::cont::ColorTable& colorTable)
 
   vtkm::cont::ArrayHandle<vtkm::Vec4f_32> color_map;
   color_map.Allocate(1024);
-  auto portal = color_map.WritePortal();
-  auto colorPortal = temp.ReadPortal();
-  for (vtkm::Id i = 0; i < 1024; ++i)
+  const vtkm::UInt8 *in = &GetVTKMPointer(temp)[0][0];
+  vtkm::Float32 *out = &GetVTKMPointer(color_map)[0][0];
+  for (vtkm::Id i = 0; i < 1024 * 4; ++i)
   {
-    auto color = colorPortal.Get(i);
-    vtkm::Vec4f_32 t(color[0] * conversionToFloatSpace,
-                     color[1] * conversionToFloatSpace,
-                     color[2] * conversionToFloatSpace,
-                     color[3] * conversionToFloatSpace);
-    portal.Set(i, t);
+    out[i] = in[i] * conversionToFloatSpace;
   }
   return color_map;
 }
 
+typedef vtkm::rendering::raytracing::Ray<vtkm::Float32> RayType;
+
+template<typename T>
+void copy_ray_array(vtkm::cont::ArrayHandle<T> &src,
+                    const vtkm::Id begin,
+                    const vtkm::Id count,
+                    vtkm::cont::ArrayHandle<T> &dest,
+                    const vtkm::Id offset)
+{
+  vtkm::cont::Algorithm::CopySubRange(src,
+                                      begin,
+                                      count,
+                                      dest,
+                                      offset);
+}
+
+// copies rays [begin, begin + count) of src into dest at offset
+void copy_rays(RayType &src,
+               const vtkm::Id begin,
+               const vtkm::Id count,
+               RayType &dest,
+               const vtkm::Id offset)
+{
+  copy_ray_array(src.OriginX, begin, count, dest.OriginX, offset);
+  copy_ray_array(src.OriginY, begin, count, dest.OriginY, offset);
+  copy_ray_array(src.OriginZ, begin, count, dest.OriginZ, offset);
+  copy_ray_array(src.DirX, begin, count, dest.DirX, offset);
+  copy_ray_array(src.DirY, begin, count, dest.DirY, offset);
+  copy_ray_array(src.DirZ, begin, count, dest.DirZ, offset);
+  copy_ray_array(src.MinDistance, begin, count, dest.MinDistance, offset);
+  copy_ray_array(src.MaxDistance, begin, count, dest.MaxDistance, offset);
+  copy_ray_array(src.Distance, begin, count, dest.Distance, offset);
+  copy_ray_array(src.HitIdx, begin, count, dest.HitIdx, offset);
+  copy_ray_array(src.Status, begin, count, dest.Status, offset);
+  copy_ray_array(src.PixelIdx, begin, count, dest.PixelIdx, offset);
+}
+
+//
+// Generates the rays for a batch of cameras and packs them into
+// a single ray buffer so that a domain can be traversed with one
+// launch for all cameras. Pixel ids are shifted by the number of
+// pixels of all previous cameras in the batch so the results can
+// be split back up after tracing.
+//
+void create_batch_rays(const std::vector<vtkm::rendering::Camera> &cameras,
+                       std::vector<vtkm::rendering::CanvasRayTracer*> &canvases,
+                       const vtkm::Bounds &bounds,
+                       RayType &batch_rays,
+                       std::vector<int> &pixel_offsets)
+{
+  const int num_cameras = static_cast<int>(cameras.size());
+  std::vector<RayType> camera_rays;
+  camera_rays.resize(num_cameras);
+  pixel_offsets.resize(num_cameras + 1);
+  pixel_offsets[0] = 0;
+
+  vtkm::Id total_rays = 0;
+  for(int i = 0; i < num_cameras; ++i)
+  {
+    vtkm::rendering::CanvasRayTracer &canvas = *canvases[i];
+    vtkm::rendering::raytracing::Camera rayCamera;
+    vtkm::Int32 width = (vtkm::Int32) canvas.GetWidth();
+    vtkm::Int32 height = (vtkm::Int32) canvas.GetHeight();
+    rayCamera.SetParameters(cameras[i], width, height);
+
+    rayCamera.CreateRays(camera_rays[i], bounds);
+    vtkm::rendering::raytracing::RayOperations::MapCanvasToRays(camera_rays[i],
+                                                                cameras[i],
+                                                                canvas);
+    pixel_offsets[i + 1] = pixel_offsets[i] + width * height;
+    total_rays += camera_rays[i].NumRays;
+  }
+
+  if(num_cameras == 1)
+  {
+    batch_rays = camera_rays[0];
+    batch_rays.Buffers.at(0).InitConst(0.f);
+    return;
+  }
+
+  batch_rays.Resize(static_cast<vtkm::Int32>(total_rays));
+
+  vtkm::Id offset = 0;
+  for(int i = 0; i < num_cameras; ++i)
+  {
+    RayType &rays = camera_rays[i];
+    const vtkm::Id num_rays = rays.NumRays;
+    if(num_rays == 0)
+    {
+      continue;
+    }
+
+    copy_rays(rays, 0, num_rays, batch_rays, offset);
+
+    // shift the pixel ids into the batch pixel space
+    const vtkm::Id pixel_offset = pixel_offsets[i];
+    vtkm::Id *pixel_ids = GetVTKMPointer(batch_rays.PixelIdx);
+#ifdef VTKH_USE_OPENMP
+    #pragma omp parallel for
+#endif
+    for(vtkm::Id r = offset; r < offset + num_rays; ++r)
+    {
+      pixel_ids[r] += pixel_offset;
+    }
+
+    offset += num_rays;
+  }
+
+  batch_rays.Buffers.at(0).InitConst(0.f);
+}
+
+//
+// Returns a camera that sees only the rows [row_begin, row_end)
+// of an image of the given height. This is the same band as
+// Render::MakeTile: zoom and pan act on the normalized device
+// coordinates, so scaling by the band height and moving the band
+// center to the origin gives the rays of the full image.
+//
+vtkm::rendering::Camera band_camera(const vtkm::rendering::Camera &camera,
+                                    const vtkm::Id height,
+                                    const vtkm::Id row_begin,
+                                    const vtkm::Id row_end)
+{
+  const vtkm::Id rows = row_end - row_begin;
+  const vtkm::Float32 scale = static_cast<vtkm::Float32>(height) / rows;
+  const vtkm::Float32 center = -1.f + static_cast<vtkm::Float32>(2 * row_begin + rows) / height;
+  vtkm::rendering::Camera band = camera;
+  const vtkm::Float32 zoom = camera.GetZoom();
+  const vtkm::Vec2f_32 pan = camera.GetPan();
+  band.SetZoom(zoom * scale);
+  band.SetPan(pan[0] / scale, pan[1] - center / zoom);
+  return band;
+}
+
+//
+// Splits partials traced with a camera batch back into the
+// partials of each camera using the batch pixel offsets
+//
+void split_batch_partials(std::vector<VolumePartial<float>> &batch_partials,
+                          const std::vector<int> &pixel_offsets,
+                          std::vector<std::vector<VolumePartial<float>>*> &partials)
+{
+  const int num_cameras = static_cast<int>(partials.size());
+  if(num_cameras == 1)
+  {
+    partials[0]->swap(batch_partials);
+    return;
+  }
+
+  const int size = static_cast<int>(batch_partials.size());
+  for(int i = 0; i < size; ++i)
+  {
+    VolumePartial<float> &partial = batch_partials[i];
+    auto it = std::upper_bound(pixel_offsets.begin(),
+                               pixel_offsets.end(),
+                               partial.m_pixel_id);
+    const int camera = static_cast<int>(it - pixel_offsets.begin()) - 1;
+    partial.m_pixel_id -= pixel_offsets[camera];
+    partials[camera]->push_back(partial);
+  }
+  batch_partials.clear();
+}
+
+template<typename T>
+void gather_ray_array(vtkm::cont::ArrayHandle<T> &src,
+                      const std::vector<int> &ids,
+                      vtkm::cont::ArrayHandle<T> &dest)
+{
+  const int size = static_cast<int>(ids.size());
+  const T *in = GetVTKMPointer(src);
+  T *out = GetVTKMPointer(dest);
+#ifdef VTKH_USE_OPENMP
+  #pragma omp parallel for
+#endif
+  for(int i = 0; i < size; ++i)
+  {
+    out[i] = in[ids[i]];
+  }
+}
+
+// copies the rays with the given ids, including their colors
+void gather_rays(RayType &src, const std::vector<int> &ids, RayType &dest)
+{
+  dest.Resize(static_cast<vtkm::Int32>(ids.size()));
+  gather_ray_array(src.OriginX, ids, dest.OriginX);
+  gather_ray_array(src.OriginY, ids, dest.OriginY);
+  gather_ray_array(src.OriginZ, ids, dest.OriginZ);
+  gather_ray_array(src.DirX, ids, dest.DirX);
+  gather_ray_array(src.DirY, ids, dest.DirY);
+  gather_ray_array(src.DirZ, ids, dest.DirZ);
+  gather_ray_array(src.MinDistance, ids, dest.MinDistance);
+  gather_ray_array(src.MaxDistance, ids, dest.MaxDistance);
+  gather_ray_array(src.Distance, ids, dest.Distance);
+  gather_ray_array(src.HitIdx, ids, dest.HitIdx);
+  gather_ray_array(src.Status, ids, dest.Status);
+  gather_ray_array(src.PixelIdx, ids, dest.PixelIdx);
+
+  const int size = static_cast<int>(ids.size());
+  const vtkm::Float32 *in = GetVTKMPointer(src.Buffers.at(0).Buffer);
+  vtkm::Float32 *out = GetVTKMPointer(dest.Buffers.at(0).Buffer);
+#ifdef VTKH_USE_OPENMP
+  #pragma omp parallel for
+#endif
+  for(int i = 0; i < size; ++i)
+  {
+    for(int c = 0; c < 4; ++c)
+    {
+      out[i * 4 + c] = in[ids[i] * 4 + c];
+    }
+  }
+}
+
+// copies the colors of gathered rays back to the rays they came from
+void scatter_colors(RayType &src, const std::vector<int> &ids, RayType &dest)
+{
+  const int size = static_cast<int>(ids.size());
+  const vtkm::Float32 *in = GetVTKMPointer(src.Buffers.at(0).Buffer);
+  vtkm::Float32 *out = GetVTKMPointer(dest.Buffers.at(0).Buffer);
+#ifdef VTKH_USE_OPENMP
+  #pragma omp parallel for
+#endif
+  for(int i = 0; i < size; ++i)
+  {
+    for(int c = 0; c < 4; ++c)
+    {
+      out[ids[i] * 4 + c] = in[i * 4 + c];
+    }
+  }
+}
+
 class VolumeWrapper
 {
 protected:
   vtkm::cont::DataSet m_data_set;
+  int m_domain_index;
+  vtkm::Bounds m_bounds;
   vtkm::Range m_scalar_range;
   std::string m_field_name;
   vtkm::Float32 m_sample_dist;
   vtkm::cont::ArrayHandle<vtkm::Vec4f_32> m_color_map;
+
+  // traces a (possibly batched) set of rays and converts
+  // the results into partial composites
+  virtual void
+  trace(RayType &rays,
+        std::vector<VolumePartial<float>> &partials) = 0;
 public:
   VolumeWrapper() = delete;
 
-  VolumeWrapper(vtkm::cont::DataSet &data_set)
-   : m_data_set(data_set)
+  VolumeWrapper(vtkm::cont::DataSet &data_set, const int domain_index)
+   : m_data_set(data_set),
+     m_domain_index(domain_index)
   {
+    m_bounds = m_data_set.GetCoordinateSystem().GetBounds();
+  }
+
+  // returns true if every value of the field in this domain
+  // maps to zero opacity
+  virtual bool transparent(const OpacityLookup &opacity)
+  {
+    const vtkm::cont::Field &field = m_data_set.GetField(m_field_name);
+    const vtkm::Range range = field.GetRange().ReadPortal().Get(0);
+    return opacity.transparent(range);
+  }
+
+  // the bounds of the domain rays need to visit
+  virtual vtkm::Bounds ray_bounds() const
+  {
+    return m_bounds;
   }
 
   virtual ~VolumeWrapper()
@@ -111,6 +375,22 @@ public:
 
   }
 
+  // index of the domain in the input
+  int domain_index() const
+  {
+    return m_domain_index;
+  }
+
+  const vtkm::Bounds& bounds() const
+  {
+    return m_bounds;
+  }
+
+  vtkm::Id num_cells() const
+  {
+    return m_data_set.GetCellSet().GetNumberOfCells();
+  }
+
   void sample_distance(const vtkm::Float32 &distance)
   {
     m_sample_dist = distance;
@@ -131,13 +411,97 @@ public:
     m_color_map = color_map;
   }
 
-  virtual void
+  void
   render(const vtkm::rendering::Camera &camera,
          vtkm::rendering::CanvasRayTracer &canvas,
-         std::vector<VolumePartial<float>> &partials) = 0;
+         std::vector<VolumePartial<float>> &partials)
+  {
+    std::vector<vtkm::rendering::Camera> cameras = {camera};
+    std::vector<vtkm::rendering::CanvasRayTracer*> canvases = {&canvas};
+    std::vector<std::vector<VolumePartial<float>>*> outputs = {&partials};
+    render(cameras, canvases, outputs);
+  }
+
+  //
+  // Renders all cameras in the batch with a single traversal
+  // of this domain
+  //
+  void
+  render(const std::vector<vtkm::rendering::Camera> &cameras,
+         std::vector<vtkm::rendering::CanvasRayTracer*> &canvases,
+         std::vector<std::vector<VolumePartial<float>>*> &partials)
+  {
+    RayType rays;
+    std::vector<int> pixel_offsets;
+    create_batch_rays(cameras, canvases, ray_bounds(), rays, pixel_offsets);
+
+    std::vector<VolumePartial<float>> batch_partials;
+    if(rays.NumRays > 0)
+    {
+      trace(rays, batch_partials);
+    }
+
+    split_batch_partials(batch_partials, pixel_offsets, partials);
+  }
+
+  //
+  // Renders only the rows [row_begin, row_end) of a single camera.
+  // Rays are only generated for the band, using a band camera and
+  // a canvas that holds the depth of those rows. Pixel ids of the
+  // partials are those of the full image.
+  //
+  void
+  render_tile(const vtkm::rendering::Camera &camera,
+              vtkm::rendering::CanvasRayTracer &canvas,
+              const vtkm::Id row_begin,
+              const vtkm::Id row_end,
+              std::vector<VolumePartial<float>> &partials)
+  {
+    const vtkm::Id width = canvas.GetWidth();
+    const vtkm::Id height = canvas.GetHeight();
+    const vtkm::Id rows = row_end - row_begin;
+
+    vtkm::rendering::CanvasRayTracer band_canvas(static_cast<vtkm::Id>(width),
+                                                 static_cast<vtkm::Id>(rows));
+    vtkm::cont::Algorithm::CopySubRange(canvas.GetDepthBuffer(),
+                                        row_begin * width,
+                                        rows * width,
+                                        band_canvas.GetDepthBuffer(),
+                                        0);
+
+    std::vector<vtkm::rendering::Camera> cameras =
+      {band_camera(camera, height, row_begin, row_end)};
+    std::vector<vtkm::rendering::CanvasRayTracer*> canvases = {&band_canvas};
+
+    RayType rays;
+    std::vector<int> pixel_offsets;
+    create_batch_rays(cameras, canvases, ray_bounds(), rays, pixel_offsets);
+    if(rays.NumRays == 0)
+    {
+      return;
+    }
+
+    const size_t offset = partials.size();
+    trace(rays, partials);
+
+    const int pixel_offset = static_cast<int>(row_begin * width);
+    const int size = static_cast<int>(partials.size() - offset);
+    VolumePartial<float> *out = partials.data() + offset;
+#ifdef VTKH_USE_OPENMP
+    #pragma omp parallel for
+#endif
+    for(int i = 0; i < size; ++i)
+    {
+      out[i].m_pixel_id += pixel_offset;
+    }
+  }
 
 };
 
+//
+// Gathers the VTK-m partials straight from the array memory
+// and appends them to the partials
+//
 void vtkm_to_partials(vtkm::rendering::PartialVector32 &vtkm_partials,
                       std::vector<VolumePartial<float>> &partials)
 {
@@ -145,7 +509,7 @@ void vtkm_to_partials(vtkm::rendering::PartialVector32 &vtkm_partials,
   std::vector<int> offsets;
   offsets.reserve(num_vecs);
 
-  int total_size = 0;
+  int total_size = partials.size();
   for(int i = 0; i < num_vecs; ++i)
   {
     const int size = vtkm_partials[i].PixelIds.GetNumberOfValues();
@@ -158,55 +522,93 @@ void vtkm_to_partials(vtkm::rendering::PartialVector32 &vtkm_partials,
   for(int i = 0; i < num_vecs; ++i)
   {
     const int size = vtkm_partials[i].PixelIds.GetNumberOfValues();
-    auto pixel_ids = vtkm_partials[i].PixelIds.ReadPortal();
-    auto distances = vtkm_partials[i].Distances.ReadPortal();
-    auto colors = vtkm_partials[i].Buffer.Buffer.ReadPortal();
+    if(size == 0)
+    {
+      continue;
+    }
+    const vtkm::Id *pixel_ids = GetVTKMPointer(vtkm_partials[i].PixelIds);
+    const vtkm::Float32 *distances = GetVTKMPointer(vtkm_partials[i].Distances);
+    const vtkm::Float32 *colors = GetVTKMPointer(vtkm_partials[i].Buffer.Buffer);
+    VolumePartial<float> *out = &partials[offsets[i]];
 
-    const int offset = offsets[i];
 #ifdef VTKH_USE_OPENMP
     #pragma omp parallel for
 #endif
     for(int p = 0; p < size; ++p)
     {
-      VolumePartial<float> &partial = partials[offset+p];
-      partial.m_pixel[0] = colors.Get(p*4 + 0);
-      partial.m_pixel[1] = colors.Get(p*4 + 1);
-      partial.m_pixel[2] = colors.Get(p*4 + 2);
-      partial.m_alpha = colors.Get(p*4 + 3);
-      partial.m_pixel_id = pixel_ids.Get(p);
-      partial.m_depth = distances.Get(p);
+      VolumePartial<float> &partial = out[p];
+      const vtkm::Float32 *color = colors + p * 4;
+      partial.m_pixel[0] = color[0];
+      partial.m_pixel[1] = color[1];
+      partial.m_pixel[2] = color[2];
+      partial.m_alpha = color[3];
+      partial.m_pixel_id = static_cast<int>(pixel_ids[p]);
+      partial.m_depth = distances[p];
     }
   }
 }
 
+//
+// Gathers the rays that hit something into partials
+// and appends them to the partials
+//
+void rays_to_partials(RayType &rays,
+                      const std::vector<vtkm::Float32> &depths,
+                      std::vector<VolumePartial<float>> &partials)
+{
+  const int size = rays.NumRays;
+  if(size == 0)
+  {
+    return;
+  }
+  const vtkm::Id *pixel_ids = GetVTKMPointer(rays.PixelIdx);
+  const vtkm::Float32 *colors = GetVTKMPointer(rays.Buffers.at(0).Buffer);
+
+  // find the output index of every ray we keep
+  std::vector<int> offsets(size);
+  int total = 0;
+  for(int i = 0; i < size; ++i)
+  {
+    offsets[i] = total;
+    total += colors[i * 4 + 3] < 0.001f ? 0 : 1;
+  }
+
+  const int start = partials.size();
+  partials.resize(start + total);
+  VolumePartial<float> *out = partials.data() + start;
+
+#ifdef VTKH_USE_OPENMP
+  #pragma omp parallel for
+#endif
+  for(int i = 0; i < size; ++i)
+  {
+    const vtkm::Float32 *color = colors + i * 4;
+    if(color[3] < 0.001f) continue;
+    VolumePartial<float> &partial = out[offsets[i]];
+    partial.m_pixel[0] = color[0];
+    partial.m_pixel[1] = color[1];
+    partial.m_pixel[2] = color[2];
+    partial.m_alpha = color[3];
+    partial.m_pixel_id = static_cast<int>(pixel_ids[i]);
+    partial.m_depth = depths[i];
+  }
+}
+
 class UnstructuredWrapper : public VolumeWrapper
 {
   vtkm::rendering::ConnectivityProxy m_tracer;
 public:
-  UnstructuredWrapper(vtkm::cont::DataSet &data_set)
-    : VolumeWrapper(data_set),
+  UnstructuredWrapper(vtkm::cont::DataSet &data_set, const int domain_index)
+    : VolumeWrapper(data_set, domain_index),
       m_tracer(data_set)
   {
   }
 
+protected:
   virtual void
-  render(const vtkm::rendering::Camera &camera,
-         vtkm::rendering::CanvasRayTracer &canvas,
-         std::vector<VolumePartial<float>> &partials) override
+  trace(RayType &rays,
+        std::vector<VolumePartial<float>> &partials) override
   {
-    const vtkm::cont::CoordinateSystem &coords = m_data_set.GetCoordinateSystem();
-
-    vtkm::rendering::raytracing::Camera rayCamera;
-    vtkm::rendering::raytracing::Ray<vtkm::Float32> rays;
-    vtkm::Int32 width = (vtkm::Int32) canvas.GetWidth();
-    vtkm::Int32 height = (vtkm::Int32) canvas.GetHeight();
-
-    rayCamera.SetParameters(camera, width, height);
-
-    rayCamera.CreateRays(rays, coords.GetBounds());
-    rays.Buffers.at(0).InitConst(0.f);
-    vtkm::rendering::raytracing::RayOperations::MapCanvasToRays(rays, camera, canvas);
-
     m_tracer.SetSampleDistance(m_sample_dist);
     m_tracer.SetColorMap(m_color_map);
     m_tracer.SetScalarField(m_field_name);
@@ -222,30 +624,44 @@ public:
 
 class StructuredWrapper : public VolumeWrapper
 {
+  MacrocellGrid m_macrocells;
+  vtkm::Bounds m_visible_bounds;
 public:
-  StructuredWrapper(vtkm::cont::DataSet &data_set)
-    : VolumeWrapper(data_set)
+  StructuredWrapper(vtkm::cont::DataSet &data_set, const int domain_index)
+    : VolumeWrapper(data_set, domain_index)
   {
+    m_visible_bounds = m_bounds;
   }
+
+  virtual bool transparent(const OpacityLookup &opacity) override
+  {
+    m_macrocells.update(m_data_set, m_field_name);
+    if(m_macrocells.num_macrocells() == 0)
+    {
+      m_visible_bounds = m_bounds;
+      return VolumeWrapper::transparent(opacity);
+    }
+
+    // skip the transparent sub-bricks by only
+    // tracing the bounds of the visible ones
+    const int num_visible = m_macrocells.classify(opacity);
+    m_visible_bounds = m_macrocells.visible_bounds();
+    return num_visible == 0;
+  }
+
+  virtual vtkm::Bounds ray_bounds() const override
+  {
+    return m_visible_bounds;
+  }
+protected:
   virtual void
-  render(const vtkm::rendering::Camera &camera,
-         vtkm::rendering::CanvasRayTracer &canvas,
-         std::vector<VolumePartial<float>> &partials) override
+  trace(RayType &rays,
+        std::vector<VolumePartial<float>> &partials) override
   {
     const vtkm::cont::DynamicCellSet &cellset = m_data_set.GetCellSet();
     const vtkm::cont::Field &field = m_data_set.GetField(m_field_name);
     const vtkm::cont::CoordinateSystem &coords = m_data_set.GetCoordinateSystem();
 
-    vtkm::rendering::raytracing::Camera rayCamera;
-    vtkm::rendering::raytracing::Ray<vtkm::Float32> rays;
-    vtkm::Int32 width = (vtkm::Int32) canvas.GetWidth();
-    vtkm::Int32 height = (vtkm::Int32) canvas.GetHeight();
-    rayCamera.SetParameters(camera, width, height);
-
-    rayCamera.CreateRays(rays, coords.GetBounds());
-    rays.Buffers.at(0).InitConst(0.f);
-    vtkm::rendering::raytracing::RayOperations::MapCanvasToRays(rays, camera, canvas);
-
     vtkm::rendering::raytracing::VolumeRendererStructured tracer;
     tracer.SetSampleDistance(m_sample_dist);
     tracer.SetData(coords,
@@ -254,36 +670,178 @@ public:
                    m_scalar_range);
     tracer.SetColorMap(m_color_map);
 
+    const int ray_size = rays.NumRays;
+    // partials use the max distance
+    std::vector<vtkm::Float32> depths;
 
-    tracer.Render(rays);
+    if(m_macrocells.num_macrocells() == 0)
+    {
+      tracer.Render(rays);
+      const vtkm::Float32 *max_dist = GetVTKMPointer(rays.MaxDistance);
+      depths.assign(max_dist, max_dist + ray_size);
+    }
+    else
+    {
+      leap_empty_space(tracer, rays, depths);
+    }
 
     // Convert the rays to partial composites
-    const int ray_size = rays.NumRays;
-    // partials use the max distance
-    auto depths = rays.MaxDistance.ReadPortal();
-    auto pixel_ids = rays.PixelIdx.ReadPortal();
-    auto colors = rays.Buffers.at(0).Buffer.ReadPortal();
-
-    // TODO: better way? we could do this in parallel if we
-    // don't check the alpha
-    partials.reserve(ray_size);
-    for(int i = 0; i < ray_size; ++i)
-    {
-      const int offset = i * 4;
-      float alpha = colors.Get(offset + 3);
-      if(alpha < 0.001f) continue;
-      VolumePartial<float> partial;
-      partial.m_pixel[0] = colors.Get(offset + 0);
-      partial.m_pixel[1] = colors.Get(offset + 1);
-      partial.m_pixel[2] = colors.Get(offset + 2);
-      partial.m_alpha = alpha;
-      partial.m_pixel_id = pixel_ids.Get(i);
-      partial.m_depth = depths.Get(i);
-      partials.push_back(std::move(partial));
+    rays_to_partials(rays, depths, partials);
+  }
+
+  //
+  // Uses the macrocell grid to find the intervals along each ray
+  // that cross visible macrocells and traces them front to back,
+  // one interval per pass. The segments are found once, and every
+  // pass only traces the rays that still have a segment left. The
+  // tracer accumulates into the ray color buffer, so empty space
+  // before, between and after the visible intervals is never
+  // sampled.
+  //
+  void leap_empty_space(vtkm::rendering::raytracing::VolumeRendererStructured &tracer,
+                        RayType &rays,
+                        std::vector<vtkm::Float32> &depths)
+  {
+    const int size = rays.NumRays;
+    const vtkm::Float32 *origin[3] = {GetVTKMPointer(rays.OriginX),
+                                      GetVTKMPointer(rays.OriginY),
+                                      GetVTKMPointer(rays.OriginZ)};
+    const vtkm::Float32 *dir[3] = {GetVTKMPointer(rays.DirX),
+                                   GetVTKMPointer(rays.DirY),
+                                   GetVTKMPointer(rays.DirZ)};
+    const vtkm::Float32 *min_dist = GetVTKMPointer(rays.MinDistance);
+    const vtkm::Float32 *max_dist = GetVTKMPointer(rays.MaxDistance);
+
+    // partials use the max distance, same as without leaping
+    depths.assign(max_dist, max_dist + size);
+
+    // gaps shorter than a few samples are not worth another pass
+    const vtkm::Float32 min_gap = 4.f * m_sample_dist;
+
+    std::vector<float> starts(static_cast<size_t>(size) * VTKH_MAX_RAY_SEGMENTS);
+    std::vector<float> ends(static_cast<size_t>(size) * VTKH_MAX_RAY_SEGMENTS);
+    std::vector<int> counts(size);
+#ifdef VTKH_USE_OPENMP
+    #pragma omp parallel for
+#endif
+    for(int i = 0; i < size; ++i)
+    {
+      const vtkm::Vec3f_32 ray_origin(origin[0][i], origin[1][i], origin[2][i]);
+      const vtkm::Vec3f_32 ray_dir(dir[0][i], dir[1][i], dir[2][i]);
+      counts[i] = m_macrocells.segments(ray_origin,
+                                        ray_dir,
+                                        min_dist[i],
+                                        max_dist[i],
+                                        min_gap,
+                                        VTKH_MAX_RAY_SEGMENTS,
+                                        &starts[i * VTKH_MAX_RAY_SEGMENTS],
+                                        &ends[i * VTKH_MAX_RAY_SEGMENTS]);
     }
+
+    for(int pass = 0; pass < VTKH_MAX_RAY_SEGMENTS; ++pass)
+    {
+      std::vector<int> ids;
+      for(int i = 0; i < size; ++i)
+      {
+        if(counts[i] > pass)
+        {
+          ids.push_back(i);
+        }
+      }
+
+      if(ids.size() == 0)
+      {
+        break;
+      }
+
+      RayType pass_rays;
+      gather_rays(rays, ids, pass_rays);
+
+      const int num_ids = static_cast<int>(ids.size());
+      vtkm::Float32 *pass_min = GetVTKMPointer(pass_rays.MinDistance);
+      vtkm::Float32 *pass_max = GetVTKMPointer(pass_rays.MaxDistance);
+#ifdef VTKH_USE_OPENMP
+      #pragma omp parallel for
+#endif
+      for(int i = 0; i < num_ids; ++i)
+      {
+        const int segment = ids[i] * VTKH_MAX_RAY_SEGMENTS + pass;
+        pass_min[i] = starts[segment];
+        pass_max[i] = ends[segment];
+      }
+
+      tracer.Render(pass_rays);
+      scatter_colors(pass_rays, ids, rays);
+    }
+  }
+};
+
+//
+// The depths of the bounds along the view direction and the
+// part of the screen (normalized device coordinates) they cover
+//
+struct ViewExtent
+{
+  vtkm::Range m_depth;
+  vtkm::Range m_x;
+  vtkm::Range m_y;
+
+  void include(const ViewExtent &other)
+  {
+    m_depth.Include(other.m_depth);
+    m_x.Include(other.m_x);
+    m_y.Include(other.m_y);
+  }
+
+  bool overlaps(const ViewExtent &other) const
+  {
+    // touching in depth is fine, fragments can't be in between
+    return m_depth.Min < other.m_depth.Max && other.m_depth.Min < m_depth.Max &&
+           m_x.Min <= other.m_x.Max && other.m_x.Min <= m_x.Max &&
+           m_y.Min <= other.m_y.Max && other.m_y.Min <= m_y.Max;
   }
 };
 
+ViewExtent view_extent(const vtkm::Matrix<vtkm::Float32, 4, 4> &projview,
+                       const vtkm::Vec3f_32 &position,
+                       const vtkm::Vec3f_32 &look,
+                       const vtkm::Bounds &bounds)
+{
+  ViewExtent extent;
+  bool behind = false;
+  for(int c = 0; c < 8; ++c)
+  {
+    vtkm::Vec4f_32 corner;
+    corner[0] = static_cast<vtkm::Float32>((c & 1) ? bounds.X.Max : bounds.X.Min);
+    corner[1] = static_cast<vtkm::Float32>((c & 2) ? bounds.Y.Max : bounds.Y.Min);
+    corner[2] = static_cast<vtkm::Float32>((c & 4) ? bounds.Z.Max : bounds.Z.Min);
+    corner[3] = 1.f;
+
+    const vtkm::Vec3f_32 to_corner(corner[0] - position[0],
+                                   corner[1] - position[1],
+                                   corner[2] - position[2]);
+    extent.m_depth.Include(vtkm::Dot(to_corner, look));
+
+    const vtkm::Vec4f_32 p = vtkm::MatrixMultiply(projview, corner);
+    if(p[3] <= 0.f)
+    {
+      behind = true;
+      continue;
+    }
+    extent.m_x.Include(p[0] / p[3]);
+    extent.m_y.Include(p[1] / p[3]);
+  }
+
+  if(behind)
+  {
+    // can't project it, so it could cover the whole screen
+    const vtkm::Range all(vtkm::NegativeInfinity64(), vtkm::Infinity64());
+    extent.m_x = all;
+    extent.m_y = all;
+  }
+  return extent;
+}
+
 void partials_to_canvas(std::vector<VolumePartial<float>> &partials,
                         const vtkm::rendering::Camera &camera,
                         vtkm::rendering::CanvasRayTracer &canvas)
@@ -339,8 +897,8 @@ void partials_to_canvas(std::vector<VolumePartial<float>> &partials,
   }
 
   const int size = partials.size();
-  auto colors = canvas.GetColorBuffer().WritePortal();
-  auto depths = canvas.GetDepthBuffer().WritePortal();
+  vtkm::Vec4f_32 *colors = GetVTKMPointer(canvas.GetColorBuffer());
+  vtkm::Float32 *depths = GetVTKMPointer(canvas.GetDepthBuffer());
 
 #ifdef VTKH_USE_OPENMP
   #pragma omp parallel for
@@ -374,7 +932,7 @@ void partials_to_canvas(std::vector<VolumePartial<float>> &partials,
     color[2] = partials[p].m_pixel[2];
     color[3] = partials[p].m_alpha;
 
-    vtkm::Vec4f_32 inColor = colors.Get(pixel_id);
+    const vtkm::Vec4f_32 inColor = colors[pixel_id];
     // We crafted the rendering so that all new colors are in front
     // of the colors that exist in the canvas
     // if transparency exists, all alphas have been pre-multiplied
@@ -384,8 +942,8 @@ void partials_to_canvas(std::vector<VolumePartial<float>> &partials,
     color[2] = color[2] + inColor[2] * alpha;
     color[3] = inColor[3] * alpha + color[3];
 
-    colors.Set(pixel_id, color);
-    depths.Set(pixel_id, image_depth);
+    colors[pixel_id] = color;
+    depths[pixel_id] = image_depth;
 
   }
 }
@@ -405,6 +963,13 @@ VolumeRenderer::VolumeRenderer()
   m_color_table.AddPointAlpha(.0f, .5);
   m_num_samples = 100.f;
   m_has_unstructured = false;
+  m_has_global_bounds = false;
+  m_has_global_transparent = false;
+  m_tile_memory_limit = 0;
+  m_wire_format = WIRE_EXACT;
+  m_color_map_valid = false;
+  m_color_map_modified = 0;
+  m_color_map_samples = 0;
 }
 
 VolumeRenderer::~VolumeRenderer()
@@ -443,10 +1008,23 @@ VolumeRenderer::Update()
 void VolumeRenderer::SetColorTable(const vtkm::cont::ColorTable &color_table)
 {
   m_color_table = color_table;
+  // a different table can have the same modified count
+  m_color_map_valid = false;
 }
 
 void VolumeRenderer::CorrectOpacity()
 {
+  // the corrected table only depends on the color table
+  // and the number of samples, so keep it around until
+  // one of them changes
+  const vtkm::Id modified = m_color_table.GetModifiedCount();
+  if(m_color_map_valid &&
+     m_color_map_modified == modified &&
+     m_color_map_samples == m_num_samples)
+  {
+    return;
+  }
+
   const float correction_scalar = VTKH_OPACITY_CORRECTION;
   float samples = m_num_samples;
 
@@ -463,6 +1041,13 @@ void VolumeRenderer::CorrectOpacity()
   }
 
   m_corrected_color_table = corrected;
+  m_color_map = detail::convert_table(m_corrected_color_table);
+
+  // the transparent domains depend on the color map
+  m_has_global_transparent = false;
+  m_color_map_valid = true;
+  m_color_map_modified = modified;
+  m_color_map_samples = m_num_samples;
 }
 
 void
@@ -496,6 +1081,17 @@ VolumeRenderer::RenderOneDomainPerRank()
   {
     throw Error("RenderOneDomainPerRank: this should never happend.");
   }
+
+  long long int culled_domains = 0;
+  long long int culled_cells = 0;
+  long long int transparent_domains = 0;
+
+  detail::OpacityLookup opacity;
+  opacity.build(m_color_map, m_range);
+
+  // domains that don't draw anything are ordered last
+  std::vector<int> local_transparent(num_domains, 1);
+
   for(int dom = 0; dom < num_domains; ++dom)
   {
     vtkm::cont::DataSet data_set;
@@ -513,12 +1109,28 @@ VolumeRenderer::RenderOneDomainPerRank()
 
     if(cellset.GetNumberOfCells() == 0) continue;
 
-    for(int i = 0; i < total_renders; ++i)
+    // every rank still contributes an (empty) image to
+    // the compositor, we just don't trace it
+    if(opacity.transparent(field.GetRange().ReadPortal().Get(0)))
     {
-      m_mapper->SetActiveColorTable(m_corrected_color_table);
+      transparent_domains++;
+      continue;
+    }
+    local_transparent[dom] = 0;
 
+    const vtkm::Bounds bounds = coords.GetBounds();
+    for(int i = 0; i < total_renders; ++i)
+    {
       Render::vtkmCanvas &canvas = m_renders[i].GetCanvas();
       const vtkmCamera &camera = m_renders[i].GetCamera();
+      if(CullDomain(camera, bounds, canvas.GetWidth(), canvas.GetHeight()))
+      {
+        culled_domains++;
+        culled_cells += cellset.GetNumberOfCells();
+        continue;
+      }
+
+      m_mapper->SetActiveColorTable(m_corrected_color_table);
       m_mapper->SetCanvas(&canvas);
       m_mapper->RenderCells(cellset,
                             coords,
@@ -528,6 +1140,11 @@ VolumeRenderer::RenderOneDomainPerRank()
                             m_range);
     }
   }
+  VTKH_DATA_ADD("culled_domains", culled_domains);
+  VTKH_DATA_ADD("culled_cells", culled_cells);
+  VTKH_DATA_ADD("transparent_domains", transparent_domains);
+
+  GatherTransparentDomains(local_transparent);
 
   if(m_do_composite)
   {
@@ -548,11 +1165,6 @@ VolumeRenderer::RenderMultipleDomainsPerRank()
   const int num_domains = m_wrappers.size();
   const int total_renders = static_cast<int>(m_renders.size());
 
-  vtkm::cont::ArrayHandle<vtkm::Vec4f_32> color_map
-    = detail::convert_table(this->m_corrected_color_table);
-  vtkm::cont::ArrayHandle<vtkm::Vec4f_32> color_map2
-    = detail::convert_table(this->m_color_table);
-
   // render/domain/result
   std::vector<std::vector<std::vector<VolumePartial<float>>>> render_partials;
   render_partials.resize(total_renders);
@@ -561,31 +1173,124 @@ VolumeRenderer::RenderMultipleDomainsPerRank()
     render_partials[i].resize(num_domains);
   }
 
+  //
+  // Group the renders into camera batches so that each domain
+  // is traversed once per batch instead of once per camera.
+  // The batch size is bounded by the number of pixels to keep
+  // the size of the ray buffer in check.
+  //
+  std::vector<int> batch_offsets;
+  batch_offsets.push_back(0);
+  long long int batch_pixels = 0;
+  for(int r = 0; r < total_renders; ++r)
+  {
+    long long int pixels = static_cast<long long int>(m_renders[r].GetWidth()) *
+                           static_cast<long long int>(m_renders[r].GetHeight());
+    if(batch_pixels > 0 && batch_pixels + pixels > VTKH_MAX_BATCH_PIXELS)
+    {
+      batch_offsets.push_back(r);
+      batch_pixels = 0;
+    }
+    batch_pixels += pixels;
+  }
+  batch_offsets.push_back(total_renders);
+  const int num_batches = static_cast<int>(batch_offsets.size()) - 1;
+
+  // culling counts are per domain and camera
+  long long int culled_domains = 0;
+  long long int culled_cells = 0;
+  long long int transparent_domains = 0;
+
+  detail::OpacityLookup opacity;
+  opacity.build(m_color_map, m_range);
+
+  std::vector<int> active_domains;
+  // domains without cells have no wrapper and draw nothing
+  std::vector<int> local_transparent(m_input->GetNumberOfDomains(), 1);
   for(int i = 0; i < num_domains; ++i)
   {
     detail::VolumeWrapper *wrapper = m_wrappers[i];
     wrapper->sample_distance(m_sample_dist);
-    wrapper->color_map(color_map);
+    wrapper->color_map(m_color_map);
     wrapper->field(m_field_name);
     wrapper->scalar_range(m_range);
 
-    for(int r = 0; r < total_renders; ++r)
+    // domains that are completely transparent produce no
+    // partials, so they drop out of compositing as well
+    if(wrapper->transparent(opacity))
     {
-      Render::vtkmCanvas &canvas = m_renders[r].GetCanvas();
-      const vtkmCamera &camera = m_renders[r].GetCamera();
-      wrapper->render(camera, canvas, render_partials[r][i]);
+      transparent_domains++;
+      continue;
     }
+    active_domains.push_back(i);
+    local_transparent[wrapper->domain_index()] = 0;
+  }
+  VTKH_DATA_ADD("transparent_domains", transparent_domains);
+
+  // transparent domains are left out of the visibility ordering
+  GatherTransparentDomains(local_transparent);
+
+  if(m_tile_memory_limit > 0)
+  {
+    RenderTiles(active_domains);
+    return;
   }
 
+  for(const int &i : active_domains)
+  {
+    detail::VolumeWrapper *wrapper = m_wrappers[i];
+    for(int b = 0; b < num_batches; ++b)
+    {
+      std::vector<vtkmCamera> cameras;
+      std::vector<Render::vtkmCanvas*> canvases;
+      std::vector<std::vector<VolumePartial<float>>*> partials;
+      for(int r = batch_offsets[b]; r < batch_offsets[b + 1]; ++r)
+      {
+        Render::vtkmCanvas &canvas = m_renders[r].GetCanvas();
+        if(CullDomain(m_renders[r].GetCamera(),
+                      wrapper->ray_bounds(),
+                      canvas.GetWidth(),
+                      canvas.GetHeight()))
+        {
+          culled_domains++;
+          culled_cells += wrapper->num_cells();
+          continue;
+        }
+        cameras.push_back(m_renders[r].GetCamera());
+        canvases.push_back(&canvas);
+        partials.push_back(&render_partials[r][i]);
+      }
+
+      if(cameras.size() > 0)
+      {
+        wrapper->render(cameras, canvases, partials);
+      }
+    }
+  }
+  VTKH_DATA_ADD("camera_batches", num_batches);
+  VTKH_DATA_ADD("culled_domains", culled_domains);
+  VTKH_DATA_ADD("culled_cells", culled_cells);
+
   PartialCompositor<VolumePartial<float>> compositor;
+  compositor.set_wire_format(m_wire_format);
 #ifdef VTKH_PARALLEL
   compositor.set_comm_handle(GetMPICommHandle());
 #endif
+
+  // we only need the ordering to find out which local
+  // domains can be composited before the global exchange
+  FindVisibilityOrdering();
+
   // composite
+  long long int composite_runs = 0;
   for(int r = 0; r < total_renders; ++r)
   {
+    std::vector<std::vector<VolumePartial<float>>> run_partials;
+    PreComposite(compositor, r, render_partials[r], run_partials);
+    composite_runs += run_partials.size();
+
     std::vector<VolumePartial<float>> res;
-    compositor.composite(render_partials[r],res);
+    compositor.composite(run_partials,res);
     if(vtkh::GetMPIRank() == 0)
     {
       detail::partials_to_canvas(res,
@@ -594,6 +1299,236 @@ VolumeRenderer::RenderMultipleDomainsPerRank()
     }
   }
 
+  VTKH_DATA_ADD("composite_runs", composite_runs);
+}
+
+void
+VolumeRenderer::RenderTiles(const std::vector<int> &active_domains)
+{
+  //
+  // Renders and composites each image in bands of rows so that
+  // only the partials of one band exist at any time. The number
+  // of bands is picked so that the estimated partial memory of
+  // a band stays under the limit, and all ranks use the same
+  // bands since every band is composited separately.
+  //
+  const int num_domains = static_cast<int>(m_wrappers.size());
+  const int total_renders = static_cast<int>(m_renders.size());
+  const long long int num_active = std::max(static_cast<long long int>(active_domains.size()), 1ll);
+
+  PartialCompositor<VolumePartial<float>> compositor;
+  compositor.set_wire_format(m_wire_format);
+#ifdef VTKH_PARALLEL
+  compositor.set_comm_handle(GetMPICommHandle());
+  MPI_Comm comm = MPI_Comm_f2c(vtkh::GetMPICommHandle());
+#endif
+
+  FindVisibilityOrdering();
+
+  long long int culled_domains = 0;
+  long long int culled_cells = 0;
+  long long int composite_runs = 0;
+  int max_tiles = 0;
+
+  for(int r = 0; r < total_renders; ++r)
+  {
+    Render::vtkmCanvas &canvas = m_renders[r].GetCanvas();
+    const vtkmCamera &camera = m_renders[r].GetCamera();
+    const int width = canvas.GetWidth();
+    const int height = canvas.GetHeight();
+    if(camera.GetMode() != vtkm::rendering::Camera::MODE_3D)
+    {
+      throw Error("Volume rendering tiles need a 3D camera");
+    }
+
+    // the partials are copied while merging and exchanging,
+    // so we count each one a few times. Each domain also has
+    // the rays of the band while it is traced.
+    const long long int pixels = static_cast<long long int>(width) * height;
+    const long long int bytes = pixels * num_active * sizeof(VolumePartial<float>) *
+                                VTKH_PARTIAL_COPIES +
+                                pixels * VTKH_RAY_BYTES;
+    int num_tiles = static_cast<int>((bytes + m_tile_memory_limit - 1) / m_tile_memory_limit);
+#ifdef VTKH_PARALLEL
+    int local_tiles = num_tiles;
+    MPI_Allreduce(&local_tiles, &num_tiles, 1, MPI_INT, MPI_MAX, comm);
+#endif
+    num_tiles = std::min(std::max(num_tiles, 1), height);
+    max_tiles = std::max(max_tiles, num_tiles);
+
+    std::vector<int> visible_domains;
+    for(const int &i : active_domains)
+    {
+      detail::VolumeWrapper *wrapper = m_wrappers[i];
+      if(CullDomain(camera, wrapper->ray_bounds(), width, height))
+      {
+        culled_domains++;
+        culled_cells += wrapper->num_cells();
+        continue;
+      }
+      visible_domains.push_back(i);
+    }
+
+    for(int t = 0; t < num_tiles; ++t)
+    {
+      const vtkm::Id row_begin = static_cast<vtkm::Id>(height) * t / num_tiles;
+      const vtkm::Id row_end = static_cast<vtkm::Id>(height) * (t + 1) / num_tiles;
+
+      std::vector<std::vector<VolumePartial<float>>> domain_partials;
+      domain_partials.resize(num_domains);
+      for(const int &i : visible_domains)
+      {
+        m_wrappers[i]->render_tile(camera,
+                                   canvas,
+                                   row_begin,
+                                   row_end,
+                                   domain_partials[i]);
+      }
+
+      std::vector<std::vector<VolumePartial<float>>> run_partials;
+      PreComposite(compositor, r, domain_partials, run_partials);
+      composite_runs += run_partials.size();
+
+      std::vector<VolumePartial<float>> res;
+      compositor.composite(run_partials, res);
+      if(vtkh::GetMPIRank() == 0)
+      {
+        detail::partials_to_canvas(res, camera, canvas);
+      }
+    }
+  }
+
+  VTKH_DATA_ADD("tiles", max_tiles);
+  VTKH_DATA_ADD("culled_domains", culled_domains);
+  VTKH_DATA_ADD("culled_cells", culled_cells);
+  VTKH_DATA_ADD("composite_runs", composite_runs);
+}
+
+void
+VolumeRenderer::PreComposite(PartialCompositor<VolumePartial<float>> &compositor,
+                             const int render,
+                             std::vector<std::vector<VolumePartial<float>>> &domain_partials,
+                             std::vector<std::vector<VolumePartial<float>>> &run_partials)
+{
+  //
+  // Local domains are blended here so that only one set of partials
+  // per run goes into the global exchange. Blending leaves a single
+  // fragment per pixel, which is only correct if no fragment of
+  // another rank can be between the domains of a run. So a run only
+  // grows while it does not overlap any domain of another rank that
+  // draws something, both in depth along the view direction and on
+  // the screen. Runs are built in visibility order.
+  //
+  const vtkmCamera &camera = m_renders[render].GetCamera();
+  const std::vector<int> &vis_order = m_visibility_orders[render];
+  const int width = m_renders[render].GetWidth();
+  const int height = m_renders[render].GetHeight();
+  vtkm::Matrix<vtkm::Float32, 4, 4> projview =
+    vtkm::MatrixMultiply(camera.CreateProjectionMatrix(width, height),
+                         camera.CreateViewMatrix());
+  const vtkm::Vec3f_32 position = camera.GetPosition();
+  vtkm::Vec3f_32 look = camera.GetLookAt() - position;
+  vtkm::Normalize(look);
+
+#ifdef VTKH_PARALLEL
+  const int rank = vtkh::GetMPIRank();
+#else
+  const int rank = 0;
+#endif
+  const int num_ranks = static_cast<int>(m_domain_counts.size());
+
+  std::vector<detail::ViewExtent> remote_extents;
+  for(int i = 0; i < num_ranks; ++i)
+  {
+    if(i == rank)
+    {
+      continue;
+    }
+    for(int c = 0; c < m_domain_counts[i]; ++c)
+    {
+      const int index = m_domain_offsets[i] + c;
+      const vtkm::Bounds &bounds = m_global_domain_bounds[index];
+      const bool transparent = m_has_global_transparent && m_global_transparent[index] != 0;
+      if(transparent || CullDomain(camera, bounds, width, height))
+      {
+        continue;
+      }
+      remote_extents.push_back(detail::view_extent(projview, position, look, bounds));
+    }
+  }
+  const int num_remote = static_cast<int>(remote_extents.size());
+
+  // only the domains that produced partials take part
+  const int num_domains = static_cast<int>(vis_order.size());
+  std::vector<int> sorted_domains;
+  const int num_wrappers = static_cast<int>(m_wrappers.size());
+  for(int i = 0; i < num_wrappers; ++i)
+  {
+    if(domain_partials[i].size() != 0)
+    {
+      sorted_domains.push_back(m_wrappers[i]->domain_index());
+    }
+  }
+  std::sort(sorted_domains.begin(), sorted_domains.end(),
+            [&vis_order](const int &lhs, const int &rhs)
+            {
+              return vis_order[lhs] < vis_order[rhs];
+            });
+
+  std::vector<int> domain_runs(num_domains, -1);
+  int num_runs = 0;
+  detail::ViewExtent run_extent;
+  const int num_sorted = static_cast<int>(sorted_domains.size());
+  for(int i = 0; i < num_sorted; ++i)
+  {
+    const int dom = sorted_domains[i];
+    const detail::ViewExtent extent =
+      detail::view_extent(projview, position, look, m_input->GetDomainBounds(dom));
+
+    bool merge = i > 0;
+    detail::ViewExtent merged = run_extent;
+    if(merge)
+    {
+      merged.include(extent);
+      for(int r = 0; r < num_remote && merge; ++r)
+      {
+        merge = !merged.overlaps(remote_extents[r]);
+      }
+    }
+
+    if(merge)
+    {
+      run_extent = merged;
+    }
+    else
+    {
+      if(i > 0)
+      {
+        num_runs++;
+      }
+      run_extent = extent;
+    }
+    domain_runs[dom] = num_runs;
+  }
+  num_runs = num_sorted > 0 ? num_runs + 1 : 0;
+
+  std::vector<std::vector<std::vector<VolumePartial<float>>>> runs;
+  runs.resize(num_runs);
+  for(int i = 0; i < num_wrappers; ++i)
+  {
+    if(domain_partials[i].size() == 0)
+    {
+      continue;
+    }
+    const int run = domain_runs[m_wrappers[i]->domain_index()];
+    runs[run].push_back(std::move(domain_partials[i]));
+  }
+
+  for(int i = 0; i < num_runs; ++i)
+  {
+    run_partials.emplace_back();
+    compositor.composite_local(runs[i], run_partials.back());
+  }
 }
 
 void
@@ -628,6 +1563,22 @@ VolumeRenderer::SetNumberOfSamples(const int num_samples)
   m_num_samples = num_samples;
 }
 
+void
+VolumeRenderer::SetTileMemoryLimit(const long long int bytes)
+{
+  if(bytes < 0)
+  {
+    throw Error("Volume rendering tile memory limit must not be negative");
+  }
+  m_tile_memory_limit = bytes;
+}
+
+void
+VolumeRenderer::SetWireFormat(const PartialWireFormat format)
+{
+  m_wire_format = format;
+}
+
 Renderer::vtkmCanvasPtr
 VolumeRenderer::GetNewCanvas(int width, int height)
 {
@@ -688,146 +1639,166 @@ VolumeRenderer::Composite(const int &num_images)
 }
 
 void
-VolumeRenderer::DepthSort(int num_domains,
-                          std::vector<float> &min_depths,
-                          std::vector<int> &local_vis_order)
+VolumeRenderer::GatherDomainBounds()
 {
-  if(min_depths.size() != num_domains)
-  {
-    throw Error("min depths size does not equal the number of domains");
-  }
-  if(local_vis_order.size() != num_domains)
+  const int num_domains = static_cast<int>(m_input->GetNumberOfDomains());
+  std::vector<double> local_bounds;
+  local_bounds.resize(num_domains * 6);
+  for(int dom = 0; dom < num_domains; ++dom)
   {
-    throw Error("local vis order not equal to number of domains");
+    vtkm::Bounds bounds = this->m_input->GetDomainBounds(dom);
+    local_bounds[dom * 6 + 0] = bounds.X.Min;
+    local_bounds[dom * 6 + 1] = bounds.X.Max;
+    local_bounds[dom * 6 + 2] = bounds.Y.Min;
+    local_bounds[dom * 6 + 3] = bounds.Y.Max;
+    local_bounds[dom * 6 + 4] = bounds.Z.Min;
+    local_bounds[dom * 6 + 5] = bounds.Z.Max;
   }
+
+  std::vector<double> global_bounds;
 #ifdef VTKH_PARALLEL
-  int root = 0;
   MPI_Comm comm = MPI_Comm_f2c(vtkh::GetMPICommHandle());
-  int num_ranks = vtkh::GetMPISize();
-  int rank = vtkh::GetMPIRank();
-  int *domain_counts = NULL;
-  int *domain_offsets = NULL;
-  int *vis_order = NULL;
-  float *depths = NULL;
-
-  if(rank == root)
+  const int num_ranks = vtkh::GetMPISize();
+  m_domain_counts.resize(num_ranks);
+  m_domain_offsets.resize(num_ranks);
+
+  MPI_Allgather(&num_domains,
+                1,
+                MPI_INT,
+                &m_domain_counts[0],
+                1,
+                MPI_INT,
+                comm);
+
+  std::vector<int> value_counts(num_ranks);
+  std::vector<int> value_offsets(num_ranks);
+  int total_domains = 0;
+  for(int i = 0; i < num_ranks; ++i)
   {
-    domain_counts = new int[num_ranks];
-    domain_offsets = new int[num_ranks];
+    m_domain_offsets[i] = total_domains;
+    total_domains += m_domain_counts[i];
+    value_counts[i] = m_domain_counts[i] * 6;
+    value_offsets[i] = m_domain_offsets[i] * 6;
   }
 
-  MPI_Gather(&num_domains,
-             1,
-             MPI_INT,
-             domain_counts,
-             1,
-             MPI_INT,
-            root,
-             comm);
+  global_bounds.resize(total_domains * 6);
+  MPI_Allgatherv(local_bounds.data(),
+                 num_domains * 6,
+                 MPI_DOUBLE,
+                 global_bounds.data(),
+                 &value_counts[0],
+                 &value_offsets[0],
+                 MPI_DOUBLE,
+                 comm);
+#else
+  m_domain_counts.resize(1);
+  m_domain_offsets.resize(1);
+  m_domain_counts[0] = num_domains;
+  m_domain_offsets[0] = 0;
+  global_bounds = local_bounds;
+#endif
 
-  int depths_size = 0;
-  if(rank == root)
+  const int total = static_cast<int>(global_bounds.size()) / 6;
+  m_global_domain_bounds.resize(total);
+  for(int i = 0; i < total; ++i)
   {
-    //scan for dispacements
-    domain_offsets[0] = 0;
-    for(int i = 1; i < num_ranks; ++i)
-    {
-      domain_offsets[i] = domain_offsets[i - 1] + domain_counts[i - 1];
-    }
-
-    for(int i = 0; i < num_ranks; ++i)
-    {
-      depths_size += domain_counts[i];
-    }
-
-    depths = new float[depths_size];
-
+    const double *b = &global_bounds[i * 6];
+    m_global_domain_bounds[i] = vtkm::Bounds(b[0], b[1], b[2], b[3], b[4], b[5]);
   }
+  m_has_global_bounds = true;
+}
 
-  MPI_Gatherv(&min_depths[0],
-              num_domains,
-              MPI_FLOAT,
-              depths,
-              domain_counts,
-              domain_offsets,
-              MPI_FLOAT,
-              root,
-              comm);
-
-  if(rank == root)
+void
+VolumeRenderer::GatherTransparentDomains(const std::vector<int> &local_transparent)
+{
+  //
+  // The flags only change with the input, the color map, the
+  // field or the range, which are the same on every rank, so all
+  // ranks agree on when to exchange them
+  //
+  if(m_has_global_transparent &&
+     m_transparent_range == m_range &&
+     m_transparent_field == m_field_name)
   {
-    std::vector<detail::VisOrdering> order;
-    order.resize(depths_size);
-
-    for(int i = 0; i < num_ranks; ++i)
-    {
-      for(int c = 0; c < domain_counts[i]; ++c)
-      {
-        int index = domain_offsets[i] + c;
-        order[index].m_rank = i;
-        order[index].m_domain_index = c;
-        order[index].m_minz = depths[index];
-      }
-    }
-
-    std::sort(order.begin(), order.end(), detail::DepthOrder());
-
-    for(int i = 0; i < depths_size; ++i)
-    {
-      order[i].m_order = i;
-    }
-
-    std::sort(order.begin(), order.end(), detail::RankOrder());
-
-    vis_order = new int[depths_size];
-    for(int i = 0; i < depths_size; ++i)
-    {
-      vis_order[i] = order[i].m_order;
-    }
+    return;
   }
 
-  MPI_Scatterv(vis_order,
-               domain_counts,
-               domain_offsets,
-               MPI_INT,
-               &local_vis_order[0],
-               num_domains,
-               MPI_INT,
-               root,
-               comm);
-
-  if(rank == root)
+  if(!m_has_global_bounds)
   {
-    delete[] domain_counts;
-    delete[] domain_offsets;
-    delete[] vis_order;
-    delete[] depths;
+    GatherDomainBounds();
   }
+
+#ifdef VTKH_PARALLEL
+  MPI_Comm comm = MPI_Comm_f2c(vtkh::GetMPICommHandle());
+  const int num_ranks = static_cast<int>(m_domain_counts.size());
+  const int total_domains = m_domain_offsets[num_ranks - 1] + m_domain_counts[num_ranks - 1];
+  m_global_transparent.resize(total_domains);
+  const int num_domains = static_cast<int>(local_transparent.size());
+  MPI_Allgatherv(const_cast<int*>(local_transparent.data()),
+                 num_domains,
+                 MPI_INT,
+                 m_global_transparent.data(),
+                 &m_domain_counts[0],
+                 &m_domain_offsets[0],
+                 MPI_INT,
+                 comm);
 #else
+  m_global_transparent = local_transparent;
+#endif
+
+  m_has_global_transparent = true;
+  m_transparent_range = m_range;
+  m_transparent_field = m_field_name;
+}
+
+void
+VolumeRenderer::DepthSort(const std::vector<float> &min_depths,
+                          const std::vector<int> &skip,
+                          std::vector<int> &local_vis_order)
+{
+  //
+  // Every rank has the depths of all domains, so every rank
+  // sorts the full list and keeps the orders of its own domains.
+  // The sort is deterministic, so all ranks agree.
+  //
+  const int num_ranks = static_cast<int>(m_domain_counts.size());
+  const int total_domains = static_cast<int>(min_depths.size());
 
   std::vector<detail::VisOrdering> order;
-  order.resize(num_domains);
+  order.resize(total_domains);
 
-  for(int i = 0; i < num_domains; ++i)
+  for(int i = 0; i < num_ranks; ++i)
   {
-      order[i].m_rank = 0;
-      order[i].m_domain_index = i;
-      order[i].m_minz = min_depths[i];
+    for(int c = 0; c < m_domain_counts[i]; ++c)
+    {
+      int index = m_domain_offsets[i] + c;
+      order[index].m_rank = i;
+      order[index].m_domain_index = c;
+      order[index].m_minz = min_depths[index];
+      order[index].m_skip = skip[index];
+    }
   }
+
   std::sort(order.begin(), order.end(), detail::DepthOrder());
 
-  for(int i = 0; i < num_domains; ++i)
+#ifdef VTKH_PARALLEL
+  const int rank = vtkh::GetMPIRank();
+#else
+  const int rank = 0;
+#endif
+  const int num_domains = m_domain_counts[rank];
+  if(local_vis_order.size() != num_domains)
   {
-    order[i].m_order = i;
+    throw Error("local vis order not equal to number of domains");
   }
 
-  std::sort(order.begin(), order.end(), detail::RankOrder());
-
-  for(int i = 0; i < num_domains; ++i)
+  for(int i = 0; i < total_domains; ++i)
   {
-    local_vis_order[i] = order[i].m_order;
+    if(order[i].m_rank == rank)
+    {
+      local_vis_order[order[i].m_domain_index] = i;
+    }
   }
-#endif
 }
 
 void
@@ -849,19 +1820,39 @@ VolumeRenderer::FindVisibilityOrdering()
   // take the minimum z value. Then sort them while keeping
   // track of rank, then pass the list in.
   //
+  // The domain bounds are only exchanged once per input, after
+  // that the orderings for all cameras are computed locally.
+  //
+  if(!m_has_global_bounds)
+  {
+    GatherDomainBounds();
+  }
+
+  const int total_domains = static_cast<int>(m_global_domain_bounds.size());
   std::vector<float> min_depths;
-  min_depths.resize(num_domains);
+  min_depths.resize(total_domains);
+
+  // Transparent domains and domains the camera can't see draw
+  // nothing, so they are ordered after all others. Otherwise a
+  // remote domain that draws nothing can end up between two local
+  // domains and keep them from being composited together.
+  std::vector<int> skip;
+  skip.resize(total_domains);
 
   for(int i = 0; i < num_cameras; ++i)
   {
     const vtkm::rendering::Camera &camera = m_renders[i].GetCamera();
-    for(int dom = 0; dom < num_domains; ++dom)
+    const int width = m_renders[i].GetWidth();
+    const int height = m_renders[i].GetHeight();
+    for(int dom = 0; dom < total_domains; ++dom)
     {
-      vtkm::Bounds bounds = this->m_input->GetDomainBounds(dom);
-      min_depths[dom] = FindMinDepth(camera, bounds);
+      min_depths[dom] = FindMinDepth(camera, m_global_domain_bounds[dom]);
+      const bool transparent = m_has_global_transparent && m_global_transparent[dom] != 0;
+      skip[dom] = transparent ||
+                  CullDomain(camera, m_global_domain_bounds[dom], width, height) ? 1 : 0;
     }
 
-    DepthSort(num_domains, min_depths, m_visibility_orders[i]);
+    DepthSort(min_depths, skip, m_visibility_orders[i]);
 
   } // for each camera
 }
@@ -869,6 +1860,8 @@ void VolumeRenderer::SetInput(DataSet *input)
 {
   Filter::SetInput(input);
   ClearWrappers();
+  m_has_global_bounds = false;
+  m_has_global_transparent = false;
 
   int num_domains = static_cast<int>(m_input->GetNumberOfDomains());
   m_has_unstructured = false;
@@ -896,12 +1889,12 @@ void VolumeRenderer::SetInput(DataSet *input)
 
     if(structured)
     {
-      m_wrappers.push_back(new detail::StructuredWrapper(data_set));
+      m_wrappers.push_back(new detail::StructuredWrapper(data_set, dom));
     }
     else
     {
       m_has_unstructured = true;
-      m_wrappers.push_back(new detail::UnstructuredWrapper(data_set));
+      m_wrappers.push_back(new detail::UnstructuredWrapper(data_set, dom));
     }
   }
 }
@@ -922,4 +1915,11 @@ VolumeRenderer::GetName() const
   return "vtkh::VolumeRenderer";
 }
 
+void
+VolumeRenderer::AddToFingerprint(Fingerprint &fingerprint) const
+{
+  fingerprint.AddValue(m_num_samples);
+  fingerprint.AddValue(static_cast<int>(m_wire_format));
+}
+
 } // namespace vtkh
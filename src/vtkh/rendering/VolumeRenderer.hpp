@@ -3,6 +3,7 @@
 
 #include <vtkh/vtkh_exports.h>
 #include <vtkh/rendering/Renderer.hpp>
+#include <vtkh/compositing/PartialCompositor.hpp>
 #include <vtkm/rendering/MapperVolume.h>
 
 namespace vtkh {
@@ -19,6 +20,14 @@ public:
   virtual ~VolumeRenderer();
   std::string GetName() const override;
   void SetNumberOfSamples(const int num_samples);
+  // Render and composite the image in bands of rows so that the
+  // partial composites of a band fit in roughly 'bytes' of memory.
+  // A value of zero (the default) renders the whole image at once.
+  void SetTileMemoryLimit(const long long int bytes);
+  // How partial composites are sent between ranks. The default,
+  // WIRE_EXACT, sends them as they are. WIRE_HALF and WIRE_BYTE send
+  // less data but round the colors.
+  void SetWireFormat(const PartialWireFormat format);
   static Renderer::vtkmCanvasPtr GetNewCanvas(int width = 1024, int height = 1024);
 
   void Update() override;
@@ -28,16 +37,24 @@ public:
 protected:
   virtual void Composite(const int &num_images) override;
   virtual void PreExecute() override;
+  virtual void AddToFingerprint(Fingerprint &fingerprint) const override;
   virtual void DoExecute() override;
   virtual void PostExecute() override;
 
   void RenderOneDomainPerRank();
   void RenderMultipleDomainsPerRank();
+  void RenderTiles(const std::vector<int> &active_domains);
+  void PreComposite(PartialCompositor<VolumePartial<float>> &compositor,
+                    const int render,
+                    std::vector<std::vector<VolumePartial<float>>> &domain_partials,
+                    std::vector<std::vector<VolumePartial<float>>> &run_partials);
 
   void CorrectOpacity();
   void FindVisibilityOrdering();
-  void DepthSort(int num_domains,
-                 std::vector<float> &min_depths,
+  void GatherDomainBounds();
+  void GatherTransparentDomains(const std::vector<int> &local_transparent);
+  void DepthSort(const std::vector<float> &min_depths,
+                 const std::vector<int> &skip,
                  std::vector<int> &local_vis_order);
   float FindMinDepth(const vtkm::rendering::Camera &camera,
                      const vtkm::Bounds &bounds) const;
@@ -45,9 +62,27 @@ protected:
   int m_num_samples;
   float m_sample_dist;
   bool m_has_unstructured;
+  long long int m_tile_memory_limit;
+  PartialWireFormat m_wire_format;
   std::shared_ptr<vtkm::rendering::MapperVolume> m_tracer;
   vtkm::cont::ColorTable m_corrected_color_table;
+  // sampled corrected table and what it was built from
+  vtkm::cont::ArrayHandle<vtkm::Vec4f_32> m_color_map;
+  bool m_color_map_valid;
+  vtkm::Id m_color_map_modified;
+  int m_color_map_samples;
   std::vector<std::vector<int>> m_visibility_orders;
+  // bounds of every domain on every rank, ordered by rank
+  bool m_has_global_bounds;
+  std::vector<vtkm::Bounds> m_global_domain_bounds;
+  std::vector<int> m_domain_counts;
+  std::vector<int> m_domain_offsets;
+  // domains of every rank that are transparent under the current
+  // color map, field and range, same order as the bounds
+  bool m_has_global_transparent;
+  vtkm::Range m_transparent_range;
+  std::string m_transparent_field;
+  std::vector<int> m_global_transparent;
 
   void ClearWrappers();
   std::vector<detail::VolumeWrapper*> m_wrappers;
@@ -1980,8 +1980,12 @@ static unsigned deflateFixed(ucvector* out, size_t* bp, Hash* hash,
   return error;
 }
 
-static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t insize,
-                                 const LodePNGCompressSettings* settings)
+/*vtkh: deflates in as one part of a larger deflate stream. Only when last is
+set, the last block is marked final. Otherwise the part ends with an empty
+stored block, which pads it to a byte boundary so that independently compressed
+parts can be concatenated (the same as a zlib sync flush).*/
+static unsigned lodepng_deflatev_part(ucvector* out, const unsigned char* in, size_t insize,
+                                      const LodePNGCompressSettings* settings, unsigned last)
 {
   unsigned error = 0;
   size_t i, blocksize, numdeflateblocks;
@@ -1989,7 +1993,25 @@ static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t
   Hash hash;
 
   if(settings->btype > 2) return 61;
-  else if(settings->btype == 0) return deflateNoCompression(out, in, insize);
+  else if(settings->btype == 0)
+  {
+    if(last) return deflateNoCompression(out, in, insize);
+    /*stored blocks are byte aligned, so none of them can be final*/
+    size_t datapos = 0;
+    while(datapos < insize)
+    {
+      unsigned LEN = 65535;
+      if(insize - datapos < 65535) LEN = (unsigned)(insize - datapos);
+      unsigned NLEN = 65535 - LEN;
+      ucvector_push_back(out, (unsigned char)0);
+      ucvector_push_back(out, (unsigned char)(LEN & 255));
+      ucvector_push_back(out, (unsigned char)(LEN >> 8));
+      ucvector_push_back(out, (unsigned char)(NLEN & 255));
+      ucvector_push_back(out, (unsigned char)(NLEN >> 8));
+      for(i = 0; i != LEN; ++i) ucvector_push_back(out, in[datapos++]);
+    }
+    return 0;
+  }
   else if(settings->btype == 1) blocksize = insize;
   else /*if(settings->btype == 2)*/
   {
@@ -2007,7 +2029,7 @@ static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t
 
   for(i = 0; i != numdeflateblocks && !error; ++i)
   {
-    unsigned final = (i == numdeflateblocks - 1);
+    unsigned final = last && (i == numdeflateblocks - 1);
     size_t start = i * blocksize;
     size_t end = start + blocksize;
     if(end > insize) end = insize;
@@ -2018,6 +2040,38 @@ static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t
 
   hash_cleanup(&hash);
 
+  if(!error && !last)
+  {
+    /*empty stored block: BFINAL 0, BTYPE 00, then LEN 0 and NLEN 65535 on the next byte*/
+    addBitToStream(&bp, out, 0);
+    addBitToStream(&bp, out, 0);
+    addBitToStream(&bp, out, 0);
+    ucvector_push_back(out, (unsigned char)0);
+    ucvector_push_back(out, (unsigned char)0);
+    ucvector_push_back(out, (unsigned char)255);
+    ucvector_push_back(out, (unsigned char)255);
+  }
+
+  return error;
+}
+
+static unsigned lodepng_deflatev(ucvector* out, const unsigned char* in, size_t insize,
+                                 const LodePNGCompressSettings* settings)
+{
+  return lodepng_deflatev_part(out, in, insize, settings, 1);
+}
+
+unsigned lodepng_deflate_part(unsigned char** out, size_t* outsize,
+                              const unsigned char* in, size_t insize,
+                              const LodePNGCompressSettings* settings,
+                              unsigned last)
+{
+  unsigned error;
+  ucvector v;
+  ucvector_init_buffer(&v, *out, *outsize);
+  error = lodepng_deflatev_part(&v, in, insize, settings, last);
+  *out = v.data;
+  *outsize = v.size;
   return error;
 }
 
@@ -0,0 +1,292 @@
+#include <vtkh/utils/AsyncImageWriter.hpp>
+#include <vtkh/utils/PNGEncoder.hpp>
+#include <vtkh/utils/QOIEncoder.hpp>
+
+#include <stdio.h>
+#include <string.h>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace vtkh
+{
+
+namespace detail
+{
+
+struct ImageJob
+{
+  std::shared_ptr<const std::vector<unsigned char>> m_rgba;
+  std::vector<float> m_depths;
+  ImageFormat m_format;
+  int m_width;
+  int m_height;
+  std::vector<std::string> m_comments;
+  std::string m_file_name;
+};
+
+void write_raw(ImageJob &job)
+{
+  const std::string file_name = job.m_file_name + ".raw";
+  FILE *file = fopen(file_name.c_str(), "wb");
+  if(file == NULL)
+  {
+    std::cerr<<"Error opening raw image file: "<<file_name<<"\n";
+    return;
+  }
+
+  unsigned char header[16];
+  memcpy(header, "vtkhraw", 7);
+  header[7] = 1;
+  const int dims[2] = {job.m_width, job.m_height};
+  memcpy(header + 8, dims, sizeof(dims));
+
+  bool ok = fwrite(header, 1, 16, file) == 16;
+  const std::vector<unsigned char> &rgba = *job.m_rgba;
+  ok = ok && fwrite(&rgba[0], 1, rgba.size(), file) == rgba.size();
+  if(job.m_depths.size() != 0)
+  {
+    ok = ok && fwrite(&job.m_depths[0], sizeof(float), job.m_depths.size(), file)
+               == job.m_depths.size();
+  }
+  fclose(file);
+
+  if(!ok)
+  {
+    std::cerr<<"Error writing raw image file: "<<file_name<<"\n";
+  }
+}
+
+void write_image(ImageJob &job)
+{
+  if(job.m_format == IMAGE_QOI)
+  {
+    QOIEncoder encoder;
+    encoder.Encode(&(*job.m_rgba)[0], job.m_width, job.m_height);
+    encoder.Save(job.m_file_name + ".qoi");
+  }
+  else if(job.m_format == IMAGE_RAW)
+  {
+    write_raw(job);
+  }
+  else
+  {
+    PNGEncoder encoder;
+    encoder.Encode(&(*job.m_rgba)[0], job.m_width, job.m_height, job.m_comments);
+    encoder.Save(job.m_file_name + ".png");
+  }
+}
+
+} // namespace detail
+
+struct AsyncImageWriter::InternalsType
+{
+  std::mutex lock;
+  std::condition_variable not_empty;
+  std::condition_variable not_full;
+  std::condition_variable idle;
+  std::deque<detail::ImageJob> queue;
+  std::vector<std::thread> threads;
+  int num_threads = 2;
+  int queue_size = 8;
+  int busy = 0;
+  bool enabled = true;
+  bool stop = false;
+};
+
+AsyncImageWriter::AsyncImageWriter()
+  : m_internals(new InternalsType)
+{
+}
+
+AsyncImageWriter::~AsyncImageWriter()
+{
+  StopThreads();
+}
+
+AsyncImageWriter *
+AsyncImageWriter::Instance()
+{
+  static AsyncImageWriter writer;
+  return &writer;
+}
+
+void
+AsyncImageWriter::SetEnabled(bool enabled)
+{
+  if(!enabled)
+  {
+    Flush();
+  }
+  std::lock_guard<std::mutex> guard(m_internals->lock);
+  m_internals->enabled = enabled;
+}
+
+bool
+AsyncImageWriter::GetEnabled() const
+{
+  std::lock_guard<std::mutex> guard(m_internals->lock);
+  return m_internals->enabled;
+}
+
+void
+AsyncImageWriter::SetNumThreads(const int num_threads)
+{
+  StopThreads();
+  std::lock_guard<std::mutex> guard(m_internals->lock);
+  m_internals->num_threads = num_threads < 1 ? 1 : num_threads;
+}
+
+void
+AsyncImageWriter::SetQueueSize(const int queue_size)
+{
+  std::lock_guard<std::mutex> guard(m_internals->lock);
+  m_internals->queue_size = queue_size < 1 ? 1 : queue_size;
+  m_internals->not_full.notify_all();
+}
+
+void
+AsyncImageWriter::Write(std::vector<unsigned char> &rgba,
+                        const int width,
+                        const int height,
+                        const std::vector<std::string> &comments,
+                        const std::string &file_name)
+{
+  std::vector<float> depths;
+  Write(rgba, depths, width, height, comments, file_name, IMAGE_PNG);
+}
+
+void
+AsyncImageWriter::Write(std::vector<unsigned char> &rgba,
+                        std::vector<float> &depths,
+                        const int width,
+                        const int height,
+                        const std::vector<std::string> &comments,
+                        const std::string &file_name,
+                        const ImageFormat format)
+{
+  std::shared_ptr<std::vector<unsigned char>> owned =
+    std::make_shared<std::vector<unsigned char>>();
+  owned->swap(rgba);
+  Write(owned, depths, width, height, comments, file_name, format);
+}
+
+void
+AsyncImageWriter::Write(const std::shared_ptr<const std::vector<unsigned char>> &rgba,
+                        std::vector<float> &depths,
+                        const int width,
+                        const int height,
+                        const std::vector<std::string> &comments,
+                        const std::string &file_name,
+                        const ImageFormat format)
+{
+  detail::ImageJob job;
+  job.m_rgba = rgba;
+  job.m_depths.swap(depths);
+  job.m_format = format;
+  job.m_width = width;
+  job.m_height = height;
+  job.m_comments = comments;
+  job.m_file_name = file_name;
+
+  std::unique_lock<std::mutex> guard(m_internals->lock);
+  if(!m_internals->enabled)
+  {
+    guard.unlock();
+    detail::write_image(job);
+    return;
+  }
+
+  if(m_internals->threads.size() == 0)
+  {
+    StartThreads();
+  }
+
+  // back pressure: wait for the workers to catch up
+  m_internals->not_full.wait(guard, [this]
+  {
+    return m_internals->queue.size() < static_cast<size_t>(m_internals->queue_size);
+  });
+
+  m_internals->queue.push_back(std::move(job));
+  m_internals->not_empty.notify_one();
+}
+
+void
+AsyncImageWriter::Flush()
+{
+  std::unique_lock<std::mutex> guard(m_internals->lock);
+  m_internals->idle.wait(guard, [this]
+  {
+    return m_internals->queue.empty() && m_internals->busy == 0;
+  });
+}
+
+void
+AsyncImageWriter::StartThreads()
+{
+  // lock is held by the caller
+  for(int i = 0; i < m_internals->num_threads; ++i)
+  {
+    m_internals->threads.push_back(std::thread(&AsyncImageWriter::Work, this));
+  }
+}
+
+void
+AsyncImageWriter::StopThreads()
+{
+  {
+    std::lock_guard<std::mutex> guard(m_internals->lock);
+    m_internals->stop = true;
+    m_internals->not_empty.notify_all();
+  }
+
+  // workers drain the queue before they exit
+  for(size_t i = 0; i < m_internals->threads.size(); ++i)
+  {
+    m_internals->threads[i].join();
+  }
+
+  std::lock_guard<std::mutex> guard(m_internals->lock);
+  m_internals->threads.clear();
+  m_internals->stop = false;
+}
+
+void
+AsyncImageWriter::Work()
+{
+  while(true)
+  {
+    detail::ImageJob job;
+    {
+      std::unique_lock<std::mutex> guard(m_internals->lock);
+      m_internals->not_empty.wait(guard, [this]
+      {
+        return m_internals->stop || !m_internals->queue.empty();
+      });
+
+      if(m_internals->queue.empty())
+      {
+        return;
+      }
+
+      job = std::move(m_internals->queue.front());
+      m_internals->queue.pop_front();
+      m_internals->busy++;
+      m_internals->not_full.notify_one();
+    }
+
+    detail::write_image(job);
+
+    std::lock_guard<std::mutex> guard(m_internals->lock);
+    m_internals->busy--;
+    if(m_internals->queue.empty() && m_internals->busy == 0)
+    {
+      m_internals->idle.notify_all();
+    }
+  }
+}
+
+} //namespace vtkh
@@ -0,0 +1,86 @@
+#ifndef VTK_H_ASYNC_IMAGE_WRITER_HPP
+#define VTK_H_ASYNC_IMAGE_WRITER_HPP
+
+#include <vtkh/vtkh_exports.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace vtkh
+{
+
+//
+// IMAGE_RAW files are a 16 byte header ("vtkhraw" and a version
+// byte, then the width and height as native 32 bit ints) followed
+// by the rgba bytes and, if depths were given, the float depths.
+// Both are stored bottom row first like the canvas.
+//
+enum ImageFormat
+{
+  IMAGE_PNG,
+  IMAGE_QOI,
+  IMAGE_RAW
+};
+
+//
+// Encodes and writes images on background threads so that
+// the rendering thread only pays for handing off the pixels.
+// Images are queued in order and Write blocks while the queue
+// is full. Flush waits until every queued image is on disk.
+// When disabled, images are written before Write returns.
+//
+class VTKH_API AsyncImageWriter
+{
+public:
+  static AsyncImageWriter *Instance();
+  ~AsyncImageWriter();
+
+  void SetEnabled(bool enabled);
+  bool GetEnabled() const;
+  // number of worker threads. Takes effect when the writer is idle
+  void SetNumThreads(const int num_threads);
+  // max number of images waiting to be written
+  void SetQueueSize(const int queue_size);
+
+  // takes ownership of the rgba bytes (bottom row first)
+  void Write(std::vector<unsigned char> &rgba,
+             const int width,
+             const int height,
+             const std::vector<std::string> &comments,
+             const std::string &file_name);
+  // the file extension is added for the format. Depths
+  // are only written by IMAGE_RAW and can be empty
+  void Write(std::vector<unsigned char> &rgba,
+             std::vector<float> &depths,
+             const int width,
+             const int height,
+             const std::vector<std::string> &comments,
+             const std::string &file_name,
+             const ImageFormat format);
+  // shares the rgba bytes instead of taking them over. They must
+  // not change until the image is written
+  void Write(const std::shared_ptr<const std::vector<unsigned char>> &rgba,
+             std::vector<float> &depths,
+             const int width,
+             const int height,
+             const std::vector<std::string> &comments,
+             const std::string &file_name,
+             const ImageFormat format);
+
+  void Flush();
+private:
+  AsyncImageWriter();
+  AsyncImageWriter(const AsyncImageWriter &) = delete;
+  AsyncImageWriter& operator=(const AsyncImageWriter &) = delete;
+
+  void StartThreads();
+  void StopThreads();
+  void Work();
+
+  struct InternalsType;
+  std::shared_ptr<InternalsType> m_internals;
+};
+
+} //namespace vtkh
+
+#endif //VTK_H_ASYNC_IMAGE_WRITER_HPP
@@ -0,0 +1,112 @@
+#ifndef VTKH_HALF_FLOAT_HPP
+#define VTKH_HALF_FLOAT_HPP
+
+#include <cstdint>
+#include <cstring>
+
+namespace vtkh
+{
+
+//
+// Conversions between 32-bit floats and IEEE 754 half precision
+// floats, used to shrink data that is sent over the wire or
+// written out where 11 bits of precision are enough.
+// Values are rounded to the nearest half.
+//
+inline std::uint16_t FloatToHalf(const float value)
+{
+  std::uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+
+  const std::uint32_t sign = (bits >> 16) & 0x8000u;
+  const std::uint32_t float_exponent = (bits >> 23) & 0xffu;
+  std::uint32_t mantissa = bits & 0x7fffffu;
+
+  if(float_exponent == 0xffu)
+  {
+    // inf or nan
+    return static_cast<std::uint16_t>(sign | 0x7c00u | (mantissa != 0 ? 0x200u : 0u));
+  }
+
+  const int exponent = static_cast<int>(float_exponent) - 127 + 15;
+  if(exponent >= 31)
+  {
+    // too large, so clamp to inf
+    return static_cast<std::uint16_t>(sign | 0x7c00u);
+  }
+
+  if(exponent <= 0)
+  {
+    if(exponent < -10)
+    {
+      // too small, so flush to zero
+      return static_cast<std::uint16_t>(sign);
+    }
+    // subnormal half
+    mantissa |= 0x800000u;
+    const int shift = 14 - exponent;
+    std::uint32_t half_mantissa = mantissa >> shift;
+    if((mantissa >> (shift - 1)) & 1u)
+    {
+      half_mantissa++;
+    }
+    return static_cast<std::uint16_t>(sign | half_mantissa);
+  }
+
+  std::uint32_t half = sign |
+                       (static_cast<std::uint32_t>(exponent) << 10) |
+                       (mantissa >> 13);
+  // rounding may carry into the exponent, which is what we want
+  if(mantissa & 0x1000u)
+  {
+    half++;
+  }
+  return static_cast<std::uint16_t>(half);
+}
+
+inline float HalfToFloat(const std::uint16_t half)
+{
+  const std::uint32_t sign = static_cast<std::uint32_t>(half & 0x8000u) << 16;
+  int exponent = (half >> 10) & 0x1f;
+  std::uint32_t mantissa = half & 0x3ffu;
+  std::uint32_t bits;
+
+  if(exponent == 0)
+  {
+    if(mantissa == 0)
+    {
+      bits = sign;
+    }
+    else
+    {
+      // subnormal half, so normalize it
+      exponent = 1;
+      while((mantissa & 0x400u) == 0)
+      {
+        mantissa <<= 1;
+        exponent--;
+      }
+      mantissa &= 0x3ffu;
+      bits = sign |
+             (static_cast<std::uint32_t>(exponent + 127 - 15) << 23) |
+             (mantissa << 13);
+    }
+  }
+  else if(exponent == 31)
+  {
+    bits = sign | 0x7f800000u | (mantissa << 13);
+  }
+  else
+  {
+    bits = sign |
+           (static_cast<std::uint32_t>(exponent + 127 - 15) << 23) |
+           (mantissa << 13);
+  }
+
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+} // namespace vtkh
+#endif
@@ -2,22 +2,304 @@
 
 // standard includes
 #include <stdlib.h>
+#include <string.h>
+#include <algorithm>
 #include <iostream>
 
+#include <vtkh/Error.hpp>
+
 // thirdparty includes
 #include <lodepng.h>
 
 namespace vtkh
 {
 
+namespace detail
+{
+
+// raw bytes (before filtering) compressed by each strip
+const size_t strip_bytes = 256 * 1024;
+
+void set_compression_level(LodePNGCompressSettings &settings, const int level)
+{
+    if(level == 0)
+    {
+        settings.btype = 0;
+        return;
+    }
+
+    settings.btype = 2;
+    if(level == 1)
+    {
+        // huffman coding only
+        settings.use_lz77 = 0;
+        return;
+    }
+
+    settings.use_lz77 = 1;
+    settings.windowsize = std::min(32768, 512 << (level - 2));
+    settings.nicematch = level >= 8 ? 258 : 128;
+    settings.lazymatching = level >= 4 ? 1 : 0;
+}
+
+unsigned char zlib_flags(const int level)
+{
+    // FLEVEL bits with the header check bits of a 0x78 CMF byte
+    if(level <= 1) return 0x01;
+    if(level <= 5) return 0x5E;
+    if(level == 6) return 0x9C;
+    return 0xDA;
+}
+
+inline unsigned char paeth(const int a, const int b, const int c)
+{
+    const int p = a + b - c;
+    const int pa = abs(p - a);
+    const int pb = abs(p - b);
+    const int pc = abs(p - c);
+    if(pa <= pb && pa <= pc) return (unsigned char)a;
+    if(pb <= pc) return (unsigned char)b;
+    return (unsigned char)c;
+}
+
+inline size_t filter_cost(const unsigned char *values, const int size)
+{
+    size_t sum = 0;
+    for(int i = 0; i < size; ++i)
+    {
+        sum += values[i] < 128 ? values[i] : 255 - values[i];
+    }
+    return sum;
+}
+
+//
+// Filters one scanline with each of the five png filters and
+// keeps the one with the smallest sum of signed bytes, the same
+// heuristic lodepng uses by default. prev is NULL for the first
+// scanline and bpp is the number of bytes per pixel.
+//
+void filter_row(const unsigned char *row,
+                const unsigned char *prev,
+                const int row_bytes,
+                const int bpp,
+                unsigned char *scratch,
+                unsigned char *out)
+{
+    // none
+    out[0] = 0;
+    memcpy(out + 1, row, row_bytes);
+    size_t best_sum = 0;
+    for(int i = 0; i < row_bytes; ++i) best_sum += row[i];
+
+    for(int type = 1; type < 5; ++type)
+    {
+        if(type == 1)
+        {
+            for(int i = 0; i < bpp; ++i) scratch[i] = row[i];
+            for(int i = bpp; i < row_bytes; ++i) scratch[i] = row[i] - row[i - bpp];
+        }
+        else if(prev == NULL)
+        {
+            // without a previous scanline, up is none and paeth is sub
+            if(type != 3) continue;
+            for(int i = 0; i < bpp; ++i) scratch[i] = row[i];
+            for(int i = bpp; i < row_bytes; ++i) scratch[i] = row[i] - (row[i - bpp] >> 1);
+        }
+        else if(type == 2)
+        {
+            for(int i = 0; i < row_bytes; ++i) scratch[i] = row[i] - prev[i];
+        }
+        else if(type == 3)
+        {
+            for(int i = 0; i < bpp; ++i) scratch[i] = row[i] - (prev[i] >> 1);
+            for(int i = bpp; i < row_bytes; ++i) scratch[i] = row[i] - ((row[i - bpp] + prev[i]) >> 1);
+        }
+        else
+        {
+            for(int i = 0; i < bpp; ++i) scratch[i] = row[i] - prev[i];
+            for(int i = bpp; i < row_bytes; ++i)
+            {
+                scratch[i] = row[i] - paeth(row[i - bpp], prev[i], prev[i - bpp]);
+            }
+        }
+
+        const size_t sum = filter_cost(scratch, row_bytes);
+        if(sum < best_sum)
+        {
+            best_sum = sum;
+            out[0] = (unsigned char)type;
+            memcpy(out + 1, scratch, row_bytes);
+        }
+    }
+}
+
+const unsigned adler_base = 65521;
+
+unsigned adler32(const unsigned char *data, size_t size)
+{
+    unsigned s1 = 1;
+    unsigned s2 = 0;
+    while(size > 0)
+    {
+        // largest run that cannot overflow s2
+        size_t run = std::min(size, (size_t)5550);
+        size -= run;
+        for(size_t i = 0; i < run; ++i)
+        {
+            s1 += *data++;
+            s2 += s1;
+        }
+        s1 %= adler_base;
+        s2 %= adler_base;
+    }
+    return (s2 << 16) | s1;
+}
+
+// adler32 of two concatenated buffers, see zlib's adler32_combine
+unsigned adler32_combine(const unsigned adler1, const unsigned adler2, const size_t size2)
+{
+    const unsigned rem = (unsigned)(size2 % adler_base);
+    unsigned sum1 = adler1 & 0xffff;
+    unsigned sum2 = (unsigned)(((unsigned long long)rem * sum1) % adler_base);
+    sum1 += (adler2 & 0xffff) + adler_base - 1;
+    sum2 += (adler1 >> 16) + (adler2 >> 16) + adler_base - rem;
+    if(sum1 >= adler_base) sum1 -= adler_base;
+    if(sum1 >= adler_base) sum1 -= adler_base;
+    if(sum2 >= (adler_base << 1)) sum2 -= (adler_base << 1);
+    if(sum2 >= adler_base) sum2 -= adler_base;
+    return sum1 | (sum2 << 16);
+}
+
+inline void write_uint32(unsigned char *out, const unsigned value)
+{
+    out[0] = (unsigned char)(value >> 24);
+    out[1] = (unsigned char)(value >> 16);
+    out[2] = (unsigned char)(value >> 8);
+    out[3] = (unsigned char)value;
+}
+
+// writes the chunk around data that is already in place at out + 8
+inline size_t write_chunk(unsigned char *out, const char *type, const size_t length)
+{
+    write_uint32(out, (unsigned)length);
+    memcpy(out + 4, type, 4);
+    write_uint32(out + 8 + length, lodepng_crc32(out + 4, length + 4));
+    return length + 12;
+}
+
+// Filters and deflates rows of rgba pixels in parallel strips. prev
+// is the rgba row above the first one, NULL at the top of the image.
+// Unless the rows are the last of the image the stream is left open.
+// adler gets the adler32 of the filtered rows. On failure nothing is
+// left allocated.
+bool deflate_strips(const unsigned char *rgba,
+                    const unsigned char *prev,
+                    const int width,
+                    const int num_rows,
+                    const bool opaque,
+                    const bool last,
+                    LodePNGCompressSettings &settings,
+                    std::vector<unsigned char*> &strips,
+                    std::vector<size_t> &strip_sizes,
+                    unsigned &adler)
+{
+    const int bpp = opaque ? 3 : 4;
+    const size_t row_bytes = (size_t)width * bpp;
+    const int rows_per_strip = std::max((size_t)1, strip_bytes / std::max((size_t)1, row_bytes));
+    const int num_strips = std::max(1, (num_rows + rows_per_strip - 1) / rows_per_strip);
+
+    strips.assign(num_strips, NULL);
+    strip_sizes.assign(num_strips, 0);
+    std::vector<size_t> raw_sizes(num_strips, 0);
+    std::vector<unsigned> adlers(num_strips, 1);
+    std::vector<unsigned> errors(num_strips, 0);
+
+#ifdef VTKH_USE_OPENMP
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for(int s = 0; s < num_strips; ++s)
+    {
+        const int y_start = s * rows_per_strip;
+        const int y_end = std::min(num_rows, y_start + rows_per_strip);
+        std::vector<unsigned char> filtered((y_end - y_start) * (row_bytes + 1));
+        std::vector<unsigned char> scratch(row_bytes);
+        // the previous and current scanline in the output format
+        std::vector<unsigned char> rows(2 * row_bytes);
+        const int y_first = (y_start > 0 || prev != NULL) ? y_start - 1 : y_start;
+        for(int y = y_first; y < y_end; ++y)
+        {
+            unsigned char *row = &rows[(y & 1) * row_bytes];
+            const unsigned char *in = y < 0 ? prev : rgba + y * (size_t)width * 4;
+            if(opaque)
+            {
+                for(int x = 0; x < width; ++x)
+                {
+                    row[x * 3 + 0] = in[x * 4 + 0];
+                    row[x * 3 + 1] = in[x * 4 + 1];
+                    row[x * 3 + 2] = in[x * 4 + 2];
+                }
+            }
+            else
+            {
+                memcpy(row, in, row_bytes);
+            }
+
+            if(y < y_start) continue;
+
+            const unsigned char *above = y > y_first ? &rows[((y + 1) & 1) * row_bytes] : NULL;
+            filter_row(row,
+                       above,
+                       (int)row_bytes,
+                       bpp,
+                       &scratch[0],
+                       &filtered[(y - y_start) * (row_bytes + 1)]);
+        }
+
+        raw_sizes[s] = filtered.size();
+        adlers[s] = adler32(&filtered[0], filtered.size());
+        errors[s] = vtkh::lodepng_deflate_part(&strips[s],
+                                               &strip_sizes[s],
+                                               &filtered[0],
+                                               filtered.size(),
+                                               &settings,
+                                               last && s == num_strips - 1);
+    }
+
+    adler = adlers[0];
+    bool error = errors[0] != 0;
+    for(int s = 1; s < num_strips; ++s)
+    {
+        adler = adler32_combine(adler, adlers[s], raw_sizes[s]);
+        error = error || errors[s] != 0;
+    }
+
+    if(error)
+    {
+        for(int s = 0; s < num_strips; ++s) free(strips[s]);
+        strips.clear();
+        strip_sizes.clear();
+    }
+    return !error;
+}
+
+} // namespace detail
+
 PNGEncoder::PNGEncoder()
 :m_buffer(NULL),
- m_buffer_size(0)
+ m_buffer_size(0),
+ m_compression_level(1),
+ m_multi_threaded(true),
+ m_stream(NULL),
+ m_stream_width(0),
+ m_stream_height(0),
+ m_stream_rows(0),
+ m_stream_adler(1)
 {}
 
 PNGEncoder::~PNGEncoder()
 {
     Cleanup();
+    CloseStream();
 }
 
 void
@@ -37,25 +319,9 @@ PNGEncoder::Encode(const unsigned char *rgba_in,
                width*4);
     }
  
-    vtkh::LodePNGState state;
-    vtkh::lodepng_state_init(&state);
-    // use less aggressive compression
-    state.encoder.zlibsettings.btype = 2;
-    state.encoder.zlibsettings.use_lz77 = 0;
-
-    unsigned error = lodepng_encode(&m_buffer,
-                                    &m_buffer_size,
-                                    &rgba_flip[0],
-                                    width,
-                                    height,
-                                    &state);
+    Compress(rgba_flip, width, height, std::vector<std::string>());
 
     delete [] rgba_flip;
-
-    if(error)
-    {
-        std::cerr<<"lodepng_encode_memory failed\n";
-    }
 }
 
 void
@@ -84,25 +350,9 @@ PNGEncoder::Encode(const float *rgba_in,
             rgba_flip[outOffset + 3] = (unsigned char)(rgba_in[inOffset + 3] * 255.f);
         }
 
-    vtkh::LodePNGState state;
-    vtkh::lodepng_state_init(&state);
-    // use less aggressive compression
-    state.encoder.zlibsettings.btype = 2;
-    state.encoder.zlibsettings.use_lz77 = 0;
-
-    unsigned error = lodepng_encode(&m_buffer,
-                                    &m_buffer_size,
-                                    &rgba_flip[0],
-                                    width,
-                                    height,
-                                    &state);
+    Compress(rgba_flip, width, height, std::vector<std::string>());
 
     delete [] rgba_flip;
-
-    if(error)
-    {
-        std::cerr<<"lodepng_encode_memory failed\n";
-    }
 }
 
 void
@@ -123,40 +373,9 @@ PNGEncoder::Encode(const unsigned char *rgba_in,
                width*4);
     }
  
-    vtkh::LodePNGState state;
-    vtkh::lodepng_state_init(&state);
-    // use less aggressive compression
-    state.encoder.zlibsettings.btype = 2;
-    state.encoder.zlibsettings.use_lz77 = 0;
-    if(comments.size() % 2 != 0)
-    {
-        std::cerr<<"PNGEncoder::Encode comments missing value for the last key.\n";
-        std::cerr<<"Ignoring the last key.\n";
-    }
-    if(comments.size() > 1)
-    {
-        vtkh::lodepng_info_init(&state.info_png);
-        // Comments are in pairs with a key and a value, using
-        // comments.size()-1 ensures that we don't use the last
-        // comment if the length of the vector isn't a multiple of 2.
-        for (int i = 0; i < comments.size()-1; i += 2)
-            vtkh::lodepng_add_text(&state.info_png, comments[i].c_str(),
-                                                    comments[i+1].c_str());
-    }
-
-    unsigned error = lodepng_encode(&m_buffer,
-                                    &m_buffer_size,
-                                    &rgba_flip[0],
-                                    width,
-                                    height,
-                                    &state);
+    Compress(rgba_flip, width, height, comments);
 
     delete [] rgba_flip;
-
-    if(error)
-    {
-        std::cerr<<"lodepng_encode_memory failed\n";
-    }
 }
 
 void
@@ -186,19 +405,47 @@ PNGEncoder::Encode(const float *rgba_in,
             rgba_flip[outOffset + 3] = (unsigned char)(rgba_in[inOffset + 3] * 255.f);
         }
 
-    vtkh::LodePNGState state;
-    vtkh::lodepng_state_init(&state);
-    // use less aggressive compression
-    state.encoder.zlibsettings.btype = 2;
-    state.encoder.zlibsettings.use_lz77 = 0;
+    Compress(rgba_flip, width, height, comments);
+
+    delete [] rgba_flip;
+}
+
+void
+PNGEncoder::SetCompressionLevel(const int level)
+{
+    m_compression_level = std::max(0, std::min(9, level));
+}
+
+void
+PNGEncoder::SetMultiThreaded(bool on)
+{
+    m_multi_threaded = on;
+}
+
+void
+PNGEncoder::Compress(const unsigned char *rgba,
+                     const int width,
+                     const int height,
+                     const std::vector<std::string> &comments)
+{
     if(comments.size() % 2 != 0)
     {
         std::cerr<<"PNGEncoder::Encode comments missing value for the last key.\n";
         std::cerr<<"Ignoring the last key.\n";
     }
+
+    if(m_multi_threaded)
+    {
+        CompressStrips(rgba, width, height, comments);
+        return;
+    }
+
+    vtkh::LodePNGState state;
+    vtkh::lodepng_state_init(&state);
+    detail::set_compression_level(state.encoder.zlibsettings, m_compression_level);
     if(comments.size() > 1)
     {
-        vtkh:lodepng_info_init(&state.info_png);
+        vtkh::lodepng_info_init(&state.info_png);
         // Comments are in pairs with a key and a value, using
         // comments.size()-1 ensures that we don't use the last
         // comment if the length of the vector isn't a multiple of 2.
@@ -209,12 +456,12 @@ PNGEncoder::Encode(const float *rgba_in,
 
     unsigned error = lodepng_encode(&m_buffer,
                                     &m_buffer_size,
-                                    &rgba_flip[0],
+                                    rgba,
                                     width,
                                     height,
                                     &state);
 
-    delete [] rgba_flip;
+    vtkh::lodepng_state_cleanup(&state);
 
     if(error)
     {
@@ -222,6 +469,278 @@ PNGEncoder::Encode(const float *rgba_in,
     }
 }
 
+void
+PNGEncoder::CompressStrips(const unsigned char *rgba,
+                           const int width,
+                           const int height,
+                           const std::vector<std::string> &comments)
+{
+    // Horizontal strips are filtered and deflated independently
+    // (like pigz). Every strip but the last ends on a byte boundary,
+    // so the compressed strips form one zlib stream and each one
+    // goes into its own IDAT chunk.
+    // like lodepng, drop the alpha channel of opaque images
+    int opaque = 1;
+    const size_t num_pixels = (size_t)width * height;
+#ifdef VTKH_USE_OPENMP
+    #pragma omp parallel for reduction(&&:opaque)
+#endif
+    for(size_t i = 0; i < num_pixels; ++i)
+    {
+        opaque = opaque && rgba[i * 4 + 3] == 255;
+    }
+
+    LodePNGCompressSettings settings;
+    vtkh::lodepng_compress_settings_init(&settings);
+    detail::set_compression_level(settings, m_compression_level);
+
+    std::vector<unsigned char*> strips;
+    std::vector<size_t> strip_sizes;
+    unsigned adler = 1;
+    const bool error = !detail::deflate_strips(rgba,
+                                               NULL,
+                                               width,
+                                               height,
+                                               opaque != 0,
+                                               true,
+                                               settings,
+                                               strips,
+                                               strip_sizes,
+                                               adler);
+    const int num_strips = (int)strips.size();
+
+    if(error)
+    {
+        std::cerr<<"PNGEncoder: strip compression failed\n";
+        return;
+    }
+
+    // the zlib header goes in front of the first strip and
+    // the checksum after the last one
+    std::vector<size_t> idat_sizes(num_strips);
+    std::vector<size_t> offsets(num_strips);
+    size_t size = 8 + 25; // signature and IHDR
+    for(size_t i = 0; i + 1 < comments.size(); i += 2)
+    {
+        size += 12 + comments[i].size() + 1 + comments[i+1].size();
+    }
+    for(int s = 0; s < num_strips; ++s)
+    {
+        idat_sizes[s] = strip_sizes[s] + (s == 0 ? 2 : 0) + (s == num_strips - 1 ? 4 : 0);
+        offsets[s] = size;
+        size += 12 + idat_sizes[s];
+    }
+    size += 12; // IEND
+
+    Cleanup();
+    m_buffer = (unsigned char*)malloc(size);
+    m_buffer_size = size;
+    unsigned char *out = m_buffer;
+
+    const unsigned char signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    memcpy(out, signature, 8);
+    out += 8;
+
+    unsigned char *header = out + 8;
+    detail::write_uint32(header, (unsigned)width);
+    detail::write_uint32(header + 4, (unsigned)height);
+    header[8] = 8;  // bit depth
+    header[9] = opaque ? 2 : 6;  // RGB or RGBA
+    header[10] = 0; // deflate
+    header[11] = 0; // adaptive filtering
+    header[12] = 0; // no interlace
+    out += detail::write_chunk(out, "IHDR", 13);
+
+    for(size_t i = 0; i + 1 < comments.size(); i += 2)
+    {
+        const std::string &key = comments[i];
+        const std::string &value = comments[i+1];
+        memcpy(out + 8, key.c_str(), key.size() + 1);
+        memcpy(out + 8 + key.size() + 1, value.c_str(), value.size());
+        out += detail::write_chunk(out, "tEXt", key.size() + 1 + value.size());
+    }
+
+#ifdef VTKH_USE_OPENMP
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for(int s = 0; s < num_strips; ++s)
+    {
+        unsigned char *chunk = m_buffer + offsets[s];
+        unsigned char *data = chunk + 8;
+        if(s == 0)
+        {
+            data[0] = 0x78;
+            data[1] = detail::zlib_flags(m_compression_level);
+            data += 2;
+        }
+        memcpy(data, strips[s], strip_sizes[s]);
+        if(s == num_strips - 1)
+        {
+            detail::write_uint32(data + strip_sizes[s], adler);
+        }
+        detail::write_chunk(chunk, "IDAT", idat_sizes[s]);
+        free(strips[s]);
+    }
+
+    detail::write_chunk(m_buffer + size - 12, "IEND", 0);
+}
+
+void
+PNGEncoder::BeginStream(const std::string &filename,
+                        const int width,
+                        const int height,
+                        const std::vector<std::string> &comments)
+{
+    CloseStream();
+    m_stream = fopen(filename.c_str(), "wb");
+    if(m_stream == NULL)
+    {
+        throw Error("PNGEncoder: could not open '" + filename + "'");
+    }
+    m_stream_width = width;
+    m_stream_height = height;
+    m_stream_rows = 0;
+    m_stream_adler = 1;
+    m_stream_prev_row.clear();
+
+    // the opacity of the rows to come is unknown, so always rgba
+    std::vector<unsigned char> head(8 + 25);
+    const unsigned char signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    memcpy(&head[0], signature, 8);
+    unsigned char *header = &head[8 + 8];
+    detail::write_uint32(header, (unsigned)width);
+    detail::write_uint32(header + 4, (unsigned)height);
+    header[8] = 8;  // bit depth
+    header[9] = 6;  // RGBA
+    header[10] = 0; // deflate
+    header[11] = 0; // adaptive filtering
+    header[12] = 0; // no interlace
+    detail::write_chunk(&head[8], "IHDR", 13);
+
+    for(size_t i = 0; i + 1 < comments.size(); i += 2)
+    {
+        const std::string &key = comments[i];
+        const std::string &value = comments[i+1];
+        const size_t offset = head.size();
+        const size_t length = key.size() + 1 + value.size();
+        head.resize(offset + 12 + length);
+        memcpy(&head[offset + 8], key.c_str(), key.size() + 1);
+        memcpy(&head[offset + 8 + key.size() + 1], value.c_str(), value.size());
+        detail::write_chunk(&head[offset], "tEXt", length);
+    }
+    fwrite(&head[0], 1, head.size(), m_stream);
+}
+
+void
+PNGEncoder::StreamRows(const unsigned char *rgba_in,
+                       const int num_rows)
+{
+    if(m_stream == NULL)
+    {
+        throw Error("PNGEncoder: StreamRows called before BeginStream");
+    }
+    if(num_rows < 1 || m_stream_rows + num_rows > m_stream_height)
+    {
+        throw Error("PNGEncoder: more rows streamed than the image height");
+    }
+
+    const int width = m_stream_width;
+    const size_t row_size = (size_t)width * 4;
+    std::vector<unsigned char> rows(row_size * num_rows);
+    for(int y = 0; y < num_rows; ++y)
+    {
+        memcpy(&rows[y * row_size], rgba_in + (num_rows - y - 1) * row_size, row_size);
+    }
+
+    const bool first = m_stream_rows == 0;
+    const bool last = m_stream_rows + num_rows == m_stream_height;
+
+    LodePNGCompressSettings settings;
+    vtkh::lodepng_compress_settings_init(&settings);
+    detail::set_compression_level(settings, m_compression_level);
+
+    std::vector<unsigned char*> strips;
+    std::vector<size_t> strip_sizes;
+    unsigned adler = 1;
+    if(!detail::deflate_strips(&rows[0],
+                               first ? NULL : &m_stream_prev_row[0],
+                               width,
+                               num_rows,
+                               false,
+                               last,
+                               settings,
+                               strips,
+                               strip_sizes,
+                               adler))
+    {
+        CloseStream();
+        throw Error("PNGEncoder: strip compression failed");
+    }
+    m_stream_adler = detail::adler32_combine(m_stream_adler,
+                                             adler,
+                                             (row_size + 1) * num_rows);
+
+    // one IDAT per strip, the zlib header goes in front of the
+    // first strip of the image and the checksum after the last one
+    const int num_strips = (int)strips.size();
+    std::vector<unsigned char> chunk;
+    for(int s = 0; s < num_strips; ++s)
+    {
+        const bool head = first && s == 0;
+        const bool tail = last && s == num_strips - 1;
+        const size_t length = strip_sizes[s] + (head ? 2 : 0) + (tail ? 4 : 0);
+        chunk.resize(length + 12);
+        unsigned char *data = &chunk[8];
+        if(head)
+        {
+            data[0] = 0x78;
+            data[1] = detail::zlib_flags(m_compression_level);
+            data += 2;
+        }
+        memcpy(data, strips[s], strip_sizes[s]);
+        if(tail)
+        {
+            detail::write_uint32(data + strip_sizes[s], m_stream_adler);
+        }
+        detail::write_chunk(&chunk[0], "IDAT", length);
+        fwrite(&chunk[0], 1, chunk.size(), m_stream);
+        free(strips[s]);
+    }
+
+    m_stream_prev_row.assign(rows.end() - row_size, rows.end());
+    m_stream_rows += num_rows;
+}
+
+void
+PNGEncoder::EndStream()
+{
+    if(m_stream == NULL)
+    {
+        return;
+    }
+    if(m_stream_rows != m_stream_height)
+    {
+        CloseStream();
+        throw Error("PNGEncoder: stream ended before all rows were written");
+    }
+
+    unsigned char end[12];
+    detail::write_chunk(end, "IEND", 0);
+    fwrite(end, 1, 12, m_stream);
+    CloseStream();
+}
+
+void
+PNGEncoder::CloseStream()
+{
+    if(m_stream != NULL)
+    {
+        fclose(m_stream);
+        m_stream = NULL;
+    }
+    m_stream_prev_row.clear();
+}
+
 void
 PNGEncoder::Save(const std::string &filename)
 {
@@ -2,6 +2,7 @@
 #define VTKH_PNG_ENCODER_HPP
 
 #include <vtkh/vtkh_exports.h>
+#include <stdio.h>
 #include <string>
 #include <vector>
 
@@ -30,14 +31,54 @@ public:
                           const std::vector<std::string> &comments);
     void           Save(const std::string &filename);
 
+    // 0 stores the pixels, 1 (the default) only uses huffman
+    // coding and 2 - 9 search for matches in larger windows
+    void           SetCompressionLevel(const int level);
+    // filter and compress horizontal strips of the image in
+    // parallel (the default). Otherwise lodepng encodes the
+    // whole image on one thread.
+    void           SetMultiThreaded(bool on);
+
+    // Writes an rgba image into a file one band of rows at a time,
+    // so the whole image never has to be in memory. Bands go from
+    // the top of the image to the bottom, and the rows of each band
+    // are bottom row first like the other Encode calls.
+    void           BeginStream(const std::string &filename,
+                               const int width,
+                               const int height,
+                               const std::vector<std::string> &comments);
+    void           StreamRows(const unsigned char *rgba_in,
+                              const int num_rows);
+    void           EndStream();
+
     void          *PngBuffer();
     size_t         PngBufferSize();
 
     void           Cleanup();
 
 private:
+    void           Compress(const unsigned char *rgba,
+                            const int width,
+                            const int height,
+                            const std::vector<std::string> &comments);
+    void           CompressStrips(const unsigned char *rgba,
+                                  const int width,
+                                  const int height,
+                                  const std::vector<std::string> &comments);
+
+    void           CloseStream();
+
     unsigned char *m_buffer;
     size_t         m_buffer_size;
+    int            m_compression_level;
+    bool           m_multi_threaded;
+
+    FILE                      *m_stream;
+    int                        m_stream_width;
+    int                        m_stream_height;
+    int                        m_stream_rows;
+    unsigned                   m_stream_adler;
+    std::vector<unsigned char> m_stream_prev_row;
 };
 
 } // namespace vtkh
@@ -0,0 +1,258 @@
+#include "QOIEncoder.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+
+namespace vtkh
+{
+
+namespace detail
+{
+
+const unsigned char qoi_op_index = 0x00;
+const unsigned char qoi_op_diff  = 0x40;
+const unsigned char qoi_op_luma  = 0x80;
+const unsigned char qoi_op_run   = 0xc0;
+const unsigned char qoi_op_rgb   = 0xfe;
+const unsigned char qoi_op_rgba  = 0xff;
+const unsigned char qoi_mask     = 0xc0;
+const unsigned char qoi_padding[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+const size_t qoi_header_size = 14;
+
+inline int qoi_hash(const unsigned char *px)
+{
+    return (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64;
+}
+
+inline void qoi_write_uint32(unsigned char *out, const unsigned value)
+{
+    out[0] = (unsigned char)(value >> 24);
+    out[1] = (unsigned char)(value >> 16);
+    out[2] = (unsigned char)(value >> 8);
+    out[3] = (unsigned char)value;
+}
+
+inline unsigned qoi_read_uint32(const unsigned char *in)
+{
+    return ((unsigned)in[0] << 24) | ((unsigned)in[1] << 16) |
+           ((unsigned)in[2] << 8) | (unsigned)in[3];
+}
+
+} // namespace detail
+
+QOIEncoder::QOIEncoder()
+{}
+
+QOIEncoder::~QOIEncoder()
+{}
+
+void
+QOIEncoder::Encode(const unsigned char *rgba_in,
+                   const int width,
+                   const int height)
+{
+    // worst case is a tag byte plus four bytes per pixel
+    m_buffer.resize(detail::qoi_header_size + (size_t)width * height * 5 + 8);
+    unsigned char *out = &m_buffer[0];
+
+    memcpy(out, "qoif", 4);
+    detail::qoi_write_uint32(out + 4, (unsigned)width);
+    detail::qoi_write_uint32(out + 8, (unsigned)height);
+    out[12] = 4; // channels
+    out[13] = 0; // sRGB with linear alpha
+    size_t pos = detail::qoi_header_size;
+
+    unsigned char index[64 * 4];
+    memset(index, 0, sizeof(index));
+    unsigned char prev[4] = {0, 0, 0, 255};
+    int run = 0;
+
+    for(int y = 0; y < height; ++y)
+    {
+        // qoi is top row first
+        const unsigned char *row = rgba_in + (size_t)(height - y - 1) * width * 4;
+        for(int x = 0; x < width; ++x)
+        {
+            const unsigned char *px = row + x * 4;
+            if(memcmp(px, prev, 4) == 0)
+            {
+                run++;
+                if(run == 62)
+                {
+                    out[pos++] = detail::qoi_op_run | (run - 1);
+                    run = 0;
+                }
+                continue;
+            }
+
+            if(run > 0)
+            {
+                out[pos++] = detail::qoi_op_run | (run - 1);
+                run = 0;
+            }
+
+            const int hash = detail::qoi_hash(px);
+            if(memcmp(index + hash * 4, px, 4) == 0)
+            {
+                out[pos++] = detail::qoi_op_index | hash;
+            }
+            else
+            {
+                memcpy(index + hash * 4, px, 4);
+                if(px[3] == prev[3])
+                {
+                    const signed char vr = (signed char)(px[0] - prev[0]);
+                    const signed char vg = (signed char)(px[1] - prev[1]);
+                    const signed char vb = (signed char)(px[2] - prev[2]);
+                    const signed char vg_r = vr - vg;
+                    const signed char vg_b = vb - vg;
+                    if(vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2)
+                    {
+                        out[pos++] = detail::qoi_op_diff | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2);
+                    }
+                    else if(vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8)
+                    {
+                        out[pos++] = detail::qoi_op_luma | (vg + 32);
+                        out[pos++] = (vg_r + 8) << 4 | (vg_b + 8);
+                    }
+                    else
+                    {
+                        out[pos++] = detail::qoi_op_rgb;
+                        out[pos++] = px[0];
+                        out[pos++] = px[1];
+                        out[pos++] = px[2];
+                    }
+                }
+                else
+                {
+                    out[pos++] = detail::qoi_op_rgba;
+                    memcpy(out + pos, px, 4);
+                    pos += 4;
+                }
+            }
+            memcpy(prev, px, 4);
+        }
+    }
+
+    if(run > 0)
+    {
+        out[pos++] = detail::qoi_op_run | (run - 1);
+    }
+
+    memcpy(out + pos, detail::qoi_padding, 8);
+    pos += 8;
+    m_buffer.resize(pos);
+}
+
+bool
+QOIEncoder::Decode(const unsigned char *buffer,
+                   const size_t size,
+                   std::vector<unsigned char> &rgba,
+                   int &width,
+                   int &height)
+{
+    if(size < detail::qoi_header_size + 8 || memcmp(buffer, "qoif", 4) != 0)
+    {
+        return false;
+    }
+
+    width = (int)detail::qoi_read_uint32(buffer + 4);
+    height = (int)detail::qoi_read_uint32(buffer + 8);
+    const size_t num_pixels = (size_t)width * height;
+    rgba.resize(num_pixels * 4);
+
+    unsigned char index[64 * 4];
+    memset(index, 0, sizeof(index));
+    unsigned char px[4] = {0, 0, 0, 255};
+    size_t pos = detail::qoi_header_size;
+    const size_t end = size - 8;
+    int run = 0;
+
+    for(size_t i = 0; i < num_pixels; ++i)
+    {
+        if(run > 0)
+        {
+            run--;
+        }
+        else
+        {
+            if(pos >= end)
+            {
+                return false;
+            }
+            const unsigned char b1 = buffer[pos++];
+            if(b1 == detail::qoi_op_rgb)
+            {
+                px[0] = buffer[pos++];
+                px[1] = buffer[pos++];
+                px[2] = buffer[pos++];
+            }
+            else if(b1 == detail::qoi_op_rgba)
+            {
+                memcpy(px, buffer + pos, 4);
+                pos += 4;
+            }
+            else if((b1 & detail::qoi_mask) == detail::qoi_op_index)
+            {
+                memcpy(px, index + b1 * 4, 4);
+            }
+            else if((b1 & detail::qoi_mask) == detail::qoi_op_diff)
+            {
+                px[0] += ((b1 >> 4) & 0x03) - 2;
+                px[1] += ((b1 >> 2) & 0x03) - 2;
+                px[2] += (b1 & 0x03) - 2;
+            }
+            else if((b1 & detail::qoi_mask) == detail::qoi_op_luma)
+            {
+                const unsigned char b2 = buffer[pos++];
+                const int vg = (b1 & 0x3f) - 32;
+                px[0] += vg - 8 + ((b2 >> 4) & 0x0f);
+                px[1] += vg;
+                px[2] += vg - 8 + (b2 & 0x0f);
+            }
+            else
+            {
+                run = b1 & 0x3f;
+            }
+            memcpy(index + detail::qoi_hash(px) * 4, px, 4);
+        }
+        memcpy(&rgba[i * 4], px, 4);
+    }
+    return true;
+}
+
+void
+QOIEncoder::Save(const std::string &filename)
+{
+    if(m_buffer.size() == 0)
+    {
+        std::cerr<<"Save must be called after encode()\n";
+        return;
+    }
+
+    FILE *file = fopen(filename.c_str(), "wb");
+    if(file == NULL ||
+       fwrite(&m_buffer[0], 1, m_buffer.size(), file) != m_buffer.size())
+    {
+        std::cerr<<"Error saving QOI buffer to file: " << filename<<"\n";
+    }
+    if(file != NULL)
+    {
+        fclose(file);
+    }
+}
+
+const unsigned char *
+QOIEncoder::Buffer() const
+{
+    return m_buffer.size() == 0 ? NULL : &m_buffer[0];
+}
+
+size_t
+QOIEncoder::BufferSize() const
+{
+    return m_buffer.size();
+}
+
+} // namespace vtkh
@@ -0,0 +1,44 @@
+#ifndef VTKH_QOI_ENCODER_HPP
+#define VTKH_QOI_ENCODER_HPP
+
+#include <vtkh/vtkh_exports.h>
+#include <string>
+#include <vector>
+
+namespace vtkh
+{
+
+//
+// Lossless encoder for the "Quite OK Image" format. It is an
+// order of magnitude faster than png at a somewhat larger size,
+// which suits writing many frames that are transcoded offline.
+// Like PNGEncoder, the input is bottom row first.
+//
+class VTKH_API QOIEncoder
+{
+public:
+    QOIEncoder();
+    ~QOIEncoder();
+
+    void           Encode(const unsigned char *rgba_in,
+                          const int width,
+                          const int height);
+    void           Save(const std::string &filename);
+
+    const unsigned char *Buffer() const;
+    size_t         BufferSize() const;
+
+    // decodes a qoi buffer into rgba bytes, top row first.
+    // Returns false if the buffer is not a valid image
+    static bool    Decode(const unsigned char *buffer,
+                          const size_t size,
+                          std::vector<unsigned char> &rgba,
+                          int &width,
+                          int &height);
+private:
+    std::vector<unsigned char> m_buffer;
+};
+
+} // namespace vtkh
+
+#endif